@@ -636,6 +636,13 @@ enum {
     GL_POLYGON_OFFSET_BIAS_EXT = 0x8039,
     /* GL */
     GL_ARRAY_BUFFER = 0x8892,
+    GL_ELEMENT_ARRAY_BUFFER = 0x8893,
+    /* OpenGL 1.5 occlusion queries */
+    GL_QUERY_COUNTER_BITS = 0x8864,
+    GL_CURRENT_QUERY = 0x8865,
+    GL_QUERY_RESULT = 0x8866,
+    GL_QUERY_RESULT_AVAILABLE = 0x8867,
+    GL_SAMPLES_PASSED = 0x8914,
     /* GL_EXT_vertex_array */
     GL_VERTEX_ARRAY_EXT = 0x8074,
     GL_NORMAL_ARRAY_EXT = 0x8075,
@@ -668,7 +675,9 @@ enum {
     GL_COLOR_ARRAY_POINTER_EXT = 0x8090,
     GL_INDEX_ARRAY_POINTER_EXT = 0x8091,
     GL_TEXTURE_COORD_ARRAY_POINTER_EXT = 0x8092,
-    GL_EDGE_FLAG_ARRAY_POINTER_EXT = 0x8093
+    GL_EDGE_FLAG_ARRAY_POINTER_EXT = 0x8093,
+    /* TinyGL extensions */
+    GL_DEPTH_PREPASS_TGL = 0x10000
 };
 
 typedef enum {
@@ -785,6 +794,7 @@ extern char TGL_BUILDT_RshiftGLshort[1 - 2 * ((GLshort) 65280 >> 8 != -1)];
 #define glReadBuffer TGL_ADD_PREFIX(glReadBuffer)
 #define glReadPixels TGL_ADD_PREFIX(glReadPixels)
 #define glDrawArrays TGL_ADD_PREFIX(glDrawArrays)
+#define glDrawElements TGL_ADD_PREFIX(glDrawElements)
 #define glSetEnableSpecular TGL_ADD_PREFIX(glSetEnableSpecular)
 #define glGetTexturePixmap TGL_ADD_PREFIX(glGetTexturePixmap)
 #define glDrawText TGL_ADD_PREFIX(glDrawText)
@@ -811,6 +821,8 @@ extern char TGL_BUILDT_RshiftGLshort[1 - 2 * ((GLshort) 65280 >> 8 != -1)];
 #define glListBase TGL_ADD_PREFIX(glListBase)
 #define glDeleteList TGL_ADD_PREFIX(glDeleteList)
 #define glDeleteLists TGL_ADD_PREFIX(glDeleteLists)
+#define glSaveListsTGL TGL_ADD_PREFIX(glSaveListsTGL)
+#define glLoadListsTGL TGL_ADD_PREFIX(glLoadListsTGL)
 #define glClear TGL_ADD_PREFIX(glClear)
 #define glClearColor TGL_ADD_PREFIX(glClearColor)
 #define glClearDepth TGL_ADD_PREFIX(glClearDepth)
@@ -851,6 +863,9 @@ extern char TGL_BUILDT_RshiftGLshort[1 - 2 * ((GLshort) 65280 >> 8 != -1)];
 #define glDisableClientState TGL_ADD_PREFIX(glDisableClientState)
 #define glArrayElement TGL_ADD_PREFIX(glArrayElement)
 #define glVertexPointer TGL_ADD_PREFIX(glVertexPointer)
+#define glVertexBoundsTGL TGL_ADD_PREFIX(glVertexBoundsTGL)
+#define glLockArraysEXT TGL_ADD_PREFIX(glLockArraysEXT)
+#define glUnlockArraysEXT TGL_ADD_PREFIX(glUnlockArraysEXT)
 #define glColorPointer TGL_ADD_PREFIX(glColorPointer)
 #define glNormalPointer TGL_ADD_PREFIX(glNormalPointer)
 #define glTexCoordPointer TGL_ADD_PREFIX(glTexCoordPointer)
@@ -861,6 +876,13 @@ extern char TGL_BUILDT_RshiftGLshort[1 - 2 * ((GLshort) 65280 >> 8 != -1)];
 #define glMapBuffer TGL_ADD_PREFIX(glMapBuffer)
 #define glBufferData TGL_ADD_PREFIX(glBufferData)
 #define glBindBufferAsArray TGL_ADD_PREFIX(glBindBufferAsArray)
+#define glGenQueries TGL_ADD_PREFIX(glGenQueries)
+#define glDeleteQueries TGL_ADD_PREFIX(glDeleteQueries)
+#define glIsQuery TGL_ADD_PREFIX(glIsQuery)
+#define glBeginQuery TGL_ADD_PREFIX(glBeginQuery)
+#define glEndQuery TGL_ADD_PREFIX(glEndQuery)
+#define glGetQueryiv TGL_ADD_PREFIX(glGetQueryiv)
+#define glGetQueryObjectuiv TGL_ADD_PREFIX(glGetQueryObjectuiv)
 #define glPolygonOffset TGL_ADD_PREFIX(glPolygonOffset)
 #define glBlendFunc TGL_ADD_PREFIX(glBlendFunc)
 #define glBlendEquation TGL_ADD_PREFIX(glBlendEquation)
@@ -943,6 +965,10 @@ void glReadPixels(GLint x,
                   GLenum type,
                   void *data);
 void glDrawArrays(GLenum mode, GLint first, GLsizei count);
+void glDrawElements(GLenum mode,
+                    GLsizei count,
+                    GLenum type,
+                    const GLvoid *indices);
 
 void glSetEnableSpecular(GLint s);
 void *glGetTexturePixmap(GLint text, GLint level, GLint *xsize, GLint *ysize);
@@ -1032,6 +1058,18 @@ void glCallLists(GLsizei n, GLenum type, const GLuint *lists);
 void glListBase(GLint n);
 void glDeleteList(GLuint list);
 void glDeleteLists(GLuint list, GLuint range);
+/*
+ * TinyGL extension: glSaveListsTGL writes the display lists list to
+ * list + range - 1 that exist to the file path, with the pixels of their
+ * glTexImage and glDrawPixels. glLoadListsTGL gives their names back to the
+ * lists of the file, replacing the lists of those names. Both return the
+ * number of lists, or -1 when the file cannot be written or read, comes from
+ * another build of TinyGL, or a list uses client arrays. Loading only checks
+ * the structure of the file, not the arguments of the ops: the files must be
+ * trusted.
+ */
+GLint glSaveListsTGL(const char *path, GLuint list, GLsizei range);
+GLint glLoadListsTGL(const char *path);
 
 /* clear */
 void glClear(GLint mask);
@@ -1128,6 +1166,21 @@ void glTexCoordPointer(GLint size,
                        GLenum type,
                        GLsizei stride,
                        const GLvoid *pointer);
+/*
+ * TinyGL extension: the box of object coordinates min to max holds every
+ * vertex of the vertex array, and glDrawArrays and glDrawElements draw
+ * nothing when it is outside of the view volume. Until the next
+ * glVertexPointer, or glVertexBoundsTGL(NULL, NULL).
+ */
+void glVertexBoundsTGL(const GLfloat *min, const GLfloat *max);
+/*
+ * GL_EXT_compiled_vertex_array: the elements first to first + count - 1 of
+ * the enabled arrays do not change until glUnlockArraysEXT, and
+ * glDrawArrays and glDrawElements reuse their transformed and lit vertices
+ * while the matrices and the lighting stay the same.
+ */
+void glLockArraysEXT(GLint first, GLsizei count);
+void glUnlockArraysEXT(void);
 
 /* OpenGL 2.0 buffers */
 void glGenBuffers(GLsizei n, GLuint *buffers);
@@ -1143,6 +1196,15 @@ void glBindBufferAsArray(GLenum target,
                          GLint size,
                          GLint stride);
 
+/* OpenGL 1.5 occlusion queries */
+void glGenQueries(GLsizei n, GLuint *ids);
+void glDeleteQueries(GLsizei n, const GLuint *ids);
+GLboolean glIsQuery(GLuint id);
+void glBeginQuery(GLenum target, GLuint id);
+void glEndQuery(GLenum target);
+void glGetQueryiv(GLenum target, GLenum pname, GLint *params);
+void glGetQueryObjectuiv(GLuint id, GLenum pname, GLuint *params);
+
 /* OpenGL 1.2 polygon offset */
 void glPolygonOffset(GLfloat factor, GLfloat units);
 void glBlendFunc(GLint, GLint);
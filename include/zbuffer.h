@@ -127,6 +127,11 @@ typedef GLushort PIXEL;
     GLuint zbblendeq = zb->blendeq; \
     GLuint sfactor = zb->sfactor;   \
     GLuint dfactor = zb->dfactor;
+/* The same, for variants specialized for a single blend mode */
+#define TGL_BLEND_CONST_VARS(eq, sf, df) \
+    const GLuint zbblendeq = (eq);       \
+    const GLuint sfactor = (sf);         \
+    const GLuint dfactor = (df);
 
 /* SORCERY to achieve 32 bit signed integer clamping */
 
@@ -273,6 +278,30 @@ typedef struct {
 } ZBDirtyRect;
 #endif
 
+/*
+ * The triangle rasterizers may be handed triangles that reach out of the
+ * framebuffer, or of the band drawn by a tile worker: they only draw rows
+ * clip_ymin..clip_ymax, and spans within the framebuffer.
+ */
+#define ZB_CLIP_ROWS \
+    (TGL_HAS(MULTITHREADED_TILED_RASTER) || TGL_HAS(GUARD_BAND))
+
+#if TGL_HAS(BATCHED_SETUP)
+/*
+ * Setup of a triangle, computed ahead by ZB_setupTriangles(): the gradients
+ * of the interpolated values along x and y, and the slopes of the edges in
+ * 16.16 fixed point, for the vertices sorted by increasing y. fz is the
+ * reciprocal of twice the signed area, 0 when the area is.
+ */
+typedef struct {
+    GLfloat fz;
+    GLint dzdx, dzdy;
+    GLint drdx, drdy, dgdx, dgdy, dbdx, dbdy;
+    GLfloat dszdx, dszdy, dtzdx, dtzdy;
+    GLint dxdy01, dxdy02, dxdy12;
+} ZBufferSetup;
+#endif
+
 typedef struct {
     GLushort *zbuf;
     PIXEL *pbuf;
@@ -293,10 +322,34 @@ typedef struct {
     /* depth */
     GLint depth_test;
     GLint depth_write;
+    /* fragments that passed the depth test, while an occlusion query runs */
+    GLuint samples_passed;
     GLubyte frame_buffer_allocated;
 #if TGL_HAS(DIRTY_RECTANGLE)
     ZBDirtyRect dirty_rect;
 #endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    /* per block: lower bound of the depth, and whether it may be loose */
+    GLushort *hzbuf;
+    GLubyte *hzstale;
+    GLint hzxsize, hzysize;
+#endif
+#if ZB_CLIP_ROWS
+    /* rows the triangle rasterizer may write, inclusive */
+    GLint clip_ymin, clip_ymax;
+#endif
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+    struct ZBTileBins *tiles;
+#endif
+#if TGL_HAS(BATCHED_SETUP)
+    /* setup of the next triangle drawn, or NULL for the rasterizer to do it */
+    const ZBufferSetup *setup;
+#endif
+#if TGL_HAS(DEPTH_PREPASS)
+    /* glEnable(GL_DEPTH_PREPASS_TGL), and the triangles it deferred */
+    GLubyte depth_prepass;
+    struct ZBPrepass *prepass;
+#endif
 } ZBuffer;
 
 typedef struct {
@@ -357,6 +410,11 @@ void ZB_line_z(ZBuffer *zb, ZBufferPoint *p1, ZBufferPoint *p2);
 
 void ZB_setTexture(ZBuffer *zb, PIXEL *texture);
 
+/* Triangle rasterizers, for ZB_setTriangleRasterizer */
+#define ZB_RASTERIZER_SCANLINE 0
+#define ZB_RASTERIZER_HALFSPACE 1 /* needs TGL_FEATURE_HALFSPACE_RASTER */
+void ZB_setTriangleRasterizer(GLint rasterizer);
+
 void ZB_fillTriangleFlat(ZBuffer *zb,
                          ZBufferPoint *p1,
                          ZBufferPoint *p2,
@@ -398,9 +456,123 @@ typedef void (*ZB_fillTriangleFunc)(ZBuffer *,
                                     ZBufferPoint *,
                                     ZBufferPoint *);
 
+/* ztriangle_batch.c */
+
+#if TGL_HAS(BATCHED_SETUP)
+/* Number of triangles of a ZBufferTriangles batch, a multiple of 4. */
+#define ZB_BATCH_SIZE 64
+
+/* What ZB_setupTriangles() computes, besides z and the edges */
+#define ZB_SETUP_RGB 1
+#define ZB_SETUP_STZ 2
+
+/*
+ * Triangles as structures of arrays: vertex v of triangle i is x[v][i],
+ * y[v][i]... The setup arrays are filled by ZB_setupTriangles().
+ */
+typedef struct {
+    GLint n;
+    GLint x[3][ZB_BATCH_SIZE], y[3][ZB_BATCH_SIZE], z[3][ZB_BATCH_SIZE];
+    GLint s[3][ZB_BATCH_SIZE], t[3][ZB_BATCH_SIZE];
+    GLint r[3][ZB_BATCH_SIZE], g[3][ZB_BATCH_SIZE], b[3][ZB_BATCH_SIZE];
+    GLfloat sz[3][ZB_BATCH_SIZE], tz[3][ZB_BATCH_SIZE];
+    GLfloat fz[ZB_BATCH_SIZE];
+    GLint dzdx[ZB_BATCH_SIZE], dzdy[ZB_BATCH_SIZE];
+    GLint drdx[ZB_BATCH_SIZE], drdy[ZB_BATCH_SIZE];
+    GLint dgdx[ZB_BATCH_SIZE], dgdy[ZB_BATCH_SIZE];
+    GLint dbdx[ZB_BATCH_SIZE], dbdy[ZB_BATCH_SIZE];
+    GLfloat dszdx[ZB_BATCH_SIZE], dszdy[ZB_BATCH_SIZE];
+    GLfloat dtzdx[ZB_BATCH_SIZE], dtzdy[ZB_BATCH_SIZE];
+    GLint dxdy01[ZB_BATCH_SIZE], dxdy02[ZB_BATCH_SIZE], dxdy12[ZB_BATCH_SIZE];
+} ZBufferTriangles;
+
+/* Append a triangle; the batch must not be full */
+void ZB_addTriangle(ZBufferTriangles *t,
+                    const ZBufferPoint *p0,
+                    const ZBufferPoint *p1,
+                    const ZBufferPoint *p2);
+/* Compute the setup of every triangle of the batch, 4 at a time */
+void ZB_setupTriangles(ZBufferTriangles *t, GLint what);
+/*
+ * Copy triangle i out of the batch, with its setup. Drawing p with
+ * zb->setup pointing to setup gives the same pixels as drawing the triangle
+ * as it was added.
+ */
+void ZB_getTriangle(const ZBufferTriangles *t,
+                    GLint i,
+                    ZBufferPoint *p,
+                    ZBufferSetup *setup);
+#endif
+
+/* zhiz.c */
+
+#if TGL_HAS(HIERARCHICAL_Z)
+void ZB_initHiZ(ZBuffer *zb);
+void ZB_closeHiZ(ZBuffer *zb);
+void ZB_clearHiZ(ZBuffer *zb, GLushort z);
+/* Depth values of the rectangle were written; lowered: without depth test.
+   Code writing zb->zbuf directly must call this, or triangles it should have
+   uncovered can be discarded. */
+void ZB_markHiZ(ZBuffer *zb,
+                GLint xmin,
+                GLint ymin,
+                GLint xmax,
+                GLint ymax,
+                GLint lowered);
+/* Draw a triangle with func, unless it is entirely hidden */
+void ZB_fillTriangleHiZ(ZBuffer *zb,
+                        ZB_fillTriangleFunc func,
+                        GLint depth_test,
+                        GLint depth_write,
+                        ZBufferPoint *p0,
+                        ZBufferPoint *p1,
+                        ZBufferPoint *p2);
+#endif
+
+/* ztile.c */
+
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+void ZB_initTiles(ZBuffer *zb);
+void ZB_closeTiles(ZBuffer *zb);
+/* Record a triangle; it is drawn with func at the next ZB_flushTiles */
+void ZB_binTriangle(ZBuffer *zb,
+                    ZB_fillTriangleFunc func,
+                    ZBufferPoint *p0,
+                    ZBufferPoint *p1,
+                    ZBufferPoint *p2);
+/* Rasterize every recorded triangle */
+void ZB_flushTiles(ZBuffer *zb);
+#endif
+
+/* zprepass.c */
+
+#if TGL_HAS(DEPTH_PREPASS)
+void ZB_closePrepass(ZBuffer *zb);
+/*
+ * Defer a triangle: depth writes its depth at the next ZB_flushPrepass, then
+ * func shades it, with depth test and without depth write.
+ */
+void ZB_prepassTriangle(ZBuffer *zb,
+                        ZB_fillTriangleFunc depth,
+                        ZB_fillTriangleFunc func,
+                        ZBufferPoint *p0,
+                        ZBufferPoint *p1,
+                        ZBufferPoint *p2);
+/* Draw every deferred triangle, in two passes */
+void ZB_flushPrepass(ZBuffer *zb);
+#endif
+
+/* Draw the triangles deferred by the tile bins and the depth prepass */
+#if TGL_HAS(MULTITHREADED_TILED_RASTER) || TGL_HAS(DEPTH_PREPASS)
+void ZB_flushTriangles(ZBuffer *zb);
+#else
+#define ZB_flushTriangles(zb) ((void) (zb))
+#endif
+
 /* memory.c */
 extern void gl_free(void *p);
 extern void *gl_malloc(GLint size);
 extern void *gl_zalloc(GLint size);
+extern void *gl_realloc(void *p, GLint size);
 
 #endif /* TGL_ZBUFFER_H */
@@ -33,23 +33,129 @@
 
 #define TGL_FEATURE_ARRAYS 1
 
+/*
+ * Draw the vertex arrays of glDrawArrays in batches: the positions of a run of
+ * vertices are transformed, clipped and mapped to the viewport in loops over
+ * structures of arrays (vectorized by the compiler), before their primitives
+ * are assembled. Display lists still record the array elements one by one.
+ */
+#define TGL_FEATURE_BULK_TRANSFORM 1
+
+/*
+ * Post-transform vertex cache for glDrawElements: the transformed, lit and
+ * projected vertex of an index is reused by the elements repeating it while it
+ * stays in the cache, which is direct mapped by the low bits of the index.
+ */
+#define TGL_FEATURE_VERTEX_CACHE 1
+/* Number of vertices in the cache, a power of 2. */
+#define TGL_VERTEX_CACHE_SIZE 32
+
+/*
+ * Compiled vertex arrays: while glLockArraysEXT() locks a range of the
+ * client arrays, glDrawArrays and glDrawElements keep the transformed and
+ * lit vertex of each locked element, and copy it again in the next draws as
+ * long as the matrices, the lights, the materials and the rest of the state
+ * it was computed with stay the same.
+ */
+#define TGL_FEATURE_LOCKED_ARRAYS 1
+
 #define TGL_FEATURE_DISPLAYLISTS 1
 
+/*
+ * Bounding box culling: a display list drawing only primitives records the
+ * box of its vertices, and glCallList skips it when the box is outside of the
+ * view volume, setting the current color, normal and texture coordinates the
+ * list would have left. glVertexBoundsTGL() gives the box of the vertex array
+ * to glDrawArrays and glDrawElements.
+ */
+#define TGL_FEATURE_BOUNDS_CULLING 1
+
+/*
+ * Optimize a display list at glEndList: a run of glTranslate, glRotate,
+ * glScale and glMultMatrix folds into one glMultMatrix (into a glLoadMatrix
+ * after glLoadIdentity or glLoadMatrix), a glColor, glNormal or glTexCoord
+ * setting the value already current is dropped, and a glBegin/glEnd with
+ * nothing but glVertex inside becomes a packed array of positions, drawn
+ * through the batched transform of the vertex arrays.
+ */
+#define TGL_FEATURE_LIST_OPTIMIZER 1
+
+/*
+ * Compile display lists to direct threaded code, with GCC and Clang: each op
+ * is preceded by the address of the code in the list interpreter calling its
+ * handler and jumping to the next op.
+ */
+#define TGL_FEATURE_THREADED_LISTS 1
+
+/*
+ * glSaveListsTGL() and glLoadListsTGL(): write compiled display lists to a
+ * file, and load them back, mapping the file in memory where mmap() exists.
+ */
+#define TGL_FEATURE_LIST_FILES 1
+
+/*
+ * Outside of glNewList and glEndList, glVertex, glColor, glNormal and
+ * glTexCoord call the vertex code directly, through a table of the context,
+ * rather than building an op for gl_add_op().
+ */
+#define TGL_FEATURE_IMMEDIATE_DISPATCH 1
+
 #define TGL_FEATURE_LIT_TEXTURES 1
+
+/*
+ * Light the vertices when a point, a line, or a triangle surviving culling and
+ * trivial rejection draws them, rather than as they arrive: the vertices of
+ * back faces and of primitives outside of the view are never lit. With
+ * GL_COLOR_MATERIAL, each vertex keeps its color for the material until then.
+ */
+#define TGL_FEATURE_LAZY_LIGHTING 1
+
+/*
+ * Light the vertices in batches of GL_LIGHT_BATCH, as structures of arrays
+ * (vectorized by the compiler), with the products of the lights and the
+ * material cached when glLight and glMaterial change them, and the powers of
+ * the spot exponents and of the shininess read from tables.
+ */
+#define TGL_FEATURE_BATCHED_LIGHTING 1
+/*
+ * Number of intervals of the power tables, interpolated linearly: the powers
+ * stay within half a color level of pow().
+ */
+#define TGL_POW_TABLE_SIZE 512
+
+/*
+ * Fixed point geometry, for CPUs with a slow FPU or none: the vertices are
+ * transformed, clip tested, mapped to the viewport and lit with s15.16
+ * integers (src/zfixed.h), like the rasterizers' own values. The matrices and
+ * the lights are converted when they change. Object coordinates must stay
+ * within +-32767 once transformed. Texture matrices, the clipping of the
+ * primitives crossing the view volume and the triangle setup stay in
+ * floating point. Needs TGL_FEATURE_BATCHED_LIGHTING, and replaces
+ * TGL_FEATURE_BULK_TRANSFORM.
+ */
+#define TGL_FEATURE_FIXED_POINT_GEOMETRY 0
+
 /* Enable the patternized "discard"-ing of pixels.*/
 #define TGL_FEATURE_POLYGON_STIPPLE 0
 /* Enable the use of GL_SELECT and GL_FEEDBACK*/
 #define TGL_FEATURE_ALT_RENDERMODES 0
 
 /*
- * Enable the rendering of large polygons (in terms of vertex count)
+ * Enable the rendering of GL_POLYGON, drawn as a fan of triangles around its
+ * first vertex, with any number of vertices.
  * Also enabled the rendering of line loops.
- * the maximum number of vertices in a polygon is defined in zgl.h
  */
 #define TGL_FEATURE_GL_POLYGON 0
 
 #define TGL_FEATURE_BLEND 1
 
+/*
+ * Build the blended triangle variants once more for each of the common blend
+ * modes listed in ztriangle_variants.h, with the blend state as a constant.
+ * Other modes fall back to a switch on the blend state for every pixel.
+ */
+#define TGL_FEATURE_BLEND_MODE_VARIANTS 1
+
 #define TGL_FEATURE_BLEND_DRAW_PIXELS 0
 /* The width of textures as a power of 2. The default is 8, or 256x256
  * textures
@@ -86,6 +192,99 @@
 
 #define TGL_FEATURE_MULTITHREADED_ZB_COPYBUFFER 0
 
+/*
+ * Deferred, tile-binned triangle rasterization. Filled triangles are recorded
+ * into horizontal bands of the framebuffer instead of being drawn right away,
+ * and the bands are rasterized in parallel (with OpenMP) when the bins are
+ * flushed: at glFinish/glFlush, ZB_copyFrameBuffer, or before anything else
+ * touches the framebuffer. Each band owns its rows of pbuf/zbuf, so workers
+ * never need to lock. Bands span the full width so that every span is drawn
+ * exactly as the serial rasterizer would draw it.
+ *
+ * Code reading zb->pbuf directly must call glFinish() first.
+ */
+#define TGL_FEATURE_MULTITHREADED_TILED_RASTER 0
+/* Height of a raster band, as a power of 2. */
+#define TGL_TILE_HEIGHT_POW2 5
+/* Number of triangles recorded before the bins are flushed. */
+#define TGL_TILE_MAX_TRIANGLES 4096
+
+/*
+ * Half-space (edge function) rasterizer for flat and smooth shaded triangles,
+ * evaluating blocks of 4 pixels with SSE2/NEON when the compiler targets them.
+ * 0 - not built.
+ * 1 - built, selected at runtime with ZB_setTriangleRasterizer().
+ * 2 - built and used by default.
+ */
+#define TGL_FEATURE_HALFSPACE_RASTER 1
+
+/*
+ * Draw the spans of opaque flat and smooth shaded triangles 4 pixels at a
+ * time with SSE2/NEON, in the scanline rasterizer. Without either, or with
+ * TGL_FEATURE_POLYGON_STIPPLE, the plain C spans are used.
+ */
+#define TGL_FEATURE_SIMD_SPANS 1
+
+/*
+ * 4x4 matrix products, matrix-vector products and inverses with SSE2/NEON,
+ * one row of 4 values at a time, computing the very same values as the plain
+ * C loops used without either.
+ */
+#define TGL_FEATURE_SIMD_MATRIX 1
+
+/*
+ * Guard-band clipping: untextured filled triangles that cross the left,
+ * right, top or bottom planes, but stay within TGL_GUARD_BAND pixels of a
+ * viewport covering the whole framebuffer, are not split by the clipper. The
+ * triangle rasterizers cut their rows and spans to the framebuffer instead.
+ * The depth of such a triangle is interpolated across it rather than across
+ * the pieces, so where two triangles cut through each other the line between
+ * them can move by a pixel.
+ */
+#define TGL_FEATURE_GUARD_BAND 1
+/* Width of the guard band, in pixels, around the framebuffer. */
+#define TGL_GUARD_BAND 4096
+
+/*
+ * Cheaper setup for small triangles. The scanline rasterizer divides the
+ * edges up to 4 rows high by a constant, and the half-space rasterizer tests
+ * bounding boxes up to a block wide whole, without solving the span of each
+ * row.
+ */
+#define TGL_FEATURE_SMALL_TRIANGLES 1
+
+/*
+ * Batched triangle setup: the filled triangles of a glBegin/glEnd pair are
+ * queued, and their gradients and edge slopes computed 4 at a time (with
+ * SIMD, as vectorized by the compiler) before the scanline rasterizer draws
+ * them. Not used with TGL_FEATURE_MULTITHREADED_TILED_RASTER, whose bins
+ * already defer the triangles, nor with the half-space rasterizer. Off by
+ * default: it has shown no measurable gain over the per-triangle setup.
+ */
+#define TGL_FEATURE_BATCHED_SETUP 0
+
+/*
+ * Depth prepass, enabled at runtime with glEnable(GL_DEPTH_PREPASS_TGL): the
+ * opaque triangles drawn with depth test and depth write are deferred, and
+ * drawn twice when flushed, at the same times as the tile bins. The first
+ * pass only writes their depth, the second one shades the pixels left at the
+ * depth of the triangle, so that each pixel is textured and lit once.
+ *
+ * Code reading zb->pbuf directly must call glFinish() first.
+ */
+#define TGL_FEATURE_DEPTH_PREPASS 1
+/* Number of triangles deferred before they are drawn. */
+#define TGL_PREPASS_MAX_TRIANGLES 4096
+
+/*
+ * Hierarchical Z: keep a lower bound of the depth of every block of the depth
+ * buffer, and discard triangles that are entirely behind it before they are
+ * rasterized. Code writing zb->zbuf directly must call ZB_markHiZ().
+ */
+#define TGL_FEATURE_HIERARCHICAL_Z 1
+/* Size of a hierarchical Z block, as a power of 2. */
+#define TGL_HIZ_BLOCK_POW2 3
+
 /*
  * Dirty rectangle optimization - track modified screen regions and only copy
  * changed portions to the destination framebuffer.
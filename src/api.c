@@ -22,12 +22,13 @@ void gl_add_op(GLParam *p)
     }
 }
 
-/* glVertex */
-
-void glVertex4f(GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+/*
+ * The ops of glVertex, glColor, glNormal and glTexCoord, for gl_add_op() while
+ * a list is compiled.
+ */
+static void add_vertex(GLContext *c, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
 {
     GLParam p[5];
-#include "error_check_no_context.h"
     p[0].op = OP_Vertex;
     p[1].f = x;
     p[2].f = y;
@@ -37,6 +38,85 @@ void glVertex4f(GLfloat x, GLfloat y, GLfloat z, GLfloat w)
     gl_add_op(p);
 }
 
+static void add_color(GLContext *c, GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+    GLParam p[8];
+    p[0].op = OP_Color;
+    p[1].f = r;
+    p[2].f = g;
+    p[3].f = b;
+    p[4].f = a;
+    p[5].ui = (((GLuint) (r * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
+               COLOR_MASK);
+    p[6].ui = (((GLuint) (g * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
+               COLOR_MASK);
+    p[7].ui = (((GLuint) (b * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
+               COLOR_MASK);
+    gl_add_op(p);
+}
+
+static void add_normal(GLContext *c, GLfloat x, GLfloat y, GLfloat z)
+{
+    GLParam p[4];
+    p[0].op = OP_Normal;
+    p[1].f = x;
+    p[2].f = y;
+    p[3].f = z;
+    gl_add_op(p);
+}
+
+static void add_tex_coord(GLContext *c,
+                          GLfloat s,
+                          GLfloat t,
+                          GLfloat r,
+                          GLfloat q)
+{
+    GLParam p[5];
+    p[0].op = OP_TexCoord;
+    p[1].f = s;
+    p[2].f = t;
+    p[3].f = r;
+    p[4].f = q;
+
+    gl_add_op(p);
+}
+
+static const GLDispatch gl_list_dispatch = {
+    add_vertex,
+    add_color,
+    add_normal,
+    add_tex_coord,
+};
+
+#if TGL_HAS(IMMEDIATE_DISPATCH)
+static const GLDispatch gl_exec_dispatch = {
+    gl_vertex4f,
+    gl_color4f,
+    gl_normal3f,
+    gl_tex_coord4f,
+};
+#endif
+
+/* Point the dispatch of c to the ops while a list is compiled, or else to
+   the vertex code. */
+void gl_set_dispatch(GLContext *c)
+{
+#if TGL_HAS(IMMEDIATE_DISPATCH)
+    c->dispatch = c->compile_flag ? &gl_list_dispatch : &gl_exec_dispatch;
+#else
+    c->dispatch = &gl_list_dispatch;
+#endif
+}
+
+/* glVertex */
+
+void glVertex4f(GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+    c->dispatch->vertex(c, x, y, z, w);
+}
+
 void glVertex2f(GLfloat x, GLfloat y)
 {
     glVertex4f(x, y, 0, 1);
@@ -56,13 +136,9 @@ void glVertex3fv(GLfloat *v)
 
 void glNormal3f(GLfloat x, GLfloat y, GLfloat z)
 {
-    GLParam p[4];
-#include "error_check_no_context.h"
-    p[0].op = OP_Normal;
-    p[1].f = x;
-    p[2].f = y;
-    p[3].f = z;
-    gl_add_op(p);
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+    c->dispatch->normal(c, x, y, z);
 }
 
 void glRectf(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2)
@@ -84,39 +160,14 @@ void glNormal3fv(GLfloat *v)
 
 void glColor4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
 {
-    GLParam p[8];
-#include "error_check_no_context.h"
-    p[0].op = OP_Color;
-    p[1].f = r;
-    p[2].f = g;
-    p[3].f = b;
-    p[4].f = a;
-    p[5].ui = (((GLuint) (r * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
-               COLOR_MASK);
-    p[6].ui = (((GLuint) (g * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
-               COLOR_MASK);
-    p[7].ui = (((GLuint) (b * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
-               COLOR_MASK);
-    gl_add_op(p);
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+    c->dispatch->color(c, r, g, b, a);
 }
 
 void glColor4fv(GLfloat *v)
 {
-    GLParam p[8];
-#include "error_check_no_context.h"
-    p[0].op = OP_Color;
-    p[1].f = v[0];
-    p[2].f = v[1];
-    p[3].f = v[2];
-    p[4].f = v[3];
-    p[5].ui = (((GLuint) (v[0] * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
-               COLOR_MASK);
-    p[6].ui = (((GLuint) (v[1] * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
-               COLOR_MASK);
-    p[7].ui = (((GLuint) (v[2] * COLOR_CORRECTED_MULT_MASK) + COLOR_MIN_MULT) &
-               COLOR_MASK);
-
-    gl_add_op(p);
+    glColor4f(v[0], v[1], v[2], v[3]);
 }
 
 void glColor3f(GLfloat x, GLfloat y, GLfloat z)
@@ -133,15 +184,9 @@ void glColor3fv(GLfloat *v)
 
 void glTexCoord4f(GLfloat s, GLfloat t, GLfloat r, GLfloat q)
 {
-    GLParam p[5];
-#include "error_check_no_context.h"
-    p[0].op = OP_TexCoord;
-    p[1].f = s;
-    p[2].f = t;
-    p[3].f = r;
-    p[4].f = q;
-
-    gl_add_op(p);
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+    c->dispatch->tex_coord(c, s, t, r, q);
 }
 
 void glTexCoord2f(GLfloat s, GLfloat t)
@@ -729,7 +774,9 @@ void glCallList(GLuint list)
     gl_add_op(p);
 }
 void glFlush(void)
-{ /* nothing to do */
+{
+    GLContext *c = gl_get_context();
+    ZB_flushTriangles(c->zb);
 }
 
 void glHint(GLint target, GLint mode)
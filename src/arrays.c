@@ -12,6 +12,8 @@ static GLint free_buffer(GLint handle)
     if (s->buffers[handle]) {
         if (c->boundarraybuffer == (handle + 1))
             c->boundarraybuffer = 0;
+        if (c->boundelementbuffer == (handle + 1))
+            c->boundelementbuffer = 0;
         if (s->buffers[handle]->data) {
             void *d = s->buffers[handle]->data;
             gl_free(s->buffers[handle]->data);
@@ -126,6 +128,8 @@ void glBindBuffer(GLenum target, GLuint buffer)
     if (buffer == 0 || check_buffer(buffer) == 1) {
         if (target == GL_ARRAY_BUFFER)
             c->boundarraybuffer = buffer;
+        if (target == GL_ELEMENT_ARRAY_BUFFER)
+            c->boundelementbuffer = buffer;
     }
     return;
 }
@@ -232,6 +236,8 @@ void *glMapBuffer(GLenum target, GLenum access)
     GLint handle = 0;
     if (target == GL_ARRAY_BUFFER)
         handle = c->boundarraybuffer;
+    if (target == GL_ELEMENT_ARRAY_BUFFER)
+        handle = c->boundelementbuffer;
     if (target == GL_VERTEX_BUFFER)
         handle = c->boundvertexbuffer;
     if (target == GL_TEXTURE_COORD_BUFFER)
@@ -260,6 +266,8 @@ void glBufferData(GLenum target, GLsizei size, const void *data, GLenum usage)
     GLBuffer *buf = NULL;
     if (target == GL_ARRAY_BUFFER)
         handle = c->boundarraybuffer;
+    if (target == GL_ELEMENT_ARRAY_BUFFER)
+        handle = c->boundelementbuffer;
     if (target == GL_VERTEX_BUFFER)
         handle = c->boundvertexbuffer;
     if (target == GL_TEXTURE_COORD_BUFFER)
@@ -298,12 +306,11 @@ void glBufferData(GLenum target, GLsizei size, const void *data, GLenum usage)
         memcpy(buf->data, data, size);
 }
 
-void glopArrayElement(GLParam *param)
+/* The current color, normal and texture coordinates of element idx. */
+static void gl_array_attributes(GLContext *c, GLint idx)
 {
     GLint i;
-    GLContext *c = gl_get_context();
     GLint states = c->client_states;
-    GLint idx = param[1].i;
 
     if (states & COLOR_ARRAY) {
         GLParam p[5];
@@ -329,14 +336,51 @@ void glopArrayElement(GLParam *param)
         c->current_tex_coord.Z = (size > 2) ? c->texcoord_array[i + 2] : 0.0f;
         c->current_tex_coord.W = (size > 3) ? c->texcoord_array[i + 3] : 1.0f;
     }
-    if (states & VERTEX_ARRAY) {
+}
+
+#if TGL_HAS(BOUNDS_CULLING)
+/*
+ * Whether the elements of the vertex array are all outside of the view
+ * volume, within the box given by glVertexBoundsTGL(). The current color,
+ * normal and texture coordinates are then those of element last, as if the
+ * elements had been drawn.
+ */
+static GLint gl_cull_arrays(GLContext *c, GLint last)
+{
+    if (!c->vertex_array_bounded || c->compile_flag ||
+        !(c->client_states & VERTEX_ARRAY) ||
+        !gl_box_outside(c, &c->vertex_array_min, &c->vertex_array_max))
+        return 0;
+    gl_array_attributes(c, last);
+    return 1;
+}
+#endif
+
+/* The coordinates of element idx of the vertex array. */
+static void gl_array_coord(GLContext *c, GLint idx, V4 *v)
+{
+    GLint size = c->vertex_array_size;
+    GLint i = idx * (size + c->vertex_array_stride);
+    v->X = c->vertex_array[i];
+    v->Y = c->vertex_array[i + 1];
+    v->Z = (size > 2) ? c->vertex_array[i + 2] : 0.0f;
+    v->W = (size > 3) ? c->vertex_array[i + 3] : 1.0f;
+}
+
+void glopArrayElement(GLParam *param)
+{
+    GLContext *c = gl_get_context();
+    GLint idx = param[1].i;
+
+    gl_array_attributes(c, idx);
+    if (c->client_states & VERTEX_ARRAY) {
         GLParam p[5];
-        GLint size = c->vertex_array_size;
-        i = idx * (size + c->vertex_array_stride);
-        p[1].f = c->vertex_array[i];
-        p[2].f = c->vertex_array[i + 1];
-        p[3].f = (size > 2) ? c->vertex_array[i + 2] : 0.0f;
-        p[4].f = (size > 3) ? c->vertex_array[i + 3] : 1.0f;
+        V4 v;
+        gl_array_coord(c, idx, &v);
+        p[1].f = v.X;
+        p[2].f = v.Y;
+        p[3].f = v.Z;
+        p[4].f = v.W;
         glopVertex(p);
     }
 }
@@ -350,12 +394,206 @@ void glArrayElement(GLint i)
     gl_add_op(p);
 }
 
+static GLint gl_element(GLenum type, const GLvoid *indices, GLint i)
+{
+    switch (type) {
+    case GL_UNSIGNED_BYTE:
+        return ((const GLubyte *) indices)[i];
+    case GL_UNSIGNED_SHORT:
+        return ((const GLushort *) indices)[i];
+    default:
+        return ((const GLuint *) indices)[i];
+    }
+}
+
+#if TGL_HAS(LOCKED_ARRAYS)
+static void gl_array_state(GLContext *c, GLArrayState *s)
+{
+    s->matrix_gen = c->matrix_gen;
+    s->light_gen = c->light_gen;
+    s->client_states = c->client_states;
+    s->lighting_enabled = c->lighting_enabled;
+    s->normalize_enabled = c->normalize_enabled;
+    s->color_material_enabled = c->color_material_enabled;
+    s->texture_2d_enabled = c->texture_2d_enabled;
+    s->apply_texture_matrix = c->apply_texture_matrix;
+    s->xmin = c->viewport.xmin;
+    s->ymin = c->viewport.ymin;
+    s->xsize = c->viewport.xsize;
+    s->ysize = c->viewport.ysize;
+    s->color = c->current_color;
+    s->normal = c->current_normal;
+    s->tex_coord = c->current_tex_coord;
+    s->edge_flag = c->current_edge_flag;
+    s->vertex_array = c->vertex_array;
+    s->normal_array = c->normal_array;
+    s->color_array = c->color_array;
+    s->texcoord_array = c->texcoord_array;
+    s->vertex_array_size = c->vertex_array_size;
+    s->vertex_array_stride = c->vertex_array_stride;
+    s->normal_array_stride = c->normal_array_stride;
+    s->color_array_size = c->color_array_size;
+    s->color_array_stride = c->color_array_stride;
+    s->texcoord_array_size = c->texcoord_array_size;
+    s->texcoord_array_stride = c->texcoord_array_stride;
+}
+
+static inline GLint gl_v4_equal(const V4 *a, const V4 *b)
+{
+    return a->X == b->X && a->Y == b->Y && a->Z == b->Z && a->W == b->W;
+}
+
+/* Field by field, since the padding of the structure is left undefined. */
+static GLint gl_array_state_equal(const GLArrayState *a, const GLArrayState *b)
+{
+    return a->matrix_gen == b->matrix_gen && a->light_gen == b->light_gen &&
+           a->client_states == b->client_states &&
+           a->lighting_enabled == b->lighting_enabled &&
+           a->normalize_enabled == b->normalize_enabled &&
+           a->color_material_enabled == b->color_material_enabled &&
+           a->texture_2d_enabled == b->texture_2d_enabled &&
+           a->apply_texture_matrix == b->apply_texture_matrix &&
+           a->xmin == b->xmin && a->ymin == b->ymin &&
+           a->xsize == b->xsize && a->ysize == b->ysize &&
+           gl_v4_equal(&a->color, &b->color) &&
+           gl_v4_equal(&a->normal, &b->normal) &&
+           gl_v4_equal(&a->tex_coord, &b->tex_coord) &&
+           a->edge_flag == b->edge_flag &&
+           a->vertex_array == b->vertex_array &&
+           a->normal_array == b->normal_array &&
+           a->color_array == b->color_array &&
+           a->texcoord_array == b->texcoord_array &&
+           a->vertex_array_size == b->vertex_array_size &&
+           a->vertex_array_stride == b->vertex_array_stride &&
+           a->normal_array_stride == b->normal_array_stride &&
+           a->color_array_size == b->color_array_size &&
+           a->color_array_stride == b->color_array_stride &&
+           a->texcoord_array_size == b->texcoord_array_size &&
+           a->texcoord_array_stride == b->texcoord_array_stride;
+}
+
+/*
+ * glBegin, glArrayElement for each element and glEnd, from the arrays locked
+ * by glLockArraysEXT(): the vertex of a locked element is computed once, lit
+ * right away, and copied by the next draws until the state changes. The
+ * state left by a draw is the one the next draw must start from, since the
+ * elements set the current color (and with GL_COLOR_MATERIAL, the material)
+ * along the way. The elements out of the locked range are computed as usual.
+ * indices is NULL for glDrawArrays. Returns 0 when nothing is locked, while
+ * compiling a display list, or without a vertex array.
+ */
+static GLint gl_draw_locked(GLenum mode,
+                            GLint first,
+                            GLsizei count,
+                            GLenum type,
+                            const GLvoid *indices)
+{
+    GLContext *c = gl_get_context();
+    GLArrayState state;
+    GLParam p[2];
+    GLint i, idx = first;
+
+    if (c->locked_vertex == NULL || c->compile_flag ||
+        !(c->client_states & VERTEX_ARRAY))
+        return 0;
+
+    gl_array_state(c, &state);
+    if (!gl_array_state_equal(&state, &c->locked_state))
+        memset(c->locked_valid, 0, c->locked_count);
+
+    p[1].i = mode;
+    glopBegin(p);
+    for (i = 0; i < count; i++) {
+        GLint k;
+        V4 coord;
+        idx = indices ? gl_element(type, indices, i) : first + i;
+        k = idx - c->locked_first;
+        if (k >= 0 && k < c->locked_count) {
+            GLVertex *v = &c->locked_vertex[k];
+            if (!c->locked_valid[k]) {
+                c->locked_valid[k] = 1;
+                gl_array_attributes(c, idx);
+                gl_array_coord(c, idx, &coord);
+                gl_eval_vertex(c, v, &coord);
+                /* once for all of the draws */
+                gl_light_lazy(c, v);
+            }
+            *c->vertex_ring[c->vertex_n] = *v;
+        } else {
+            gl_array_attributes(c, idx);
+            gl_array_coord(c, idx, &coord);
+            gl_eval_vertex(c, c->vertex_ring[c->vertex_n], &coord);
+        }
+        gl_vertex_assemble(c);
+    }
+    /* the current color, normal and texture coordinates of the last element */
+    if (count > 0)
+        gl_array_attributes(c, idx);
+    glopEnd(p);
+
+    gl_array_state(c, &c->locked_state);
+    return 1;
+}
+#endif
+
+#if GL_BULK_TRANSFORM
+/*
+ * glBegin, glArrayElement for each element and glEnd, but with the positions
+ * of GL_VERTEX_BATCH elements at a time gathered and transformed together.
+ * Returns 0 when the elements must go through glArrayElement: while compiling
+ * a display list, or without a vertex array.
+ */
+static GLint gl_draw_arrays(GLenum mode, GLint first, GLsizei count)
+{
+    GLContext *c = gl_get_context();
+    GLVertexBatch b;
+    GLParam p[2];
+    GLint size = c->vertex_array_size;
+    GLint stride = size + c->vertex_array_stride;
+    GLint i, j, n;
+
+    if (c->compile_flag || !(c->client_states & VERTEX_ARRAY))
+        return 0;
+
+    p[1].i = mode;
+    glopBegin(p);
+    for (i = 0; i < count; i += n) {
+        const GLfloat *a = &c->vertex_array[(first + i) * stride];
+        n = count - i < GL_VERTEX_BATCH ? count - i : GL_VERTEX_BATCH;
+        for (j = 0; j < n; j++, a += stride) {
+            b.x[j] = a[0];
+            b.y[j] = a[1];
+            b.z[j] = (size > 2) ? a[2] : 0.0f;
+        }
+        gl_transform_vertices(c, &b, n);
+        for (j = 0; j < n; j++) {
+            gl_array_attributes(c, first + i + j);
+            gl_add_vertex(c, &b, j);
+        }
+    }
+    glopEnd(p);
+    return 1;
+}
+#endif
+
 void glDrawArrays(GLenum mode, GLint first, GLsizei count)
 {
     GLint i;
     GLint end;
 
 #include "error_check_no_context.h"
+#if TGL_HAS(BOUNDS_CULLING)
+    if (count > 0 && gl_cull_arrays(gl_get_context(), first + count - 1))
+        return;
+#endif
+#if TGL_HAS(LOCKED_ARRAYS)
+    if (gl_draw_locked(mode, first, count, 0, NULL))
+        return;
+#endif
+#if GL_BULK_TRANSFORM
+    if (gl_draw_arrays(mode, first, count))
+        return;
+#endif
     end = first + count;
     glBegin(mode);
     for (i = first; i < end; i++)
@@ -363,6 +601,103 @@ void glDrawArrays(GLenum mode, GLint first, GLsizei count)
     glEnd();
 }
 
+#if TGL_HAS(VERTEX_CACHE)
+/*
+ * glBegin, glArrayElement for each index and glEnd, with a post-transform
+ * cache: the vertex computed for an index is kept in the slot of its low
+ * bits, and copied again for the next elements with the same index. The
+ * transformations, lights and materials cannot change until glEnd, and
+ * neither can the attributes of an index, so the cache lives for the call.
+ * Returns 0 when the elements must go through glArrayElement: while compiling
+ * a display list, or without a vertex array.
+ */
+static GLint gl_draw_elements(GLenum mode,
+                              GLsizei count,
+                              GLenum type,
+                              const GLvoid *indices)
+{
+    GLContext *c = gl_get_context();
+    GLVertex cache[TGL_VERTEX_CACHE_SIZE];
+    GLint tags[TGL_VERTEX_CACHE_SIZE];
+    GLParam p[2];
+    GLint i;
+
+    if (c->compile_flag || !(c->client_states & VERTEX_ARRAY))
+        return 0;
+
+    for (i = 0; i < TGL_VERTEX_CACHE_SIZE; i++)
+        tags[i] = -1;
+
+    p[1].i = mode;
+    glopBegin(p);
+    for (i = 0; i < count; i++) {
+        GLint idx = gl_element(type, indices, i);
+        GLint slot = idx & (TGL_VERTEX_CACHE_SIZE - 1);
+        GLVertex *v = &cache[slot];
+        if (tags[slot] != idx) {
+            V4 coord;
+            tags[slot] = idx;
+            gl_array_attributes(c, idx);
+            gl_array_coord(c, idx, &coord);
+            gl_eval_vertex(c, v, &coord);
+            /* once for all of its copies */
+            gl_light_lazy(c, v);
+        }
+        *c->vertex_ring[c->vertex_n] = *v;
+        gl_vertex_assemble(c);
+    }
+    /* leave the current color, normal and texture coordinates of the last
+       element, which may have come from the cache */
+    if (count > 0)
+        gl_array_attributes(c, gl_element(type, indices, count - 1));
+    glopEnd(p);
+    return 1;
+}
+#endif
+
+void glDrawElements(GLenum mode,
+                    GLsizei count,
+                    GLenum type,
+                    const GLvoid *indices)
+{
+    GLContext *c = gl_get_context();
+    GLint i;
+#include "error_check.h"
+    if (type != GL_UNSIGNED_BYTE && type != GL_UNSIGNED_SHORT &&
+        type != GL_UNSIGNED_INT) {
+#if TGL_HAS(ERROR_CHECK)
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+#else
+        return;
+#endif
+    }
+    /* with an element array buffer bound, indices is an offset in it */
+    if (c->boundelementbuffer) {
+        GLBuffer *buf = c->shared_state.buffers[c->boundelementbuffer - 1];
+        if (buf->data == NULL)
+            return;
+        indices = (const GLubyte *) buf->data + (size_t) indices;
+    }
+#if TGL_HAS(BOUNDS_CULLING)
+    if (count > 0 &&
+        gl_cull_arrays(c, gl_element(type, indices, count - 1)))
+        return;
+#endif
+#if TGL_HAS(LOCKED_ARRAYS)
+    if (gl_draw_locked(mode, 0, count, type, indices))
+        return;
+#endif
+#if TGL_HAS(VERTEX_CACHE)
+    if (gl_draw_elements(mode, count, type, indices))
+        return;
+#endif
+    glBegin(mode);
+    for (i = 0; i < count; i++)
+        glArrayElement(gl_element(type, indices, i));
+    glEnd();
+}
+
 void glopEnableClientState(GLParam *p)
 {
     gl_get_context()->client_states |= p[1].i;
@@ -430,6 +765,9 @@ void glopVertexPointer(GLParam *p)
     c->vertex_array_size = p[1].i;
     c->vertex_array_stride = p[2].i;
     c->vertex_array = p[3].p;
+#if TGL_HAS(BOUNDS_CULLING)
+    c->vertex_array_bounded = 0;
+#endif
 }
 
 void glVertexPointer(GLint size,
@@ -455,6 +793,70 @@ void glVertexPointer(GLint size,
     gl_add_op(p);
 }
 
+void glVertexBoundsTGL(const GLfloat *min, const GLfloat *max)
+{
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+#if TGL_HAS(BOUNDS_CULLING)
+    c->vertex_array_bounded = min != NULL && max != NULL;
+    if (c->vertex_array_bounded) {
+        c->vertex_array_min = gl_V3_New(min[0], min[1], min[2]);
+        c->vertex_array_max = gl_V3_New(max[0], max[1], max[2]);
+    }
+#else
+    (void) c;
+    (void) min;
+    (void) max;
+#endif
+}
+
+void glLockArraysEXT(GLint first, GLsizei count)
+{
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+#if TGL_HAS(LOCKED_ARRAYS)
+    glUnlockArraysEXT();
+    if (first < 0 || count <= 0) {
+#if TGL_HAS(ERROR_CHECK)
+#define ERROR_FLAG GL_INVALID_VALUE
+#include "error_check.h"
+#else
+        return;
+#endif
+    }
+    /* without memory, the arrays are drawn as if they were not locked */
+    if (count > INT_MAX / (GLsizei) sizeof(GLVertex))
+        return;
+    c->locked_vertex = gl_malloc(count * sizeof(GLVertex));
+    c->locked_valid = gl_zalloc(count);
+    if (c->locked_vertex == NULL || c->locked_valid == NULL) {
+        glUnlockArraysEXT();
+        return;
+    }
+    c->locked_first = first;
+    c->locked_count = count;
+#else
+    (void) c;
+    (void) first;
+    (void) count;
+#endif
+}
+
+void glUnlockArraysEXT(void)
+{
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+#if TGL_HAS(LOCKED_ARRAYS)
+    gl_free(c->locked_vertex);
+    gl_free(c->locked_valid);
+    c->locked_vertex = NULL;
+    c->locked_valid = NULL;
+    c->locked_count = 0;
+#else
+    (void) c;
+#endif
+}
+
 void glopColorPointer(GLParam *p)
 {
     GLContext *c = gl_get_context();
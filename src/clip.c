@@ -102,6 +102,7 @@ void gl_draw_point(GLVertex *p0)
 {
     GLContext *c = gl_get_context();
     if (p0->clip_code == 0) {
+        gl_light_lazy(c, p0);
 #if TGL_HAS(ALT_RENDERMODES)
         if (c->render_mode == GL_SELECT) {
             gl_add_select(p0->zp.z, p0->zp.z);
@@ -169,6 +170,10 @@ void gl_draw_line(GLVertex *p1, GLVertex *p2)
     cc1 = p1->clip_code;
     cc2 = p2->clip_code;
 
+    if ((cc1 & cc2) == 0) {
+        gl_light_lazy(c, p1);
+        gl_light_lazy(c, p2);
+    }
     if ((cc1 | cc2) == 0) {
 #if TGL_HAS(ALT_RENDERMODES)
         if (c->render_mode == GL_SELECT) {
@@ -248,6 +253,9 @@ static void updateTmp(GLContext *c,
             p0->tex_coord.Y + (p1->tex_coord.Y - p0->tex_coord.Y) * t;
     }
 
+#if TGL_HAS(LAZY_LIGHTING)
+    q->shaded = 1;
+#endif
     q->clip_code = gl_clipcode(q->pc.X, q->pc.Y, q->pc.Z, q->pc.W);
     if (q->clip_code == 0)
         gl_transform_to_viewport_clip_c(c, q);
@@ -259,6 +267,51 @@ static void gl_draw_triangle_clip(GLContext *c,
                                   GLVertex *p2,
                                   GLint clip_bit);
 
+#if TGL_HAS(GUARD_BAND)
+/*
+ * A filled triangle crossing only the left, right, top or bottom planes can be
+ * handed to the rasterizers as is when the viewport is the whole framebuffer,
+ * and its vertices stay in front of the eye and within the guard band: rows and
+ * spans are cut to the framebuffer while rasterizing. The vertices outside of
+ * the view volume are projected to the window on success. Textured triangles
+ * are clipped: the perspective correction interpolates s * z and t * z with
+ * the screen z rather than 1 / w, which only holds on small triangles.
+ */
+static GLint gl_guard_band_c(GLContext *c,
+                             GLVertex *p0,
+                             GLVertex *p1,
+                             GLVertex *p2,
+                             GLint co)
+{
+    GLVertex *p[3] = {p0, p1, p2};
+    GLint i, xsize = c->viewport.xsize, ysize = c->viewport.ysize;
+
+    if ((co & (CLIP_ZMIN | CLIP_ZMAX)) || c->texture_2d_enabled ||
+        c->draw_triangle_front != gl_draw_triangle_fill ||
+        c->draw_triangle_back != gl_draw_triangle_fill)
+        return 0;
+    /* the scanline rasterizer steps x in 16.16 fixed point */
+    if (c->viewport.xmin != 0 || c->viewport.ymin != 0 ||
+        xsize != c->zb->xsize || ysize != c->zb->ysize ||
+        xsize + 2 * TGL_GUARD_BAND >= 32768)
+        return 0;
+
+    for (i = 0; i < 3; i++)
+        if (p[i]->clip_code && !(p[i]->pc.W > 0))
+            return 0;
+    for (i = 0; i < 3; i++) {
+        GLVertex *v = p[i];
+        if (v->clip_code == 0)
+            continue;
+        gl_transform_to_viewport_clip_c(c, v);
+        if (v->zp.x <= -TGL_GUARD_BAND || v->zp.x >= xsize + TGL_GUARD_BAND ||
+            v->zp.y <= -TGL_GUARD_BAND || v->zp.y >= ysize + TGL_GUARD_BAND)
+            return 0;
+    }
+    return 1;
+}
+#endif
+
 /* Internal helper that takes context - avoids redundant gl_get_context() in hot
  * paths */
 static void gl_draw_triangle_c(GLContext *c,
@@ -274,6 +327,12 @@ static void gl_draw_triangle_c(GLContext *c,
 
     co = cc[0] | cc[1] | cc[2];
 
+#if TGL_HAS(GUARD_BAND)
+    if (co != 0 && (cc[0] & cc[1] & cc[2]) == 0 &&
+        gl_guard_band_c(c, p0, p1, p2, co))
+        co = 0;
+#endif
+
     /* we handle the non clipped case here to go faster */
     if (co == 0) {
         GLfloat norm;
@@ -293,26 +352,26 @@ static void gl_draw_triangle_c(GLContext *c,
             if (c->current_cull_face == GL_BACK) {
                 if (front == 0)
                     return;
-                c->draw_triangle_front(p0, p1, p2);
             } else if (c->current_cull_face == GL_FRONT) {
                 if (front != 0)
                     return;
-                c->draw_triangle_back(p0, p1, p2);
             } else {
                 return;
             }
+        }
+
+        gl_light_lazy_triangle(c, p0, p1, p2);
+        if (front) {
+            c->draw_triangle_front(p0, p1, p2);
         } else {
-            /* no culling */
-            if (front) {
-                c->draw_triangle_front(p0, p1, p2);
-            } else {
-                c->draw_triangle_back(p0, p1, p2);
-            }
+            c->draw_triangle_back(p0, p1, p2);
         }
     } else {
         /* GLint c_and = cc[0] & cc[1] & cc[2];*/
         if ((cc[0] & cc[1] & cc[2]) ==
             0) { /* Don't draw a triangle with no points*/
+            /* the clipped vertices interpolate the colors */
+            gl_light_lazy_triangle(c, p0, p1, p2);
             gl_draw_triangle_clip(c, p0, p1, p2, 0);
         }
     }
@@ -443,6 +502,128 @@ int count_triangles, count_triangles_textured, count_pixels;
 #warning "Compile with PROFILE slows down everything"
 #endif
 
+/* Hand a triangle over to func, through the tile bins or hierarchical Z. */
+static inline void gl_fill_triangle(ZBuffer *zb,
+                                    ZB_fillTriangleFunc func,
+                                    GLint dt,
+                                    GLint dw,
+                                    ZBufferPoint *p0,
+                                    ZBufferPoint *p1,
+                                    ZBufferPoint *p2)
+{
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+    (void) dt;
+    (void) dw;
+    ZB_binTriangle(zb, func, p0, p1, p2);
+#elif TGL_HAS(HIERARCHICAL_Z)
+    ZB_fillTriangleHiZ(zb, func, dt, dw, p0, p1, p2);
+#else
+    (void) dt;
+    (void) dw;
+    func(zb, p0, p1, p2);
+#endif
+}
+
+/* The rasterizer variant for the current state. */
+static ZB_fillTriangleFunc gl_triangle_func(GLContext *c, GLint dt, GLint dw)
+{
+#if TGL_HAS(BLEND)
+    GLint bv = ZB_getBlendVariant(c->zb);
+#endif
+
+    if (c->texture_2d_enabled) {
+#if TGL_HAS(BLEND)
+        if (bv != ZTRI_BLEND_NONE)
+            return ZB_getTriangleFunc(zb_triangle_dispatch->textured[bv], dt,
+                                      dw);
+        return ZB_getTriangleFunc(zb_triangle_dispatch->textured_noblend, dt,
+                                  dw);
+#else
+        return ZB_getTriangleFunc(zb_triangle_dispatch->textured_noblend, dt,
+                                  dw);
+#endif
+    } else if (c->current_shade_model == GL_SMOOTH) {
+#if TGL_HAS(BLEND)
+        if (bv != ZTRI_BLEND_NONE)
+            return ZB_getTriangleFunc(zb_triangle_dispatch->smooth[bv], dt, dw);
+        return ZB_getTriangleFunc(zb_triangle_dispatch->smooth_noblend, dt, dw);
+#else
+        return ZB_getTriangleFunc(zb_triangle_dispatch->smooth_noblend, dt, dw);
+#endif
+    } else {
+#if TGL_HAS(BLEND)
+        if (bv != ZTRI_BLEND_NONE)
+            return ZB_getTriangleFunc(zb_triangle_dispatch->flat[bv], dt, dw);
+        return ZB_getTriangleFunc(zb_triangle_dispatch->flat_noblend, dt, dw);
+#else
+        return ZB_getTriangleFunc(zb_triangle_dispatch->flat_noblend, dt, dw);
+#endif
+    }
+}
+
+/* Occlusion query: count the pixels that are about to pass. */
+static inline ZB_fillTriangleFunc gl_samples_func(GLContext *c, GLint dt)
+{
+    const ZB_fillTriangleFunc *samples =
+        c->texture_2d_enabled ? zb_triangle_dispatch->samples_textured
+                              : zb_triangle_dispatch->samples;
+    return samples[dt != 0];
+}
+
+#if TGL_HAS(DEPTH_PREPASS)
+/*
+ * Depth only variant to defer the triangle with, or NULL to draw it right
+ * away: the prepass takes the opaque triangles writing the depth they test,
+ * and none while an occlusion query counts their pixels.
+ */
+static ZB_fillTriangleFunc gl_prepass_func(GLContext *c, GLint dt, GLint dw)
+{
+    if (!c->zb->depth_prepass || !dt || !dw || c->current_query ||
+        ZB_getBlendVariant(c->zb) != ZTRI_BLEND_NONE)
+        return NULL;
+    return c->texture_2d_enabled ? zb_triangle_dispatch->depth_textured
+                                 : zb_triangle_dispatch->depth;
+}
+#endif
+
+#if GL_BATCHED_SETUP
+/* Draw the queued triangles, from the setup computed for all of them. */
+void gl_flush_triangles(GLContext *c)
+{
+    ZBufferTriangles *t = &c->triangles;
+    ZBuffer *zb = c->zb;
+    GLint dt = zb->depth_test;
+    GLint dw = zb->depth_write;
+    ZB_fillTriangleFunc func, samples = NULL;
+    GLint i;
+
+    if (t->n == 0)
+        return;
+    func = gl_triangle_func(c, dt, dw);
+    if (c->current_query)
+        samples = gl_samples_func(c, dt);
+    if (c->texture_2d_enabled)
+        ZB_setupTriangles(t, ZB_SETUP_RGB | ZB_SETUP_STZ);
+    else if (c->current_shade_model == GL_SMOOTH)
+        ZB_setupTriangles(t, ZB_SETUP_RGB);
+    else
+        ZB_setupTriangles(t, 0);
+
+    for (i = 0; i < t->n; i++) {
+        ZBufferPoint p[3];
+        ZBufferSetup setup;
+
+        ZB_getTriangle(t, i, p, &setup);
+        zb->setup = &setup;
+        if (samples)
+            gl_fill_triangle(zb, samples, dt, dw, &p[0], &p[1], &p[2]);
+        gl_fill_triangle(zb, func, dt, dw, &p[0], &p[1], &p[2]);
+    }
+    zb->setup = NULL;
+    t->n = 0;
+}
+#endif
+
 /* see vertex.c to see how the draw functions are assigned.*/
 void gl_draw_triangle_fill(GLVertex *p0, GLVertex *p1, GLVertex *p2)
 {
@@ -465,39 +646,33 @@ void gl_draw_triangle_fill(GLVertex *p0, GLVertex *p1, GLVertex *p2)
         }
 #endif
         ZB_setTexture(zb, c->current_texture->images[0].pixmap);
-#if TGL_HAS(BLEND)
-        if (zb->enable_blend)
-            func = ZB_getTriangleFunc(zb_triangle_dispatch.textured, dt, dw);
-        else
-            func = ZB_getTriangleFunc(zb_triangle_dispatch.textured_noblend, dt,
-                                      dw);
-#else
-        func =
-            ZB_getTriangleFunc(zb_triangle_dispatch.textured_noblend, dt, dw);
-#endif
-    } else if (c->current_shade_model == GL_SMOOTH) {
-#if TGL_HAS(BLEND)
-        if (zb->enable_blend)
-            func = ZB_getTriangleFunc(zb_triangle_dispatch.smooth, dt, dw);
-        else
-            func =
-                ZB_getTriangleFunc(zb_triangle_dispatch.smooth_noblend, dt, dw);
-#else
-        func = ZB_getTriangleFunc(zb_triangle_dispatch.smooth_noblend, dt, dw);
-#endif
-    } else {
-#if TGL_HAS(BLEND)
-        if (zb->enable_blend)
-            func = ZB_getTriangleFunc(zb_triangle_dispatch.flat, dt, dw);
-        else
-            func =
-                ZB_getTriangleFunc(zb_triangle_dispatch.flat_noblend, dt, dw);
-#else
-        func = ZB_getTriangleFunc(zb_triangle_dispatch.flat_noblend, dt, dw);
+    }
+
+#if GL_BATCHED_SETUP
+    if (c->batch_triangles) {
+        ZB_addTriangle(&c->triangles, &p0->zp, &p1->zp, &p2->zp);
+        if (c->triangles.n == ZB_BATCH_SIZE)
+            gl_flush_triangles(c);
+        return;
+    }
 #endif
+
+#if TGL_HAS(DEPTH_PREPASS)
+    func = gl_prepass_func(c, dt, dw);
+    if (func) {
+        ZB_prepassTriangle(zb, func, gl_triangle_func(c, 1, 0), &p0->zp,
+                           &p1->zp, &p2->zp);
+        return;
     }
+    /* after the triangles deferred before this one */
+    ZB_flushPrepass(zb);
+#endif
 
-    func(zb, &p0->zp, &p1->zp, &p2->zp);
+    func = gl_triangle_func(c, dt, dw);
+    if (c->current_query)
+        gl_fill_triangle(zb, gl_samples_func(c, dt), dt, dw, &p0->zp,
+                         &p1->zp, &p2->zp);
+    gl_fill_triangle(zb, func, dt, dw, &p0->zp, &p1->zp, &p2->zp);
 }
 
 /* Render a clipped triangle in line mode */
@@ -348,7 +348,7 @@ void glGetIntegerv(GLint pname, GLint *params)
         params[0] = 0;
         break;
     case GL_POLYGON_MAX_VERTEX:
-        params[0] = POLYGON_MAX_VERTEX;
+        params[0] = INT_MAX; /* any number of vertices */
         break;
     case GL_MAX_VIEWPORT_DIMS:
         params[0] = 4096;
@@ -535,6 +535,13 @@ void glGetIntegerv(GLint pname, GLint *params)
     case GL_DEPTH_FUNC:
         *params = GL_LESS;
         break;
+    case GL_DEPTH_PREPASS_TGL:
+#if TGL_HAS(DEPTH_PREPASS)
+        *params = c->zb->depth_prepass;
+#else
+        *params = GL_FALSE;
+#endif
+        break;
 
     default:
         tgl_warning("glGet: option not implemented");
@@ -611,7 +618,11 @@ void glGetFloatv(GLint pname, GLfloat *v)
         v[3] = c->rastervertex.pc.W;
         break;
     case GL_CURRENT_RASTER_DISTANCE:
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+        *v = gl_fixed_to_float(c->rastervertex.ec.v[2]);
+#else
         *v = c->rastervertex.ec.Z;
+#endif
         break;
     case GL_LINE_WIDTH_RANGE:
         v[0] = v[1] = 1.0f;
@@ -7,7 +7,9 @@ static const GLContext empty_gl_ctx = {0};
 static void initSharedState(GLContext *c)
 {
     GLSharedState *s = &c->shared_state;
-    s->lists = gl_zalloc(sizeof(GLList *) * MAX_DISPLAY_LISTS);
+    s->list_slots = LIST_MIN_SIZE;
+    s->list_next = 1;
+    s->lists = gl_zalloc(sizeof(GLList *) * s->list_slots);
     if (!s->lists)
         gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
     s->texture_hash_table =
@@ -24,16 +26,9 @@ static void initSharedState(GLContext *c)
 static void endSharedState(GLContext *c)
 {
     GLSharedState *s = &c->shared_state;
-    for (GLint i = 0; i < MAX_DISPLAY_LISTS; i++)
+    for (GLuint i = 0; i < s->list_slots; i++)
         if (s->lists[i]) {
-            GLList *l = s->lists[i];
-            GLParamBuffer *pb = l->first_op_buffer;
-            while (pb) {
-                GLParamBuffer *pb1 = pb->next;
-                gl_free(pb);
-                pb = pb1;
-            }
-            gl_free(l);
+            gl_free_list(s->lists[i]);
             s->lists[i] = NULL;
         }
     gl_free(s->lists);
@@ -198,6 +193,7 @@ void glInit(void *zbuffer1)
 
     /* buffer */
     c->boundarraybuffer = 0;
+    c->boundelementbuffer = 0;
     c->boundvertexbuffer = 0;
     c->boundcolorbuffer = 0;
     c->boundnormalbuffer = 0;
@@ -206,6 +202,7 @@ void glInit(void *zbuffer1)
     /* lists */
     c->exec_flag = 1;
     c->compile_flag = 0;
+    gl_set_dispatch(c);
     c->print_flag = 0;
     c->listbase = 0;
     c->in_begin = 0;
@@ -245,6 +242,9 @@ void glInit(void *zbuffer1)
     c->current_color_material_mode = GL_FRONT_AND_BACK;
     c->current_color_material_type = GL_AMBIENT_AND_DIFFUSE;
     c->color_material_enabled = 0;
+#if TGL_HAS(BATCHED_LIGHTING)
+    gl_init_lighting(c);
+#endif
 
     /* textures */
     glInitTextures(c);
@@ -260,6 +260,9 @@ void glInit(void *zbuffer1)
     c->current_color.Y = 1.0;
     c->current_color.Z = 1.0;
     c->current_color.W = 0.0;
+#if TGL_HAS(LAZY_LIGHTING)
+    c->color_material = c->current_color;
+#endif
 
     c->current_normal.X = 1.0;
     c->current_normal.Y = 0.0;
@@ -330,6 +333,8 @@ void glInit(void *zbuffer1)
     glLoadIdentity();
 
     c->matrix_model_projection_updated = 1;
+    c->matrix_model_view_inv_updated = 1;
+    c->apply_texture_matrix = 0;
 
     /* opengl 1.1 arrays */
     c->client_states = 0;
@@ -383,6 +388,10 @@ void glClose(void)
             gl_free(b);
         }
     }
+#endif
+#if TGL_HAS(LOCKED_ARRAYS)
+    gl_free(c->locked_vertex);
+    gl_free(c->locked_valid);
 #endif
     endSharedState(c);
     gl_ctx = empty_gl_ctx;
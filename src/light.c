@@ -1,22 +1,143 @@
 #include "msghandling.h"
 #include "zgl.h"
 
-void glopMaterial(GLParam *p)
+#if TGL_HAS(BATCHED_LIGHTING)
+/*
+ * The linear interpolation of pow(x, e) is off by up to e^2 / 8 / size^2,
+ * near x = 1: two color levels for a shininess of 128, with 512 intervals.
+ * Tabulating pow(x, e / 2^n) instead, squared n times by the lookup, divides
+ * that by 2^n: n is the smallest keeping it under half a level. Below an
+ * exponent of 1, the interpolation is off near x = 0 instead, by up to 3
+ * levels for 0.5: pow() is called for these.
+ */
+static void gl_pow_table(GLPowTable *t, GLfloat e)
+{
+    const GLfloat size = TGL_POW_TABLE_SIZE;
+    GLint n = 0;
+
+    while (n < 16 && e * e * 255 >= 4 * size * size * (1 << n))
+        n++;
+    t->squarings = e > 0 && e < 1 ? -1 : n;
+    t->e = e;
+    for (GLint i = 0; i <= TGL_POW_TABLE_SIZE; i++) {
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+        t->v[i] = gl_fixed(pow(i / size, e / (1 << n)));
+#else
+        t->v[i] = pow(i / size, e / (1 << n));
+#endif
+    }
+}
+#endif
+
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+static inline GLfixed gl_pow_lookup(const GLPowTable *t, GLfixed x)
+{
+    GLint f, i;
+    GLfixed y;
+
+    x = x < 0 ? 0 : x > GL_FIXED_ONE ? GL_FIXED_ONE : x;
+    if (t->squarings < 0)
+        return gl_fixed(pow(gl_fixed_to_float(x), t->e));
+    f = x * TGL_POW_TABLE_SIZE;
+    i = f >> GL_FIXED_BITS;
+    if (i > TGL_POW_TABLE_SIZE - 1)
+        i = TGL_POW_TABLE_SIZE - 1;
+    f -= i << GL_FIXED_BITS;
+    y = t->v[i] + gl_fixed_mul(f, t->v[i + 1] - t->v[i]);
+    for (GLint k = 0; k < t->squarings; k++)
+        y = gl_fixed_mul(y, y);
+    return y;
+}
+#elif TGL_HAS(BATCHED_LIGHTING)
+static inline GLfloat gl_pow_lookup(const GLPowTable *t, GLfloat x)
+{
+    GLfloat f, y;
+    GLint i;
+
+    x = clampf(x, 0, 1);
+    if (t->squarings < 0)
+        return pow(x, t->e);
+    f = x * TGL_POW_TABLE_SIZE;
+    i = (GLint) f;
+    if (i > TGL_POW_TABLE_SIZE - 1)
+        i = TGL_POW_TABLE_SIZE - 1;
+    f -= i;
+    y = t->v[i] + f * (t->v[i + 1] - t->v[i]);
+    for (GLint k = 0; k < t->squarings; k++)
+        y *= y;
+    return y;
+}
+#endif
+
+#if TGL_HAS(BATCHED_LIGHTING)
+/* The colors of l multiplied by the ones of the front material. */
+static void gl_light_products(GLContext *c, GLLight *l)
+{
+    GLMaterial *m = &c->materials[0];
+
+    for (GLint i = 0; i < 3; i++) {
+        l->ambient_m.v[i] = l->ambient.v[i] * m->ambient.v[i];
+        l->diffuse_m.v[i] = l->diffuse.v[i] * m->diffuse.v[i];
+        l->specular_m.v[i] = l->specular.v[i] * m->specular.v[i];
+    }
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    /* and the rest of l, which glLight may have changed too */
+    for (GLint i = 0; i < 3; i++) {
+        l->fx.ambient_m[i] = gl_fixed(l->ambient_m.v[i]);
+        l->fx.diffuse_m[i] = gl_fixed(l->diffuse_m.v[i]);
+        l->fx.specular_m[i] = gl_fixed(l->specular_m.v[i]);
+        l->fx.position[i] = gl_fixed(l->position.v[i]);
+        l->fx.norm_position[i] = gl_fixed(l->norm_position.v[i]);
+        l->fx.norm_spot_direction[i] = gl_fixed(l->norm_spot_direction.v[i]);
+        l->fx.attenuation[i] = gl_fixed(l->attenuation[i]);
+    }
+    l->fx.cos_spot_cutoff = gl_fixed(l->cos_spot_cutoff);
+    l->fx.at_infinity = l->position.v[3] == 0;
+    l->fx.spot = l->spot_cutoff != 180;
+#endif
+}
+
+/* After the material or the ambient light model changed. */
+static void gl_update_lighting(GLContext *c)
+{
+    GLMaterial *m = &c->materials[0];
+    GLLight *l;
+
+    for (GLint i = 0; i < 3; i++)
+        c->light_model_color.v[i] =
+            m->emission.v[i] + m->ambient.v[i] * c->ambient_light_model.v[i];
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    for (GLint i = 0; i < 3; i++)
+        c->fx.light_model_color[i] = gl_fixed(c->light_model_color.v[i]);
+#endif
+    for (l = c->first_light; l != NULL; l = l->next)
+        gl_light_products(c, l);
+}
+
+void gl_init_lighting(GLContext *c)
+{
+    for (GLint i = 0; i < MAX_LIGHTS; i++) {
+        gl_pow_table(&c->lights[i].spot_table, c->lights[i].spot_exponent);
+        gl_light_products(c, &c->lights[i]);
+    }
+    for (GLint i = 0; i < 2; i++)
+        gl_pow_table(&c->materials[i].shininess_table,
+                     c->materials[i].shininess);
+    gl_update_lighting(c);
+}
+#endif
+
+/* Set the parameter type of the material of the faces mode to v. */
+static void gl_material(GLContext *c, GLint mode, GLint type, const GLfloat *v)
 {
-    GLContext *c = gl_get_context();
-    GLint mode = p[1].i;
-    GLint type = p[2].i;
-    GLfloat v[4];
-    v[0] = p[3].f;
-    v[1] = p[4].f;
-    v[2] = p[5].f;
-    v[3] = p[6].f;
     GLint i;
     GLMaterial *m;
 
+#if TGL_HAS(LOCKED_ARRAYS)
+    c->light_gen++;
+#endif
     if (mode == GL_FRONT_AND_BACK) {
-        p[1].i = GL_FRONT;
-        glopMaterial(p);
+        gl_material(c, GL_FRONT, type, v);
         mode = GL_BACK;
     }
     if (mode == GL_FRONT)
@@ -63,6 +184,42 @@ void glopMaterial(GLParam *p)
         /* default: return;*/
 #endif
     }
+#if TGL_HAS(BATCHED_LIGHTING)
+    /* rebuilt only when the exponent changes: programs often set the same
+       shininess again for every object they draw */
+    if (type == GL_SHININESS && m->shininess_table.e != m->shininess)
+        gl_pow_table(&m->shininess_table, m->shininess);
+    gl_update_lighting(c);
+#endif
+}
+
+/* The material given the color col, by glColor with GL_COLOR_MATERIAL. */
+void gl_color_material(GLContext *c, const V4 *col)
+{
+#if TGL_HAS(LAZY_LIGHTING)
+    c->color_material = *col;
+#endif
+    gl_material(c, c->current_color_material_mode,
+                c->current_color_material_type, col->v);
+}
+
+void glopMaterial(GLParam *p)
+{
+    GLContext *c = gl_get_context();
+    GLfloat v[4];
+    v[0] = p[3].f;
+    v[1] = p[4].f;
+    v[2] = p[5].f;
+    v[3] = p[6].f;
+
+#if TGL_HAS(LAZY_LIGHTING)
+    if (c->in_begin) {
+        gl_light_pending(c);
+        /* the color glColor left to the vertices, as the material had it */
+        gl_color_material_update(c, &c->current_color);
+    }
+#endif
+    gl_material(c, p[1].i, p[2].i, v);
 }
 
 void glopColorMaterial(GLParam *p)
@@ -73,6 +230,9 @@ void glopColorMaterial(GLParam *p)
 
     c->current_color_material_mode = mode;
     c->current_color_material_type = type;
+#if TGL_HAS(LOCKED_ARRAYS)
+    c->light_gen++;
+#endif
 }
 
 void glopLight(GLParam *p)
@@ -94,6 +254,9 @@ void glopLight(GLParam *p)
 #endif
 
         l = &c->lights[light - GL_LIGHT0];
+#if TGL_HAS(LOCKED_ARRAYS)
+    c->light_gen++;
+#endif
 
     for (i = 0; i < 4; i++)
         if (type != GL_POSITION && type != GL_SPOT_DIRECTION &&
@@ -107,12 +270,21 @@ void glopLight(GLParam *p)
     switch (type) {
     case GL_AMBIENT:
         l->ambient = v;
+#if TGL_HAS(BATCHED_LIGHTING)
+        gl_light_products(c, l);
+#endif
         break;
     case GL_DIFFUSE:
         l->diffuse = v;
+#if TGL_HAS(BATCHED_LIGHTING)
+        gl_light_products(c, l);
+#endif
         break;
     case GL_SPECULAR:
         l->specular = v;
+#if TGL_HAS(BATCHED_LIGHTING)
+        gl_light_products(c, l);
+#endif
         break;
     case GL_POSITION: {
         V4 pos;
@@ -137,6 +309,10 @@ void glopLight(GLParam *p)
         break;
     case GL_SPOT_EXPONENT:
         l->spot_exponent = v.v[0];
+#if TGL_HAS(BATCHED_LIGHTING)
+        if (l->spot_table.e != l->spot_exponent)
+            gl_pow_table(&l->spot_table, l->spot_exponent);
+#endif
         break;
     case GL_SPOT_CUTOFF: {
         GLfloat a = v.v[0];
@@ -166,6 +342,9 @@ void glopLight(GLParam *p)
 #endif
         return;
     }
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    gl_light_products(c, l);
+#endif
 }
 
 void glopLightModel(GLParam *p)
@@ -175,10 +354,16 @@ void glopLightModel(GLParam *p)
     GLint *v = &p[2].i;
     GLint i;
 
+#if TGL_HAS(LOCKED_ARRAYS)
+    c->light_gen++;
+#endif
     switch (pname) {
     case GL_LIGHT_MODEL_AMBIENT:
         for (i = 0; i < 4; i++)
             c->ambient_light_model.v[i] = p[2 + i].f;
+#if TGL_HAS(BATCHED_LIGHTING)
+        gl_update_lighting(c);
+#endif
         break;
     case GL_LIGHT_MODEL_LOCAL_VIEWER:
         c->local_light_model = (GLint) v[0];
@@ -199,8 +384,15 @@ void gl_enable_disable_light(GLint light, GLint v)
 {
     GLContext *c = gl_get_context();
     GLLight *l = &c->lights[light];
+#if TGL_HAS(LOCKED_ARRAYS)
+    c->light_gen++;
+#endif
     if (v && !l->enabled) {
         l->enabled = 1;
+#if TGL_HAS(BATCHED_LIGHTING)
+        /* the products of the disabled lights are not kept up to date */
+        gl_light_products(c, l);
+#endif
         l->next = c->first_light;
         c->first_light = l;
         l->prev = NULL;
@@ -225,8 +417,315 @@ void glSetEnableSpecular(GLint s)
 }
 void glopSetEnableSpecular(GLParam *p)
 {
-    gl_get_context()->zEnableSpecular = p[1].i;
+    GLContext *c = gl_get_context();
+    c->zEnableSpecular = p[1].i;
+#if TGL_HAS(LOCKED_ARRAYS)
+    c->light_gen++;
+#endif
+}
+#if TGL_HAS(BATCHED_LIGHTING)
+void gl_shade_vertex(GLVertex *v)
+{
+    gl_shade_vertices(gl_get_context(), &v, 1);
 }
+
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+/* 1E-3, below which the lengths are taken as 0 */
+#define GL_FIXED_EPSILON 66
+
+/*
+ * The floating point gl_shade_vertices() below, in fixed point. The colors
+ * are set along with zp.r/g/b, which the rasterizers read.
+ */
+void gl_shade_vertices(GLContext *c, GLVertex **v, GLint n)
+{
+    GLMaterial *m = &c->materials[0];
+    GLint twoside = c->light_model_two_side;
+    GLfixed nx[GL_LIGHT_BATCH], ny[GL_LIGHT_BATCH], nz[GL_LIGHT_BATCH];
+    GLfixed ex[GL_LIGHT_BATCH], ey[GL_LIGHT_BATCH], ez[GL_LIGHT_BATCH];
+    GLfixed dx[GL_LIGHT_BATCH], dy[GL_LIGHT_BATCH], dz[GL_LIGHT_BATCH];
+    GLfixed att[GL_LIGHT_BATCH], dot[GL_LIGHT_BATCH], spec[GL_LIGHT_BATCH];
+    GLfixed R[GL_LIGHT_BATCH], G[GL_LIGHT_BATCH], B[GL_LIGHT_BATCH];
+    GLfixed vx[GL_LIGHT_BATCH], vy[GL_LIGHT_BATCH], vz[GL_LIGHT_BATCH];
+    GLLight *l;
+    GLint i;
+
+    for (i = 0; i < n; i++) {
+        GLVertex *p = v[i];
+        nx[i] = p->normal.v[0];
+        ny[i] = p->normal.v[1];
+        nz[i] = p->normal.v[2];
+        ex[i] = p->ec.v[0];
+        ey[i] = p->ec.v[1];
+        ez[i] = p->ec.v[2];
+        R[i] = c->fx.light_model_color[0];
+        G[i] = c->fx.light_model_color[1];
+        B[i] = c->fx.light_model_color[2];
+        spec[i] = 0;
+        /* the specular light is along d - (vx, vy, vz) */
+        if (c->local_light_model) {
+            V3X vcoord = p->ec;
+            gl_fixed_norm3(vcoord.v);
+            vx[i] = vcoord.v[0];
+            vy[i] = vcoord.v[1];
+            vz[i] = vcoord.v[2];
+        } else {
+            vx[i] = 0;
+            vy[i] = 0;
+            vz[i] = GL_FIXED_ONE;
+        }
+    }
+
+    for (l = c->first_light; l != NULL; l = l->next) {
+        if (l->fx.at_infinity) {
+            /* light at infinity */
+            for (i = 0; i < n; i++) {
+                dx[i] = l->fx.norm_position[0];
+                dy[i] = l->fx.norm_position[1];
+                dz[i] = l->fx.norm_position[2];
+                att[i] = GL_FIXED_ONE;
+            }
+        } else {
+            /* distance attenuation */
+            const GLfixed *pos = l->fx.position, *a = l->fx.attenuation;
+            for (i = 0; i < n; i++) {
+                GLfixed d[3], dist, q;
+                d[0] = gl_fixed_add(pos[0], -ex[i]);
+                d[1] = gl_fixed_add(pos[1], -ey[i]);
+                d[2] = gl_fixed_add(pos[2], -ez[i]);
+                dist = gl_fixed_length(d[0], d[1], d[2]);
+                if (dist > GL_FIXED_EPSILON)
+                    gl_fixed_scale3(d, dist);
+                dx[i] = d[0];
+                dy[i] = d[1];
+                dz[i] = d[2];
+                q = gl_fixed_add(a[1], gl_fixed_mul(dist, a[2]));
+                q = gl_fixed_add(a[0], gl_fixed_mul(dist, q));
+                att[i] = gl_fixed_div(GL_FIXED_ONE, q);
+            }
+        }
+
+        /* 0 where the light does not shine on the vertex */
+        for (i = 0; i < n; i++) {
+            GLfixed d = gl_fixed_dot3(dx[i], nx[i], dy[i], ny[i], dz[i], nz[i]);
+            d = twoside && d < 0 ? -d : d;
+            dot[i] = d > 0 ? d : 0;
+        }
+
+        /* spot light: no contribution at all out of the cone */
+        if (l->fx.spot) {
+            const GLfixed *s = l->fx.norm_spot_direction;
+            for (i = 0; i < n; i++) {
+                GLfixed d;
+                if (dot[i] <= 0)
+                    continue;
+                d = -gl_fixed_dot3(dx[i], s[0], dy[i], s[1], dz[i], s[2]);
+                d = twoside && d < 0 ? -d : d;
+                att[i] = d < l->fx.cos_spot_cutoff
+                             ? 0
+                             : gl_fixed_mul(att[i],
+                                            gl_pow_lookup(&l->spot_table, d));
+            }
+        }
+
+        /* specular light */
+        if (c->zEnableSpecular) {
+            for (i = 0; i < n; i++) {
+                GLfixed sx = dx[i] - vx[i], sy = dy[i] - vy[i];
+                GLfixed sz = dz[i] - vz[i], d, len;
+                d = gl_fixed_dot3(nx[i], sx, ny[i], sy, nz[i], sz);
+                d = twoside && d < 0 ? -d : d;
+                if (!(dot[i] > 0 && d > 0)) {
+                    spec[i] = 0;
+                    continue;
+                }
+                d = d > GL_FIXED_ONE ? GL_FIXED_ONE : d;
+                len = gl_fixed_length(sx, sy, sz);
+                spec[i] = len > GL_FIXED_EPSILON
+                              ? gl_pow_lookup(&m->shininess_table,
+                                              gl_fixed_div(d, len))
+                              : gl_pow_lookup(&m->shininess_table, 0);
+            }
+        }
+
+        for (i = 0; i < n; i++) {
+            const GLfixed *am = l->fx.ambient_m, *dm = l->fx.diffuse_m;
+            const GLfixed *sm = l->fx.specular_m;
+            GLfixed r, g, b;
+            r = gl_fixed_dot3(am[0], GL_FIXED_ONE, dot[i], dm[0], spec[i],
+                              sm[0]);
+            g = gl_fixed_dot3(am[1], GL_FIXED_ONE, dot[i], dm[1], spec[i],
+                              sm[1]);
+            b = gl_fixed_dot3(am[2], GL_FIXED_ONE, dot[i], dm[2], spec[i],
+                              sm[2]);
+            R[i] = gl_fixed_add(R[i], gl_fixed_mul(att[i], r));
+            G[i] = gl_fixed_add(G[i], gl_fixed_mul(att[i], g));
+            B[i] = gl_fixed_add(B[i], gl_fixed_mul(att[i], b));
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        GLVertex *p = v[i];
+        GLfixed r = R[i] < 0 ? 0 : R[i] > GL_FIXED_ONE ? GL_FIXED_ONE : R[i];
+        GLfixed g = G[i] < 0 ? 0 : G[i] > GL_FIXED_ONE ? GL_FIXED_ONE : G[i];
+        GLfixed b = B[i] < 0 ? 0 : B[i] > GL_FIXED_ONE ? GL_FIXED_ONE : B[i];
+        p->color.v[0] = gl_fixed_to_float(r);
+        p->color.v[1] = gl_fixed_to_float(g);
+        p->color.v[2] = gl_fixed_to_float(b);
+        p->color.v[3] = m->diffuse.v[3];
+        p->zp.r = gl_fixed_zcolor(r);
+        p->zp.g = gl_fixed_zcolor(g);
+        p->zp.b = gl_fixed_zcolor(b);
+    }
+}
+#else
+/*
+ * The lighting model of the other gl_shade_vertex() below, for n vertices
+ * (up to GL_LIGHT_BATCH) at a time. The loops over the vertices have no
+ * branches, so that the compiler vectorizes them, except for the ones reading
+ * the power tables.
+ */
+void gl_shade_vertices(GLContext *c, GLVertex **v, GLint n)
+{
+    GLMaterial *m = &c->materials[0];
+    GLint twoside = c->light_model_two_side;
+    GLfloat nx[GL_LIGHT_BATCH], ny[GL_LIGHT_BATCH], nz[GL_LIGHT_BATCH];
+    GLfloat ex[GL_LIGHT_BATCH], ey[GL_LIGHT_BATCH], ez[GL_LIGHT_BATCH];
+    GLfloat dx[GL_LIGHT_BATCH], dy[GL_LIGHT_BATCH], dz[GL_LIGHT_BATCH];
+    GLfloat att[GL_LIGHT_BATCH], dot[GL_LIGHT_BATCH], spec[GL_LIGHT_BATCH];
+    GLfloat R[GL_LIGHT_BATCH], G[GL_LIGHT_BATCH], B[GL_LIGHT_BATCH];
+    GLfloat vx[GL_LIGHT_BATCH], vy[GL_LIGHT_BATCH], vz[GL_LIGHT_BATCH];
+    GLLight *l;
+    GLint i;
+
+    for (i = 0; i < n; i++) {
+        GLVertex *p = v[i];
+        nx[i] = p->normal.X;
+        ny[i] = p->normal.Y;
+        nz[i] = p->normal.Z;
+        ex[i] = p->ec.X;
+        ey[i] = p->ec.Y;
+        ez[i] = p->ec.Z;
+        R[i] = c->light_model_color.X;
+        G[i] = c->light_model_color.Y;
+        B[i] = c->light_model_color.Z;
+        spec[i] = 0;
+        /* the specular light is along d - (vx, vy, vz) */
+        if (c->local_light_model) {
+            V3 vcoord;
+            vcoord.X = p->ec.X;
+            vcoord.Y = p->ec.Y;
+            vcoord.Z = p->ec.Z;
+            gl_V3_Norm_Fast(&vcoord);
+            vx[i] = vcoord.X;
+            vy[i] = vcoord.Y;
+            vz[i] = vcoord.Z;
+        } else {
+            vx[i] = 0;
+            vy[i] = 0;
+            vz[i] = 1;
+        }
+    }
+
+    for (l = c->first_light; l != NULL; l = l->next) {
+        if (l->position.v[3] == 0) {
+            /* light at infinity */
+            for (i = 0; i < n; i++) {
+                dx[i] = l->norm_position.X;
+                dy[i] = l->norm_position.Y;
+                dz[i] = l->norm_position.Z;
+                att[i] = 1;
+            }
+        } else {
+            /* distance attenuation */
+            GLfloat px = l->position.X, py = l->position.Y;
+            GLfloat pz = l->position.Z;
+            GLfloat a0 = l->attenuation[0], a1 = l->attenuation[1];
+            GLfloat a2 = l->attenuation[2];
+            for (i = 0; i < n; i++) {
+                GLfloat x = px - ex[i], y = py - ey[i], z = pz - ez[i];
+                GLfloat dist, tmp;
+#if TGL_HAS(FISR)
+                tmp = fastInvSqrt(x * x + y * y + z * z);
+                dist = 0;
+#else
+                dist = sqrtf(x * x + y * y + z * z);
+                tmp = dist > 1E-3f ? 1 / dist : 1;
+#endif
+                dx[i] = x * tmp;
+                dy[i] = y * tmp;
+                dz[i] = z * tmp;
+                att[i] = 1.0f / (a0 + dist * (a1 + dist * a2));
+            }
+        }
+
+        /* 0 where the light does not shine on the vertex */
+        for (i = 0; i < n; i++) {
+            GLfloat d = dx[i] * nx[i] + dy[i] * ny[i] + dz[i] * nz[i];
+            d = twoside ? fabsf(d) : d;
+            dot[i] = d > 0 ? d : 0;
+        }
+
+        /* spot light: no contribution at all out of the cone */
+        if (l->spot_cutoff != 180) {
+            GLfloat sx = l->norm_spot_direction.X;
+            GLfloat sy = l->norm_spot_direction.Y;
+            GLfloat sz = l->norm_spot_direction.Z;
+            GLfloat cutoff = l->cos_spot_cutoff;
+            GLfloat spot[GL_LIGHT_BATCH];
+            for (i = 0; i < n; i++) {
+                GLfloat d = -(dx[i] * sx + dy[i] * sy + dz[i] * sz);
+                spot[i] = twoside ? fabsf(d) : d;
+            }
+            for (i = 0; i < n; i++)
+                if (dot[i] > 0)
+                    att[i] *= spot[i] < cutoff
+                                  ? 0
+                                  : gl_pow_lookup(&l->spot_table, spot[i]);
+        }
+
+        /* specular light */
+        if (c->zEnableSpecular) {
+            for (i = 0; i < n; i++) {
+                GLfloat sx = dx[i] - vx[i], sy = dy[i] - vy[i];
+                GLfloat sz = dz[i] - vz[i], d, tmp;
+                d = nx[i] * sx + ny[i] * sy + nz[i] * sz;
+                d = twoside ? fabsf(d) : d;
+                /* -1 where there is no specular light */
+                d = (dot[i] > 0) & (d > 0) ? clampf(d, 0, 1) : -1;
+#if TGL_HAS(FISR)
+                tmp = fastInvSqrt(sx * sx + sy * sy + sz * sz);
+                spec[i] = d < 0 ? d : d * tmp;
+#else
+                tmp = sqrtf(sx * sx + sy * sy + sz * sz);
+                spec[i] = d < 0 ? d : (tmp > 1E-3f ? d / tmp : 0);
+#endif
+            }
+            for (i = 0; i < n; i++)
+                spec[i] = spec[i] < 0
+                              ? 0
+                              : gl_pow_lookup(&m->shininess_table, spec[i]);
+        }
+
+        for (i = 0; i < n; i++) {
+            R[i] += att[i] * (l->ambient_m.X + dot[i] * l->diffuse_m.X +
+                              spec[i] * l->specular_m.X);
+            G[i] += att[i] * (l->ambient_m.Y + dot[i] * l->diffuse_m.Y +
+                              spec[i] * l->specular_m.Y);
+            B[i] += att[i] * (l->ambient_m.Z + dot[i] * l->diffuse_m.Z +
+                              spec[i] * l->specular_m.Z);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        v[i]->color.v[0] = clampf(R[i], 0, 1);
+        v[i]->color.v[1] = clampf(G[i], 0, 1);
+        v[i]->color.v[2] = clampf(B[i], 0, 1);
+        v[i]->color.v[3] = m->diffuse.v[3];
+    }
+}
+#endif
+#else
 /* non optimized lightening model */
 void gl_shade_vertex(GLVertex *v)
 {
@@ -327,8 +826,8 @@ void gl_shade_vertex(GLVertex *v)
 
                     gl_V3_Norm_Fast(&vcoord);
                     s.X = d.X - vcoord.X;
-                    s.Y = d.Y - vcoord.X;
-                    s.Z = d.Z - vcoord.X;
+                    s.Y = d.Y - vcoord.Y;
+                    s.Z = d.Z - vcoord.Z;
                 } else {
                     s.X = d.X;
                     s.Y = d.Y;
@@ -394,3 +893,4 @@ void gl_shade_vertex(GLVertex *v)
     v->color.v[2] = clampf(B, 0, 1);
     v->color.v[3] = A;
 }
+#endif
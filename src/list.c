@@ -1,3 +1,6 @@
+#include <float.h>
+#include <string.h>
+
 #include "msghandling.h"
 #include "zgl.h"
 
@@ -11,35 +14,154 @@ GLint op_table_size[] = {
 #include "opinfo.h"
 };
 
-static GLList *find_list(GLuint list)
+/*
+ * With GL_OP_CODE, each op is preceded by the label of run_list() calling its
+ * handler directly, stepping over it and jumping to the code of the next op.
+ * Replaying a list involves neither the tables above nor comparisons with
+ * OP_EndList.
+ */
+#if GL_OP_CODE
+static void *const *op_labels;
+
+/* Called with NULL, only sets op_labels. */
+static void run_list(GLParam *p)
 {
-    return gl_get_context()->shared_state.lists[list];
+    static void *const labels[] = {
+#define ADD_OP(a, b, c) &&op_##a,
+#include "opinfo.h"
+    };
+
+    if (!p) {
+        op_labels = labels;
+        return;
+    }
+    goto *p[0].p;
+#define ADD_OP(a, b, c)       \
+    op_##a:                   \
+    if (OP_##a == OP_EndList) \
+        return;               \
+    glop##a(p + 1);           \
+    p += b + 2;               \
+    goto *p[0].p;
+#include "opinfo.h"
 }
+#endif
 
-static void delete_list(GLint list)
+/* Set the code at q of the op following it, with GL_OP_CODE. */
+void gl_put_op_code(GLParam *q)
 {
-    GLContext *c = gl_get_context();
+#if GL_OP_CODE
+    if (!op_labels)
+        run_list(NULL);
+    q[0].p = op_labels[q[1].op];
+#else
+    (void) q;
+#endif
+}
 
-    GLList *l = find_list(list);
-    if (!l)
-        return;
+/* Store the op p at q, preceded by its code. Returns where the op is. */
+static GLParam *put_op(GLParam *q, const GLParam *p)
+{
+    for (GLint i = 0; i < op_table_size[p[0].op]; i++)
+        q[GL_OP_CODE + i] = p[i];
+    gl_put_op_code(q);
+    return q + GL_OP_CODE;
+}
+
+/* the slot of the name table for the list name, or of the empty slot where
+   it would go */
+static GLList **list_slot(GLSharedState *s, GLuint name)
+{
+    GLuint mask = s->list_slots - 1;
+    GLuint i = name * 2654435761u;
 
-    /* free param buffer */
-    GLParamBuffer *pb = l->first_op_buffer;
-    while (pb) {
-        GLParamBuffer *pb1 = pb->next;
-        gl_free(pb);
-        pb = pb1;
+    i = (i ^ i >> 16) & mask;
+    while (s->lists[i] && s->lists[i]->name != name)
+        i = (i + 1) & mask;
+    return &s->lists[i];
+}
+
+GLList *gl_find_list(GLuint list)
+{
+    return *list_slot(&gl_get_context()->shared_state, list);
+}
+
+/* Add l to the name table, twice as large once it is half full. */
+static GLint insert_list(GLSharedState *s, GLList *l)
+{
+    if ((s->list_count + 1) * 2 > s->list_slots) {
+        GLList **lists = s->lists;
+        GLuint n = s->list_slots;
+        GLList **table = gl_zalloc(sizeof(GLList *) * n * 2);
+        if (!table)
+            return 0;
+        s->lists = table;
+        s->list_slots = n * 2;
+        for (GLuint i = 0; i < n; i++)
+            if (lists[i])
+                *list_slot(s, lists[i]->name) = lists[i];
+        gl_free(lists);
     }
+    *list_slot(s, l->name) = l;
+    s->list_count++;
+    return 1;
+}
 
+/*
+ * Remove the list in the slot of index i from the name table, moving back
+ * the lists after it that would not be found anymore behind the hole.
+ */
+static void remove_list(GLSharedState *s, GLuint i)
+{
+    GLuint mask = s->list_slots - 1;
+    GLuint j = i;
+
+    s->lists[i] = NULL;
+    s->list_count--;
+    while (s->lists[j = (j + 1) & mask]) {
+        GLuint k = list_slot(s, s->lists[j]->name) - s->lists;
+        if (k == i) {
+            s->lists[i] = s->lists[j];
+            s->lists[j] = NULL;
+            i = j;
+        }
+    }
+}
+
+void gl_free_list(GLList *l)
+{
+#if TGL_HAS(LIST_FILES)
+    if (l->file)
+        gl_release_list_file(l->file);
+    else
+#endif
+        gl_free(l->ops);
     gl_free(l);
-    c->shared_state.lists[list] = NULL;
+}
+
+static void delete_list(GLuint list)
+{
+    GLSharedState *s = &gl_get_context()->shared_state;
+    GLList **slot = list_slot(s, list);
+
+    if (!*slot)
+        return;
+    gl_free_list(*slot);
+    remove_list(s, slot - s->lists);
+}
+
+/* Add the list l, replacing the list of its name. Returns 0 when out of
+   memory. */
+GLint gl_insert_list(GLList *l)
+{
+    delete_list(l->name);
+    return insert_list(&gl_get_context()->shared_state, l);
 }
 
 void glDeleteLists(GLuint list, GLuint range)
 {
 #include "error_check_no_context.h"
-    for (GLuint i = 0; i < list + range; i++)
+    for (GLuint i = 0; i < range; i++)
         glDeleteList(list + i);
 }
 
@@ -49,26 +171,77 @@ void glDeleteList(GLuint list)
     delete_list(list);
 }
 
-static GLList *alloc_list(GLint list)
+#if TGL_HAS(BOUNDS_CULLING)
+static void reset_bounds(GLList *l)
+{
+    l->bounded = 1;
+    l->in_begin = 0;
+    l->min.X = l->min.Y = l->min.Z = FLT_MAX;
+    l->max.X = l->max.Y = l->max.Z = -FLT_MAX;
+    for (GLint i = 0; i < 4; i++)
+        l->current[i] = -1;
+}
+#endif
+
+/*
+ * Make room for n more GLParams in the ops of l, doubling their size as
+ * often as needed. Returns 0 when out of memory.
+ */
+static GLint reserve_ops(GLList *l, GLint n)
+{
+    GLint size = l->max_size;
+    GLParam *ops;
+
+    if (l->size + n <= size)
+        return 1;
+    while (l->size + n > size)
+        size = size ? size * 2 : LIST_MIN_SIZE;
+    ops = gl_realloc(l->ops, size * sizeof(GLParam));
+    if (!ops)
+        return 0;
+    l->ops = ops;
+    l->max_size = size;
+    return 1;
+}
+
+/* Append the op p to l, preceded by its code. Returns where the op is. */
+static GLParam *append_op(GLList *l, const GLParam *p)
+{
+    GLParam *q = put_op(&l->ops[l->size], p);
+
+    l->size += GL_OP_CODE + op_table_size[p[0].op];
+    return q;
+}
+
+static GLList *alloc_list(GLuint list)
 {
     GLContext *c = gl_get_context();
+    GLParam p[1] = {{.op = OP_EndList}};
 #define RETVAL NULL
 #include "error_check.h"
     GLList *l = gl_zalloc(sizeof(GLList));
-    GLParamBuffer *ob = gl_zalloc(sizeof(GLParamBuffer));
 
+    if (l) {
+        l->name = list;
+        if (!reserve_ops(l, GL_OP_CODE + 1) ||
+            !insert_list(&c->shared_state, l)) {
+            gl_free_list(l);
+            l = NULL;
+        }
+    }
+    if (!l) {
 #if TGL_HAS(ERROR_CHECK)
-    if (!l || !ob)
 #define ERROR_FLAG GL_OUT_OF_MEMORY
 #define RETVAL NULL
 #include "error_check.h"
+#else
+        return NULL;
+#endif
+    }
+    append_op(l, p);
+#if TGL_HAS(BOUNDS_CULLING)
+    reset_bounds(l);
 #endif
-        ob->next = NULL;
-    l->first_op_buffer = ob;
-
-    ob->ops[0].op = OP_EndList;
-
-    c->shared_state.lists[list] = l;
     return l;
 }
 
@@ -91,52 +264,345 @@ void glCallLists(GLsizei n, GLenum type, const GLuint *lists)
             glCallList(c->listbase + lists[i]);
 }
 
+#if TGL_HAS(BOUNDS_CULLING)
+static void gl_bound_vertex(GLList *l, GLfloat x, GLfloat y, GLfloat z)
+{
+    GLfloat v[3] = {x, y, z};
+
+    for (GLint i = 0; i < 3; i++) {
+        if (v[i] < l->min.v[i])
+            l->min.v[i] = v[i];
+        if (v[i] > l->max.v[i])
+            l->max.v[i] = v[i];
+    }
+}
+
+/*
+ * Grow the box of the list with the op q just compiled, or give up on it for
+ * an op that changes more than the current attributes, or could draw outside
+ * of the glBegin and glEnd of the list. The vertices of an OP_VertexBatch
+ * are added by the optimizer packing them.
+ */
+static void gl_bound_op(GLList *l, GLParam *q)
+{
+    switch (q[0].op) {
+    case OP_Vertex:
+        if (!l->in_begin)
+            l->bounded = 0;
+        gl_bound_vertex(l, q[1].f, q[2].f, q[3].f);
+        break;
+    case OP_VertexBatch:
+        l->bounded &= !l->in_begin;
+        break;
+    case OP_Begin:
+        l->bounded &= !l->in_begin;
+        l->in_begin = 1;
+        break;
+    case OP_End:
+        l->bounded &= l->in_begin;
+        l->in_begin = 0;
+        break;
+    case OP_EndList:
+        l->bounded &= !l->in_begin;
+        break;
+    case OP_Color:
+        l->current[0] = q - l->ops;
+        break;
+    case OP_Normal:
+        l->current[1] = q - l->ops;
+        break;
+    case OP_TexCoord:
+        l->current[2] = q - l->ops;
+        break;
+    case OP_EdgeFlag:
+        l->current[3] = q - l->ops;
+        break;
+    default:
+        l->bounded = 0;
+        break;
+    }
+}
+#endif
+
 void gl_compile_op(GLParam *p)
 {
     GLContext *c = gl_get_context();
 #include "error_check.h"
-    GLint op = p[0].op;
-    GLint op_size = op_table_size[op];
-    GLint index = c->current_op_buffer_index;
-    GLParamBuffer *ob = c->current_op_buffer;
+    GLList *l = c->compile_list;
+    GLParam *q;
 
-    /* we should be able to add a NextBuffer opcode */
-    if ((index + op_size) > (OP_BUFFER_MAX_SIZE - 2)) {
-        GLParamBuffer *ob1 = gl_zalloc(sizeof(GLParamBuffer));
+    if (!reserve_ops(l, GL_OP_CODE + op_table_size[p[0].op])) {
+#if TGL_HAS(ERROR_CHECK)
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
+#else
+        gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+    }
+    q = append_op(l, p);
+#if TGL_HAS(BOUNDS_CULLING)
+    gl_bound_op(l, q);
+#else
+    (void) q;
+#endif
+}
 
+/*
+ * Shrink the ops of the list l to fit, once it is compiled, followed by the
+ * n positions at data the OP_VertexBatch ops of l are given offsets in.
+ */
+static void compact_list(GLList *l, const GLfloat *data, GLint n)
+{
+    GLParam *ops, *q;
+    GLfloat *d;
+
+    ops = gl_realloc(l->ops, l->size * sizeof(GLParam) + n * sizeof(GLfloat));
+    if (!ops) {
 #if TGL_HAS(ERROR_CHECK)
-        if (!ob1)
+        GLContext *c = gl_get_context();
 #define ERROR_FLAG GL_OUT_OF_MEMORY
 #include "error_check.h"
 #else
+        gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+    }
+    l->ops = ops;
+    l->max_size = l->size;
+    if (n == 0)
+        return;
+    d = (GLfloat *) &ops[l->size];
+    memcpy(d, data, n * sizeof(GLfloat));
+    for (q = ops + GL_OP_CODE; q[0].op != OP_EndList;
+         q += op_table_size[q[0].op] + GL_OP_CODE)
+        if (q[0].op == OP_VertexBatch)
+            q[3].p = d + q[3].i;
+}
+
+#if TGL_HAS(LIST_OPTIMIZER)
+typedef struct {
+    /* a run of matrix ops: their count, the first of them, and their product,
+       from the matrix loaded by the first one when load is set */
+    GLint matrix_ops, load;
+    GLParam *matrix_op;
+    M4 m;
+    /* a glBegin followed by nothing but the glVertex ops of vertex */
+    GLParam *begin;
+    GLParam **vertex;
+    GLint nv, max_v;
+    /* the positions of the vertices packed so far */
+    GLfloat *data;
+    GLint ndata, max_data;
+    /* the last glColor, glNormal and glTexCoord, NULL when unknown */
+    GLParam *current[3];
+} GLListOptimizer;
+
+static void flush_matrix(GLListOptimizer *o)
+{
+    GLParam q[17];
 
+    if (o->matrix_ops == 0)
+        return;
+    if (o->matrix_ops == 1) {
+        gl_compile_op(o->matrix_op);
+    } else {
+        q[0].op = o->load ? OP_LoadMatrix : OP_MultMatrix;
+        for (GLint i = 0; i < 4; i++)
+            for (GLint j = 0; j < 4; j++)
+                q[1 + i * 4 + j].f = o->m.m[j][i];
+        gl_compile_op(q);
+    }
+    o->matrix_ops = 0;
+}
+
+/* Make room for n more positions in the data of o. */
+static GLint reserve_data(GLListOptimizer *o, GLint n)
+{
+    GLint size = o->max_data;
+    GLfloat *data;
+
+    if (o->ndata + n <= size)
+        return 1;
+    while (o->ndata + n > size)
+        size = size ? size * 2 : LIST_MIN_SIZE;
+    data = gl_realloc(o->data, size * sizeof(GLfloat));
+    if (!data)
+        return 0;
+    o->data = data;
+    o->max_data = size;
+    return 1;
+}
+
+/*
+ * The glBegin pending, packed into a glopVertexBatch when end is its glEnd, or
+ * else compiled op by op. Like glopVertex, the batch assumes a w of 1. Its
+ * positions go to the data of o, where the batch points to until the list is
+ * compacted.
+ */
+static void flush_begin(GLList *l, GLListOptimizer *o, GLParam *end)
+{
+    GLint i;
+
+    if (end && reserve_data(o, o->nv * 3)) {
+        GLfloat *d = &o->data[o->ndata];
+        GLParam q[4];
+        for (i = 0; i < o->nv; i++) {
+            d[i * 3] = o->vertex[i][1].f;
+            d[i * 3 + 1] = o->vertex[i][2].f;
+            d[i * 3 + 2] = o->vertex[i][3].f;
+#if TGL_HAS(BOUNDS_CULLING)
+            gl_bound_vertex(l, d[i * 3], d[i * 3 + 1], d[i * 3 + 2]);
 #endif
-            ob1->next = NULL;
+        }
+        q[0].op = OP_VertexBatch;
+        q[1].i = o->begin[1].i;
+        q[2].i = o->nv;
+        q[3].i = o->ndata;
+        o->ndata += o->nv * 3;
+        gl_compile_op(q);
+        o->begin = NULL;
+        return;
+    }
+    gl_compile_op(o->begin);
+    for (i = 0; i < o->nv; i++)
+        gl_compile_op(o->vertex[i]);
+    if (end)
+        gl_compile_op(end);
+    o->begin = NULL;
+}
+
+/* whether q has the parameters of p, which are 32 bits wide */
+static GLint same_op(const GLParam *q, const GLParam *p)
+{
+    if (!q)
+        return 0;
+    for (GLint i = 1; i < op_table_size[p[0].op]; i++)
+        if (q[i].i != p[i].i)
+            return 0;
+    return 1;
+}
+
+static void optimize_op(GLList *l, GLListOptimizer *o, GLParam *p)
+{
+    GLint op = p[0].op;
+    GLint k = op == OP_Color      ? 0
+              : op == OP_Normal   ? 1
+              : op == OP_TexCoord ? 2
+                                  : -1;
+    M4 m;
 
-        ob->next = ob1;
-        ob->ops[index].op = OP_NextBuffer;
-        ob->ops[index + 1].p = (void *) ob1;
+    if (k >= 0 && same_op(o->current[k], p))
+        return;
+    if (o->begin) {
+        if (op == OP_Vertex) {
+            if (o->nv == o->max_v) {
+                GLint n = o->max_v ? o->max_v * 2 : 64;
+                GLParam **v = gl_realloc(o->vertex, n * sizeof(GLParam *));
+                if (!v) {
+                    flush_begin(l, o, NULL);
+                    gl_compile_op(p);
+                    return;
+                }
+                o->vertex = v;
+                o->max_v = n;
+            }
+            o->vertex[o->nv++] = p;
+            return;
+        }
+        flush_begin(l, o, op == OP_End ? p : NULL);
+        if (op == OP_End)
+            return;
+    }
 
-        c->current_op_buffer = ob1;
-        ob = ob1;
-        index = 0;
+    switch (op) {
+    case OP_MultMatrix:
+    case OP_Rotate:
+    case OP_Scale:
+    case OP_Translate:
+        if (o->matrix_ops == 0) {
+            o->matrix_op = p;
+            o->load = 0;
+            gl_M4_Id(&o->m);
+        }
+        gl_op_matrix(&m, p);
+        gl_M4_MulLeft(&o->m, &m);
+        o->matrix_ops++;
+        return;
+    case OP_LoadIdentity:
+    case OP_LoadMatrix:
+        flush_matrix(o);
+        o->matrix_op = p;
+        o->matrix_ops = 1;
+        o->load = 1;
+        gl_op_matrix(&o->m, p);
+        return;
+    default:
+        break;
     }
+    flush_matrix(o);
 
-    for (GLint i = 0; i < op_size; i++) {
-        ob->ops[index] = p[i];
-        index++;
+    switch (op) {
+    case OP_Begin:
+        o->begin = p;
+        o->nv = 0;
+        return;
+    case OP_Color:
+    case OP_Normal:
+    case OP_TexCoord:
+        o->current[k] = p;
+        break;
+    case OP_Vertex:
+    case OP_End:
+    case OP_EdgeFlag:
+    case OP_MatrixMode:
+    case OP_PushMatrix:
+    case OP_PopMatrix:
+        break;
+    default:
+        /* a nested list, an array element, or a new material */
+        o->current[0] = o->current[1] = o->current[2] = NULL;
+        break;
     }
-    c->current_op_buffer_index = index;
+    gl_compile_op(p);
 }
 
-/* this opcode is never called directly */
-void glopEndList(GLParam *p)
+/*
+ * Compile the ops of the list l again, through optimize_op(), into a new
+ * block. The ops are read from the old block until all of them are compiled,
+ * since the optimizer keeps pointers to those still pending.
+ */
+static void optimize_list(GLList *l)
 {
-    exit(1);
+    GLListOptimizer o = {0};
+    GLParam *old = l->ops;
+    GLParam *p = old + GL_OP_CODE;
+
+    l->ops = gl_malloc(l->size * sizeof(GLParam));
+    if (!l->ops) {
+        l->ops = old;
+        compact_list(l, NULL, 0);
+        return;
+    }
+    l->max_size = l->size;
+    l->size = 0;
+#if TGL_HAS(BOUNDS_CULLING)
+    reset_bounds(l);
+#endif
+
+    while (p[0].op != OP_EndList) {
+        optimize_op(l, &o, p);
+        p += op_table_size[p[0].op] + GL_OP_CODE;
+    }
+    optimize_op(l, &o, p);
+
+    gl_free(o.vertex);
+    gl_free(old);
+    compact_list(l, o.data, o.ndata);
+    gl_free(o.data);
 }
+#endif
 
 /* this opcode is never called directly */
-void glopNextBuffer(GLParam *p)
+void glopEndList(GLParam *p)
 {
     exit(1);
 }
@@ -145,27 +611,42 @@ void glopCallList(GLParam *p)
 {
 #include "error_check_no_context.h"
     GLint list = p[1].ui;
-    GLList *l = find_list(list);
+    GLList *l = gl_find_list(list);
 
 #if TGL_HAS(ERROR_CHECK)
     if (!l)
         gl_fatal_error("Bad list op, not defined");
 #endif
-    p = l->first_op_buffer->ops;
-
+#if TGL_HAS(BOUNDS_CULLING)
+    {
+        GLContext *c = gl_get_context();
+        /* a list without vertices has its min above its max */
+        if (l->bounded && !c->in_begin &&
+            (l->min.X > l->max.X || gl_box_outside(c, &l->min, &l->max))) {
+            GLint i;
+            for (i = 0; i < 4; i++)
+                if (l->current[i] >= 0) {
+                    GLParam *q = &l->ops[l->current[i]];
+                    op_table_func[q[0].op](q);
+                }
+            return;
+        }
+    }
+#endif
+    p = l->ops;
+#if GL_OP_CODE
+    run_list(p);
+#else
     while (1) {
         GLint op;
 #include "error_check.h"
         op = p[0].op;
         if (op == OP_EndList)
             break;
-        if (op == OP_NextBuffer) {
-            p = (GLParam *) p[1].p;
-        } else {
-            op_table_func[op](p);
-            p += op_table_size[op];
-        }
+        op_table_func[op](p);
+        p += op_table_size[op];
     }
+#endif
 }
 
 void glNewList(GLuint list, GLint mode)
@@ -183,7 +664,7 @@ void glNewList(GLuint list, GLint mode)
 #define ERROR_FLAG GL_INVALID_OPERATION
 #include "error_check.h"
 #endif
-            l = find_list(list);
+            l = gl_find_list(list);
     if (l)
         delete_list(list);
     l = alloc_list(list);
@@ -197,11 +678,13 @@ void glNewList(GLuint list, GLint mode)
     if (!l)
         gl_fatal_error("Could not find or allocate list.");
 #endif
-        c->current_op_buffer = l->first_op_buffer;
-    c->current_op_buffer_index = 0;
+        /* over the OP_EndList of the empty list */
+        l->size = 0;
+    c->compile_list = l;
 
     c->compile_flag = 1;
     c->exec_flag = (mode == GL_COMPILE_AND_EXECUTE);
+    gl_set_dispatch(c);
 }
 
 void glEndList(void)
@@ -220,14 +703,20 @@ void glEndList(void)
         /* end of list */
         p[0].op = OP_EndList;
     gl_compile_op(p);
+#if TGL_HAS(LIST_OPTIMIZER)
+    optimize_list(c->compile_list);
+#else
+    compact_list(c->compile_list, NULL, 0);
+#endif
 
     c->compile_flag = 0;
     c->exec_flag = 1;
+    gl_set_dispatch(c);
 }
 
 GLint glIsList(GLuint list)
 {
-    GLList *l = find_list(list);
+    GLList *l = gl_find_list(list);
     return (l != NULL);
 }
 
@@ -236,21 +725,23 @@ GLuint glGenLists(GLint range)
     GLContext *c = gl_get_context();
 #define RETVAL 0
 #include "error_check.h"
-    GLList **lists = c->shared_state.lists;
-    GLint count = 0;
-    for (GLint i = 0; i < MAX_DISPLAY_LISTS; i++) {
-        if (!lists[i]) {
-            count++;
-            if (count == range) {
-                GLint list = i - range + 1;
-                for (i = 0; i < range; i++) {
-                    alloc_list(list + i);
-                }
-                return list;
-            }
-        } else {
-            count = 0;
+    GLSharedState *s = &c->shared_state;
+    GLuint list = s->list_next;
+    GLint i;
+
+    if (range <= 0)
+        return 0;
+    /* skip the names glNewList took past list_next */
+    for (i = 0; i < range; i++) {
+        if (list > 0xffffffffu - (GLuint) range)
+            return 0;
+        if (gl_find_list(list + i)) {
+            list += i + 1;
+            i = -1;
         }
     }
-    return 0;
+    for (i = 0; i < range; i++)
+        alloc_list(list + i);
+    s->list_next = list + range;
+    return list;
 }
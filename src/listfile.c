@@ -0,0 +1,502 @@
+/*
+ * Files of display lists.
+ *
+ * glSaveListsTGL() writes compiled lists as they are in memory: a header, then
+ * for each list a record, its ops and the data they point to. The code slots
+ * of the ops are zeroed, and each pointer an op owns (the positions of an
+ * OP_VertexBatch, the pixels of a glTexImage or glDrawPixels) becomes the
+ * offset of a copy of what it points to in the data of the list, or -1 for
+ * NULL.
+ *
+ * glLoadListsTGL() maps the file copy on write and checks its structure, then
+ * turns the offsets back into pointers and, with GL_OP_CODE, sets the code
+ * slots, in place. The lists run from the mapping, which is unmapped with the
+ * last of them. Those writes give most pages of ops a private copy at load
+ * time: only the pixels and positions after the ops, and the pages of ops
+ * without a code slot or pointer, stay shared with the file. The file is read
+ * into memory where there is no mmap(). The ops are native GLParams, so a file
+ * only loads in a build with the same ops, GLParam, byte order and
+ * GL_OP_CODE; the signature of the header tells.
+ *
+ * The check is of the structure of the file only: the ops, their sizes, and
+ * the offsets of their pointers. The arguments of the ops are not checked,
+ * like those of calls recorded into a list in a build without ERROR_CHECK: a
+ * light index out of range, an enum, or a glCallList of the list itself run
+ * as they are. Only load files that can be trusted, such as those the
+ * application saved itself.
+ */
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "zgl.h"
+
+#if TGL_HAS(LIST_FILES)
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TGL_LIST_FILE_MMAP 1
+#else
+#define TGL_LIST_FILE_MMAP 0
+#endif
+
+#define TGL_LIST_FILE_VERSION 1
+
+typedef struct {
+    char magic[4];
+    GLuint version, param_size, byte_order, signature, lists;
+} GLListFileHeader;
+
+typedef struct {
+    GLuint name;
+    GLint size;   /* the GLParams of the ops */
+    GLuint bytes; /* the data following them, a multiple of a GLParam */
+    /* the bounds of the list, bounded being 0 without them */
+    GLint bounded;
+    GLfloat min[3], max[3];
+    GLint current[4];
+} GLListRecord;
+
+/* the ops and data after them stay aligned as GLParams */
+extern char TGL_BUILDT_GLListFileHeader
+    [1 - 2 * (sizeof(GLListFileHeader) % sizeof(GLParam) != 0)];
+extern char TGL_BUILDT_GLListRecord
+    [1 - 2 * (sizeof(GLListRecord) % sizeof(GLParam) != 0)];
+
+static const char *const op_names[] = {
+#define ADD_OP(a, b, c) #a,
+#include "opinfo.h"
+};
+
+#define LIST_FILE_OPS ((GLint) (sizeof(op_names) / sizeof(op_names[0])))
+
+static GLuint fnv1a(GLuint h, GLuint x)
+{
+    return (h ^ x) * 16777619u;
+}
+
+/* a hash of the ops, their sizes and what else the layout of a list
+   depends on */
+static GLuint list_file_signature(void)
+{
+    GLuint h = 2166136261u;
+
+    for (GLint i = 0; i < LIST_FILE_OPS; i++) {
+        for (const char *s = op_names[i]; *s; s++)
+            h = fnv1a(h, (GLubyte) *s);
+        h = fnv1a(h, op_table_size[i]);
+    }
+    h = fnv1a(h, GL_OP_CODE);
+    return fnv1a(h, sizeof(PIXEL));
+}
+
+static void list_file_header(GLListFileHeader *h, GLuint lists)
+{
+    memcpy(h->magic, "TGLL", 4);
+    h->version = TGL_LIST_FILE_VERSION;
+    h->param_size = sizeof(GLParam);
+    h->byte_order = 0x01020304;
+    h->signature = list_file_signature();
+    h->lists = lists;
+}
+
+/*
+ * The index of the pointer the op p owns, setting the bytes it points to, or
+ * 0 for an op without one. -1 for the pointers to client arrays, whose size
+ * is not known.
+ */
+static GLint op_pointer(const GLParam *p, size_t *bytes)
+{
+    GLint w, h;
+
+    switch (p[0].op) {
+    case OP_VertexBatch:
+        w = p[2].i;
+        h = 3 * sizeof(GLfloat);
+        break;
+    case OP_TexImage2D:
+        w = p[4].i;
+        h = p[5].i * (p[7].i == GL_RGBA ? 4 : 3);
+        break;
+    case OP_TexImage1D:
+        w = p[4].i;
+        h = p[6].i == GL_RGBA ? 4 : 3;
+        break;
+    case OP_DrawPixels:
+        w = p[1].i;
+        h = p[2].i * sizeof(PIXEL);
+        break;
+    case OP_VertexPointer:
+    case OP_ColorPointer:
+    case OP_NormalPointer:
+    case OP_TexCoordPointer:
+        return -1;
+    default:
+        return 0;
+    }
+    *bytes = w > 0 && h > 0 ? (size_t) w * (size_t) h : 0;
+    switch (p[0].op) {
+    case OP_TexImage2D:
+        return 9;
+    case OP_TexImage1D:
+        return 8;
+    default:
+        return 3;
+    }
+}
+
+static size_t round_up(size_t n)
+{
+    return (n + sizeof(GLParam) - 1) / sizeof(GLParam) * sizeof(GLParam);
+}
+
+/* the data the ops of l point to; -1 when one points to a client array, or
+   it would not fit the offsets */
+static int64_t list_bytes(const GLList *l)
+{
+    int64_t bytes = 0;
+    const GLParam *q;
+
+    for (q = l->ops + GL_OP_CODE;; q += op_table_size[q[0].op] + GL_OP_CODE) {
+        size_t n;
+        GLint k = op_pointer(q, &n);
+        if (k < 0)
+            return -1;
+        if (k > 0 && q[k].p)
+            bytes += round_up(n);
+        if (q[0].op == OP_EndList)
+            return bytes <= INT32_MAX ? bytes : -1;
+    }
+}
+
+/* Write the list l, whose data is bytes long. Returns 0 on failure. */
+static GLint write_list(FILE *f, const GLList *l, size_t bytes)
+{
+    size_t ops = l->size * sizeof(GLParam);
+    GLParam *block = gl_zalloc(ops + bytes);
+    GLubyte *data = (GLubyte *) block + ops;
+    GLListRecord r = {0};
+    GLParam *q;
+    GLint ok;
+
+    if (!block)
+        return 0;
+    r.name = l->name;
+    r.size = l->size;
+    r.bytes = bytes;
+    memcpy(block, l->ops, ops);
+    bytes = 0;
+    for (q = block + GL_OP_CODE;; q += op_table_size[q[0].op] + GL_OP_CODE) {
+        size_t n;
+        GLint k = op_pointer(q, &n);
+#if GL_OP_CODE
+        memset(q - 1, 0, sizeof(GLParam));
+#endif
+        if (k > 0) {
+            void *src = q[k].p;
+            memset(&q[k], 0, sizeof(GLParam));
+            q[k].i = -1;
+            if (src) {
+                memcpy(data + bytes, src, n);
+                q[k].i = (GLint) bytes;
+                bytes += round_up(n);
+            }
+        }
+        if (q[0].op == OP_EndList)
+            break;
+    }
+#if TGL_HAS(BOUNDS_CULLING)
+    r.bounded = l->bounded;
+    memcpy(r.min, l->min.v, sizeof(r.min));
+    memcpy(r.max, l->max.v, sizeof(r.max));
+    memcpy(r.current, l->current, sizeof(r.current));
+#else
+    r.current[0] = r.current[1] = r.current[2] = r.current[3] = -1;
+#endif
+    ok = fwrite(&r, sizeof(r), 1, f) == 1 &&
+         fwrite(block, ops + bytes, 1, f) == 1;
+    gl_free(block);
+    return ok;
+}
+
+GLint glSaveListsTGL(const char *path, GLuint list, GLsizei range)
+{
+    GLContext *c = gl_get_context();
+#define RETVAL -1
+#include "error_check.h"
+    GLListFileHeader h;
+    GLuint lists = 0;
+    GLsizei i;
+    GLint ok;
+    FILE *f;
+
+    if (c->compile_flag || range < 0)
+#if TGL_HAS(ERROR_CHECK)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#define RETVAL -1
+#include "error_check.h"
+#else
+        return -1;
+#endif
+    for (i = 0; i < range; i++) {
+        GLList *l = gl_find_list(list + i);
+        if (!l)
+            continue;
+        if (list_bytes(l) < 0)
+#if TGL_HAS(ERROR_CHECK)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#define RETVAL -1
+#include "error_check.h"
+#else
+            return -1;
+#endif
+        lists++;
+    }
+
+    f = fopen(path, "wb");
+    if (!f)
+        return -1;
+    list_file_header(&h, lists);
+    ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    for (i = 0; ok && i < range; i++) {
+        GLList *l = gl_find_list(list + i);
+        if (l)
+            ok = write_list(f, l, list_bytes(l));
+    }
+    if (fclose(f) != 0 || !ok) {
+        remove(path);
+        return -1;
+    }
+    return lists;
+}
+
+void gl_release_list_file(GLListFile *f)
+{
+    if (--f->refs > 0)
+        return;
+#if TGL_LIST_FILE_MMAP
+    if (f->mapped)
+        munmap(f->addr, f->size);
+    else
+#endif
+        gl_free(f->addr);
+    gl_free(f);
+}
+
+/* Map the file path, or read it. */
+static GLListFile *open_list_file(const char *path)
+{
+    GLListFile *f = gl_zalloc(sizeof(GLListFile));
+    FILE *fp;
+    long size;
+
+    if (!f)
+        return NULL;
+    f->refs = 1;
+#if TGL_LIST_FILE_MMAP
+    {
+        struct stat st;
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            gl_free(f);
+            return NULL;
+        }
+        if (fstat(fd, &st) == 0 &&
+            st.st_size >= (off_t) sizeof(GLListFileHeader)) {
+            void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                f->addr = addr;
+                f->size = st.st_size;
+                f->mapped = 1;
+            }
+        }
+        close(fd);
+        if (f->mapped)
+            return f;
+    }
+#endif
+    fp = fopen(path, "rb");
+    if (fp && fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0 &&
+        fseek(fp, 0, SEEK_SET) == 0 && (f->addr = gl_malloc(size)) &&
+        fread(f->addr, size, 1, fp) == 1) {
+        f->size = size;
+        fclose(fp);
+        return f;
+    }
+    if (fp)
+        fclose(fp);
+    gl_release_list_file(f);
+    return NULL;
+}
+
+/*
+ * Whether the ops of the record r, at ops in a file, end with OP_EndList at
+ * their last GLParam, with their pointers and current attributes in range.
+ * Their other parameters are not looked at.
+ */
+static GLint check_list(const GLListRecord *r, const GLParam *ops)
+{
+    GLint found[4] = {0};
+    GLint i = GL_OP_CODE, j;
+
+    while (i < r->size) {
+        GLint op = ops[i].op;
+        size_t n;
+        GLint k;
+        if (op < 0 || op >= LIST_FILE_OPS || i + op_table_size[op] > r->size)
+            return 0;
+        k = op_pointer(&ops[i], &n);
+        if (k < 0)
+            return 0;
+        if (k > 0) {
+            GLint off = ops[i + k].i;
+            GLuint u = off;
+            if (off < -1 || (off >= 0 && (u % sizeof(GLParam) != 0 ||
+                                          u > r->bytes || n > r->bytes - u)))
+                return 0;
+        }
+        for (j = 0; j < 4; j++)
+            found[j] |= r->current[j] == i;
+        if (op == OP_EndList)
+            break;
+        i += op_table_size[op] + GL_OP_CODE;
+    }
+    if (i + 1 != r->size)
+        return 0;
+    for (j = 0; j < 4; j++)
+        if (r->current[j] != -1 && !found[j])
+            return 0;
+    return 1;
+}
+
+/* Whether f is a file of lists of this build, with a sound structure. */
+static GLint check_list_file(const GLListFile *f)
+{
+    const GLListFileHeader *h = f->addr;
+    GLListFileHeader want;
+    size_t pos = sizeof(*h);
+
+    list_file_header(&want, h->lists);
+    if (memcmp(h, &want, sizeof(want)) != 0)
+        return 0;
+    for (GLuint i = 0; i < h->lists; i++) {
+        const GLListRecord *r = (const GLListRecord *) ((char *) f->addr + pos);
+        size_t left;
+        if (f->size - pos < sizeof(*r))
+            return 0;
+        pos += sizeof(*r);
+        left = f->size - pos;
+        if (r->size <= 0 || r->bytes % sizeof(GLParam) != 0 ||
+            (size_t) r->size > left / sizeof(GLParam) ||
+            r->bytes > left - r->size * sizeof(GLParam))
+            return 0;
+        if (!check_list(r, (const GLParam *) (r + 1)))
+            return 0;
+        pos += r->size * sizeof(GLParam) + r->bytes;
+    }
+    return 1;
+}
+
+/* Make a list of the record r, whose ops are relocated in place. */
+static GLList *load_list(GLListFile *f, GLListRecord *r)
+{
+    GLList *l = gl_zalloc(sizeof(GLList));
+    GLParam *ops = (GLParam *) (r + 1);
+    GLubyte *data = (GLubyte *) (ops + r->size);
+    GLParam *q;
+
+    if (!l)
+        return NULL;
+    for (q = ops + GL_OP_CODE;; q += op_table_size[q[0].op] + GL_OP_CODE) {
+        size_t n;
+        GLint k = op_pointer(q, &n);
+        gl_put_op_code(q - GL_OP_CODE);
+        if (k > 0) {
+            GLint off = q[k].i;
+            q[k].p = off < 0 ? NULL : data + off;
+        }
+        if (q[0].op == OP_EndList)
+            break;
+    }
+    l->ops = ops;
+    l->size = l->max_size = r->size;
+    l->name = r->name;
+    l->file = f;
+    f->refs++;
+#if TGL_HAS(BOUNDS_CULLING)
+    l->bounded = r->bounded;
+    memcpy(l->min.v, r->min, sizeof(r->min));
+    memcpy(l->max.v, r->max, sizeof(r->max));
+    memcpy(l->current, r->current, sizeof(r->current));
+#endif
+    return l;
+}
+
+GLint glLoadListsTGL(const char *path)
+{
+    GLContext *c = gl_get_context();
+#define RETVAL -1
+#include "error_check.h"
+    GLListFile *f;
+    GLListFileHeader *h;
+    size_t pos;
+    GLint n = 0;
+
+    if (c->compile_flag)
+#if TGL_HAS(ERROR_CHECK)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#define RETVAL -1
+#include "error_check.h"
+#else
+        return -1;
+#endif
+    f = open_list_file(path);
+    if (!f)
+        return -1;
+    if (f->size < sizeof(GLListFileHeader) || !check_list_file(f)) {
+        gl_release_list_file(f);
+        return -1;
+    }
+    h = f->addr;
+    pos = sizeof(*h);
+    for (GLuint i = 0; i < h->lists; i++) {
+        GLListRecord *r = (GLListRecord *) ((char *) f->addr + pos);
+        GLList *l = load_list(f, r);
+        if (!l || !gl_insert_list(l)) {
+            if (l)
+                gl_free_list(l);
+#if TGL_HAS(ERROR_CHECK)
+            c->error_flag = GL_OUT_OF_MEMORY;
+#endif
+            break;
+        }
+        pos += sizeof(*r) + r->size * sizeof(GLParam) + r->bytes;
+        n++;
+    }
+    /* the lists hold the file from now on */
+    gl_release_list_file(f);
+    return n;
+}
+
+#else
+
+GLint glSaveListsTGL(const char *path, GLuint list, GLsizei range)
+{
+    return -1;
+}
+
+GLint glLoadListsTGL(const char *path)
+{
+    return -1;
+}
+
+#endif
@@ -8,10 +8,75 @@ void gl_print_matrix(const GLfloat *m)
     }
 }
 
+/*
+ * The matrices derived from the modelview and projection matrices are only
+ * computed when a primitive needs them: the inverse of the modelview matrix
+ * for the normals only with lighting, and not after a projection change.
+ */
 static void gl_matrix_update()
 {
     GLContext *c = gl_get_context();
-    c->matrix_model_projection_updated = (c->matrix_mode <= 1);
+#if TGL_HAS(LOCKED_ARRAYS)
+    c->matrix_gen++;
+#endif
+    switch (c->matrix_mode) {
+    case 0:
+        c->matrix_model_view_inv_updated = 1;
+        c->matrix_model_projection_updated = 1;
+        break;
+    case 1:
+        c->matrix_model_projection_updated = 1;
+        break;
+    default:
+        /* test if the texture matrix is not Identity */
+        c->apply_texture_matrix = !gl_M4_IsId(c->matrix_stack_ptr[2]);
+        break;
+    }
+}
+
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+static void gl_matrix_to_fixed(GLfixed *x, const M4 *m, GLint n)
+{
+    const GLfloat *f = &m->m[0][0];
+
+    for (GLint i = 0; i < n; i++)
+        x[i] = gl_fixed(f[i]);
+}
+#endif
+
+void gl_eval_model_projection(GLContext *c)
+{
+    GLfloat *m = &c->matrix_model_projection.m[0][0];
+
+    if (!c->matrix_model_projection_updated)
+        return;
+    /* precompute projection matrix */
+    gl_M4_Mul(&c->matrix_model_projection, c->matrix_stack_ptr[1],
+              c->matrix_stack_ptr[0]);
+    /* test to accelerate computation */
+    c->matrix_model_projection_no_w_transform =
+        m[12] == 0.0 && m[13] == 0.0 && m[14] == 0.0;
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    gl_matrix_to_fixed(c->fx.model_projection, &c->matrix_model_projection, 16);
+#endif
+    c->matrix_model_projection_updated = 0;
+}
+
+void gl_eval_model_view_inv(GLContext *c)
+{
+    M4 tmp;
+
+    if (!c->matrix_model_view_inv_updated)
+        return;
+    /* precompute inverse modelview */
+    gl_M4_Inv(&tmp, c->matrix_stack_ptr[0]);
+    gl_M4_Transpose(&c->matrix_model_view_inv, &tmp);
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    /* the first 3 rows: the eye coordinates, and the normals */
+    gl_matrix_to_fixed(c->fx.model_view, c->matrix_stack_ptr[0], 12);
+    gl_matrix_to_fixed(c->fx.model_view_inv, &c->matrix_model_view_inv, 12);
+#endif
+    c->matrix_model_view_inv_updated = 0;
 }
 
 void glopMatrixMode(GLParam *p)
@@ -111,10 +176,9 @@ void glopPopMatrix(GLParam *p)
     gl_matrix_update();
 }
 
-void glopRotate(GLParam *p)
+/* The matrix of glRotate, or 0 when its axis is null. */
+static GLint gl_rotation(M4 *m, const GLParam *p)
 {
-    GLContext *c = gl_get_context();
-    M4 m;
     GLfloat u[3];
     GLfloat angle;
     GLint dir_code;
@@ -129,22 +193,22 @@ void glopRotate(GLParam *p)
 
     switch (dir_code) {
     case 0:
-        gl_M4_Id(&m);
+        gl_M4_Id(m);
         break;
     case 4:
         if (u[0] < 0)
             angle = -angle;
-        gl_M4_Rotate(&m, angle, 0);
+        gl_M4_Rotate(m, angle, 0);
         break;
     case 2:
         if (u[1] < 0)
             angle = -angle;
-        gl_M4_Rotate(&m, angle, 1);
+        gl_M4_Rotate(m, angle, 1);
         break;
     case 1:
         if (u[2] < 0)
             angle = -angle;
-        gl_M4_Rotate(&m, angle, 2);
+        gl_M4_Rotate(m, angle, 2);
         break;
     default: {
         GLfloat cost, sint;
@@ -153,12 +217,12 @@ void glopRotate(GLParam *p)
 #if TGL_HAS(FISR)
         GLfloat len = u[0] + u[1] + u[2];
         if (len == 0.0f)
-            return;
+            return 0;
         len = fastInvSqrt(len); /* FISR */
 #else
         GLfloat len = u[0] * u[0] + u[1] * u[1] + u[2] * u[2];
         if (len == 0.0f)
-            return;
+            return 0;
         len = 1.0f / sqrt(len);
 #endif
         u[0] *= len;
@@ -169,23 +233,32 @@ void glopRotate(GLParam *p)
         sint = sin(angle);
 
         /* fill in the values */
-        m.m[3][0] = m.m[3][1] = m.m[3][2] = m.m[0][3] = m.m[1][3] = m.m[2][3] =
+        m->m[3][0] = m->m[3][1] = m->m[3][2] = m->m[0][3] = m->m[1][3] = m->m[2][3] =
             0.0f;
-        m.m[3][3] = 1.0f;
+        m->m[3][3] = 1.0f;
 
         /* do the math */
-        m.m[0][0] = u[0] * u[0] + cost * (1 - u[0] * u[0]);
-        m.m[1][0] = u[0] * u[1] * (1 - cost) - u[2] * sint;
-        m.m[2][0] = u[2] * u[0] * (1 - cost) + u[1] * sint;
-        m.m[0][1] = u[0] * u[1] * (1 - cost) + u[2] * sint;
-        m.m[1][1] = u[1] * u[1] + cost * (1 - u[1] * u[1]);
-        m.m[2][1] = u[1] * u[2] * (1 - cost) - u[0] * sint;
-        m.m[0][2] = u[2] * u[0] * (1 - cost) - u[1] * sint;
-        m.m[1][2] = u[1] * u[2] * (1 - cost) + u[0] * sint;
-        m.m[2][2] = u[2] * u[2] + cost * (1 - u[2] * u[2]);
+        m->m[0][0] = u[0] * u[0] + cost * (1 - u[0] * u[0]);
+        m->m[1][0] = u[0] * u[1] * (1 - cost) - u[2] * sint;
+        m->m[2][0] = u[2] * u[0] * (1 - cost) + u[1] * sint;
+        m->m[0][1] = u[0] * u[1] * (1 - cost) + u[2] * sint;
+        m->m[1][1] = u[1] * u[1] + cost * (1 - u[1] * u[1]);
+        m->m[2][1] = u[1] * u[2] * (1 - cost) - u[0] * sint;
+        m->m[0][2] = u[2] * u[0] * (1 - cost) - u[1] * sint;
+        m->m[1][2] = u[1] * u[2] * (1 - cost) + u[0] * sint;
+        m->m[2][2] = u[2] * u[2] + cost * (1 - u[2] * u[2]);
     }
     }
+    return 1;
+}
+
+void glopRotate(GLParam *p)
+{
+    GLContext *c = gl_get_context();
+    M4 m;
 
+    if (!gl_rotation(&m, p))
+        return;
     gl_M4_MulLeft(c->matrix_stack_ptr[c->matrix_mode], &m);
 
     gl_matrix_update();
@@ -226,6 +299,45 @@ void glopTranslate(GLParam *p)
     gl_matrix_update();
 }
 
+/*
+ * The matrix the op p (glLoadIdentity, glLoadMatrix, glMultMatrix, glRotate,
+ * glScale or glTranslate) loads, or multiplies the current matrix with.
+ */
+void gl_op_matrix(M4 *m, const GLParam *p)
+{
+    const GLParam *q = p + 1;
+
+    gl_M4_Id(m);
+    switch (p[0].op) {
+    case OP_LoadMatrix:
+    case OP_MultMatrix:
+        for (GLint i = 0; i < 4; i++) {
+            m->m[0][i] = q[0].f;
+            m->m[1][i] = q[1].f;
+            m->m[2][i] = q[2].f;
+            m->m[3][i] = q[3].f;
+            q += 4;
+        }
+        break;
+    case OP_Rotate:
+        if (!gl_rotation(m, p))
+            gl_M4_Id(m);
+        break;
+    case OP_Scale:
+        m->m[0][0] = q[0].f;
+        m->m[1][1] = q[1].f;
+        m->m[2][2] = q[2].f;
+        break;
+    case OP_Translate:
+        m->m[0][3] = q[0].f;
+        m->m[1][3] = q[1].f;
+        m->m[2][3] = q[2].f;
+        break;
+    default:
+        break;
+    }
+}
+
 void glopFrustum(GLParam *p)
 {
     GLContext *c = gl_get_context();
@@ -19,3 +19,8 @@ void *gl_zalloc(GLint size)
 {
     return calloc(1, size);
 }
+
+void *gl_realloc(void *p, GLint size)
+{
+    return realloc(p, size);
+}
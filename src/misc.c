@@ -13,6 +13,7 @@ void glPolygonStipple(void *a)
 #include "error_check.h"
     ZBuffer *zb = c->zb;
 
+    ZB_flushTriangles(zb);
     memcpy(zb->stipplepattern, a, TGL_POLYGON_STIPPLE_BYTES);
     for (GLint i = 0; i < TGL_POLYGON_STIPPLE_BYTES; i++) {
         zb->stipplepattern[i] = ((GLubyte *) a)[i];
@@ -113,6 +114,10 @@ void glopEnableDisable(GLParam *p)
         break;
     case GL_COLOR_MATERIAL:
         c->color_material_enabled = v;
+#if TGL_HAS(LAZY_LIGHTING)
+        /* the material is left as it is, until the next glColor */
+        c->color_material = c->current_color;
+#endif
         break;
     case GL_TEXTURE_2D:
         c->texture_2d_enabled = v;
@@ -134,7 +139,16 @@ void glopEnableDisable(GLParam *p)
         break;
     case GL_POLYGON_STIPPLE:
 #if TGL_HAS(POLYGON_STIPPLE)
+        ZB_flushTriangles(c->zb);
         c->zb->dostipple = v;
+#endif
+        break;
+    case GL_DEPTH_PREPASS_TGL:
+#if TGL_HAS(DEPTH_PREPASS)
+        /* the batched triangles skip the check for deferred ones */
+        if (!v)
+            ZB_flushPrepass(c->zb);
+        c->zb->depth_prepass = v;
 #endif
         break;
     case GL_POLYGON_OFFSET_POINT:
@@ -286,6 +300,8 @@ void glReadPixels(GLint x,
 
 void glFinish()
 {
+    GLContext *c = gl_get_context();
+    ZB_flushTriangles(c->zb);
     return;
 }
 
@@ -304,6 +320,12 @@ void gl_eval_viewport()
     v->scale.X = (v->xsize - 0.5) / 2.0;
     v->scale.Y = -(v->ysize - 0.5) / 2.0;
     v->scale.Z = -((zsize - 0.5) / 2.0);
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    for (GLint i = 0; i < 3; i++) {
+        v->scale_fx[i] = (int64_t) ((double) v->scale.v[i] * GL_FIXED_ONE);
+        v->trans_fx[i] = (int64_t) ((double) v->trans.v[i] * GL_FIXED_ONE);
+    }
+#endif
 }
 
 GLint gl_clipcode(GLfloat x, GLfloat y, GLfloat z, GLfloat w1)
@@ -315,6 +337,32 @@ GLint gl_clipcode(GLfloat x, GLfloat y, GLfloat z, GLfloat w1)
            ((z < -w) << 4) | ((z > w) << 5);
 }
 
+#if TGL_HAS(BOUNDS_CULLING)
+/*
+ * Whether the box of object coordinates min to max is outside of the view
+ * volume: all of its corners are outside of one of its planes, and so are all
+ * of the primitives it contains, that would be rejected one by one.
+ */
+GLint gl_box_outside(GLContext *c, const V3 *min, const V3 *max)
+{
+    GLfloat *m;
+    GLint i, co = -1;
+
+    gl_eval_model_projection(c);
+    m = &c->matrix_model_projection.m[0][0];
+    for (i = 0; i < 8 && co != 0; i++) {
+        GLfloat x = (i & 1) ? max->X : min->X;
+        GLfloat y = (i & 2) ? max->Y : min->Y;
+        GLfloat z = (i & 4) ? max->Z : min->Z;
+        co &= gl_clipcode(x * m[0] + y * m[1] + z * m[2] + m[3],
+                          x * m[4] + y * m[5] + z * m[6] + m[7],
+                          x * m[8] + y * m[9] + z * m[10] + m[11],
+                          x * m[12] + y * m[13] + z * m[14] + m[15]);
+    }
+    return co != 0;
+}
+#endif
+
 GLfloat clampf(GLfloat a, GLfloat min, GLfloat max)
 {
     if (a < min)
@@ -50,7 +50,8 @@ ADD_OP(CallList, 1, "%d")
 
 /* special opcodes */
 ADD_OP(EndList, 0, "")
-ADD_OP(NextBuffer, 1, "%p")
+/* a glBegin/glEnd packed by the display list optimizer */
+ADD_OP(VertexBatch, 3, "%C %d %p")
 
 /* opengl 1.1 arrays */
 ADD_OP(ArrayElement, 1, "%d")
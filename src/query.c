@@ -0,0 +1,155 @@
+/*
+ * Occlusion queries (GL_SAMPLES_PASSED).
+ *
+ * While a query is active, every filled triangle is rasterized once more
+ * before it is drawn, by a variant that only counts the pixels passing the
+ * depth test into zb->samples_passed; see gl_draw_triangle_fill. Draws outside
+ * of a query do not pay for it. The result is known as soon as the query ends.
+ */
+
+#include "msghandling.h"
+#include "zgl.h"
+
+static GLint check_query(GLuint id)
+{
+    GLContext *c = gl_get_context();
+    if (id == 0 || id > MAX_QUERIES)
+        return 2;
+    return c->queries[id - 1].used;
+}
+
+void glGenQueries(GLsizei n, GLuint *ids)
+{
+    GLContext *c = gl_get_context();
+    GLint i, j = 0;
+#include "error_check.h"
+    for (i = 1; i <= MAX_QUERIES && j < n; i++)
+        if (!check_query(i)) {
+            c->queries[i - 1].used = 1;
+            c->queries[i - 1].result = 0;
+            ids[j++] = i;
+        }
+    for (; j < n; j++)
+        ids[j] = 0;
+}
+
+void glDeleteQueries(GLsizei n, const GLuint *ids)
+{
+    GLContext *c = gl_get_context();
+    GLint i;
+#include "error_check.h"
+    for (i = 0; i < n; i++) {
+        if (check_query(ids[i]) != 1)
+            continue;
+        if (c->current_query == ids[i])
+            c->current_query = 0;
+        c->queries[ids[i] - 1].used = 0;
+    }
+}
+
+GLboolean glIsQuery(GLuint id)
+{
+    if (check_query(id) == 1)
+        return GL_TRUE;
+    return GL_FALSE;
+}
+
+void glBeginQuery(GLenum target, GLuint id)
+{
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+#if TGL_HAS(ERROR_CHECK)
+    if (target != GL_SAMPLES_PASSED)
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+    if (c->current_query || check_query(id) == 2)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
+#else
+    if (target != GL_SAMPLES_PASSED || c->current_query ||
+        check_query(id) == 2)
+        return;
+#endif
+    /* the triangles drawn before the query must not be counted */
+    ZB_flushTriangles(c->zb);
+    c->zb->samples_passed = 0;
+    c->queries[id - 1].used = 1;
+    c->current_query = id;
+}
+
+void glEndQuery(GLenum target)
+{
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+#if TGL_HAS(ERROR_CHECK)
+    if (target != GL_SAMPLES_PASSED)
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+    if (!c->current_query)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
+#else
+    if (target != GL_SAMPLES_PASSED || !c->current_query)
+        return;
+#endif
+    ZB_flushTriangles(c->zb);
+    c->queries[c->current_query - 1].result = c->zb->samples_passed;
+    c->current_query = 0;
+}
+
+void glGetQueryiv(GLenum target, GLenum pname, GLint *params)
+{
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+#if TGL_HAS(ERROR_CHECK)
+    if (target != GL_SAMPLES_PASSED)
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+#else
+    if (target != GL_SAMPLES_PASSED)
+        return;
+#endif
+    switch (pname) {
+    case GL_CURRENT_QUERY:
+        *params = c->current_query;
+        break;
+    case GL_QUERY_COUNTER_BITS:
+        *params = 32;
+        break;
+    default:
+#if TGL_HAS(ERROR_CHECK)
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+#endif
+        break;
+    }
+}
+
+void glGetQueryObjectuiv(GLuint id, GLenum pname, GLuint *params)
+{
+    GLContext *c = gl_get_context();
+#include "error_check.h"
+#if TGL_HAS(ERROR_CHECK)
+    if (check_query(id) != 1 || id == c->current_query)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
+#else
+    if (check_query(id) != 1 || id == c->current_query)
+        return;
+#endif
+    switch (pname) {
+    case GL_QUERY_RESULT:
+        *params = c->queries[id - 1].result;
+        break;
+    case GL_QUERY_RESULT_AVAILABLE:
+        /* counted as the triangles are drawn: always ready once ended */
+        *params = GL_TRUE;
+        break;
+    default:
+#if TGL_HAS(ERROR_CHECK)
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+#endif
+        break;
+    }
+}
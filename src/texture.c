@@ -144,6 +144,8 @@ void glDeleteTextures(GLint n, const GLuint *textures)
 {
     GLContext *c = gl_get_context();
 #include "error_check.h"
+    /* pending triangles may still sample these textures */
+    ZB_flushTriangles(c->zb);
     for (GLint i = 0; i < n; i++) {
         GLTexture *t = find_texture(textures[i]);
         if (t) {
@@ -233,6 +235,7 @@ void glopCopyTexImage2D(GLParam *p)
 #endif
     }
 
+    ZB_flushTriangles(c->zb);
     GLImage *im = &c->current_texture->images[level];
     PIXEL *data = c->current_texture->images[level].pixmap;
     im->xsize = TGL_FEATURE_TEXTURE_DIM;
@@ -317,6 +320,7 @@ void glopTexImage1D(GLParam *p)
         pixels1 = pixels;
     }
 
+    ZB_flushTriangles(c->zb);
     GLImage *im = &c->current_texture->images[level];
     im->xsize = width;
     im->ysize = height;
@@ -385,6 +389,7 @@ void glopTexImage2D(GLParam *p)
         pixels1 = pixels;
     }
 
+    ZB_flushTriangles(c->zb);
     GLImage *im = &c->current_texture->images[level];
     im->xsize = width;
     im->ysize = height;
@@ -1,24 +1,31 @@
 #include <string.h>
 #include "zgl.h"
+#include "ztriangle_variants.h"
+
+void gl_normal3f(GLContext *c, GLfloat x, GLfloat y, GLfloat z)
+{
+    c->current_normal.X = x;
+    c->current_normal.Y = y;
+    c->current_normal.Z = z;
+    c->current_normal.W = 0;
+}
 
 void glopNormal(GLParam *p)
 {
-    GLContext *c = gl_get_context();
-    V3 v = {.X = p[1].f, .Y = p[2].f, .Z = p[3].f};
+    gl_normal3f(gl_get_context(), p[1].f, p[2].f, p[3].f);
+}
 
-    c->current_normal.X = v.X;
-    c->current_normal.Y = v.Y;
-    c->current_normal.Z = v.Z;
-    c->current_normal.W = 0;
+void gl_tex_coord4f(GLContext *c, GLfloat s, GLfloat t, GLfloat r, GLfloat q)
+{
+    c->current_tex_coord.X = s;
+    c->current_tex_coord.Y = t;
+    c->current_tex_coord.Z = r;
+    c->current_tex_coord.W = q;
 }
 
 void glopTexCoord(GLParam *p)
 {
-    GLContext *c = gl_get_context();
-    c->current_tex_coord.X = p[1].f;
-    c->current_tex_coord.Y = p[2].f;
-    c->current_tex_coord.Z = p[3].f;
-    c->current_tex_coord.W = p[4].f;
+    gl_tex_coord4f(gl_get_context(), p[1].f, p[2].f, p[3].f, p[4].f);
 }
 
 void glopEdgeFlag(GLParam *p)
@@ -27,28 +34,28 @@ void glopEdgeFlag(GLParam *p)
     c->current_edge_flag = p[1].i;
 }
 
-void glopColor(GLParam *p)
+void gl_color4f(GLContext *c, GLfloat r, GLfloat g, GLfloat b, GLfloat a)
 {
-    GLContext *c = gl_get_context();
-    c->current_color.X = p[1].f;
-    c->current_color.Y = p[2].f;
-    c->current_color.Z = p[3].f;
-    c->current_color.W = p[4].f;
+    c->current_color.X = r;
+    c->current_color.Y = g;
+    c->current_color.Z = b;
+    c->current_color.W = a;
 
     if (c->color_material_enabled) {
-        GLParam q[7] = {
-            [0].op = OP_Material,
-            [1].i = c->current_color_material_mode,
-            [2].i = c->current_color_material_type,
-            [3].f = p[1].f,
-            [4].f = p[2].f,
-            [5].f = p[3].f,
-            [6].f = p[4].f,
-        };
-        glopMaterial(q);
+#if TGL_HAS(LAZY_LIGHTING)
+        /* left to gl_light_vertices(), for the vertices given the color */
+        if (c->in_begin)
+            return;
+#endif
+        gl_color_material(c, &c->current_color);
     }
 }
 
+void glopColor(GLParam *p)
+{
+    gl_color4f(gl_get_context(), p[1].f, p[2].f, p[3].f, p[4].f);
+}
+
 void glopBegin(GLParam *p)
 {
     GLint type;
@@ -65,34 +72,16 @@ void glopBegin(GLParam *p)
     c->in_begin = 1;
     c->vertex_n = 0;
     c->vertex_cnt = 0;
-
-    if (c->matrix_model_projection_updated) {
-        if (c->lighting_enabled) {
-            /* precompute inverse modelview */
-            M4 tmp;
-            gl_M4_Inv(&tmp, c->matrix_stack_ptr[0]);
-            gl_M4_Transpose(&c->matrix_model_view_inv, &tmp);
-        } else {
-            GLfloat *m = &c->matrix_model_projection.m[0][0];
-            /* precompute projection matrix */
-            gl_M4_Mul(&c->matrix_model_projection, c->matrix_stack_ptr[1],
-                      c->matrix_stack_ptr[0]);
-            /* test to accelerate computation */
-            c->matrix_model_projection_no_w_transform = 0;
-            if (m[12] == 0.0 && m[13] == 0.0 && m[14] == 0.0)
-                /*
-                 if(c->matrix_model_projection.m[3][0] == 0.0 &&
-                    c->matrix_model_projection.m[3][1] == 0.0 &&
-                    c->matrix_model_projection.m[3][2] == 0.0)
-                */
-                c->matrix_model_projection_no_w_transform = 1;
-        }
-
-        /* test if the texture matrix is not Identity */
-        c->apply_texture_matrix = !gl_M4_IsId(c->matrix_stack_ptr[2]);
-
-        c->matrix_model_projection_updated = 0;
+    for (GLint i = 0; i < GL_VERTEX_RING; i++) {
+        c->vertex_ring[i] = &c->vertex[i];
+#if TGL_HAS(LAZY_LIGHTING)
+        c->vertex[i].shaded = 1;
+#endif
     }
+
+    gl_eval_model_projection(c);
+    if (c->lighting_enabled)
+        gl_eval_model_view_inv(c);
     /*  viewport- this is now updated on a glViewport call.
     if (c->viewport.updated) {
         gl_eval_viewport(c);
@@ -134,20 +123,42 @@ void glopBegin(GLParam *p)
             break;
         }
     }
+#if GL_BATCHED_SETUP
+    /* the batch feeds the scanline rasterizer, and must not reorder filled
+       triangles with the lines or points of the other face */
+    c->batch_triangles = c->draw_triangle_front == gl_draw_triangle_fill &&
+                         c->draw_triangle_back == gl_draw_triangle_fill &&
+                         zb_triangle_dispatch == &zb_triangle_dispatch_scanline;
+#if TGL_HAS(DEPTH_PREPASS)
+    /* the prepass records the points only */
+    c->batch_triangles &= !c->zb->depth_prepass;
+#endif
+#endif
 }
 
+#if !TGL_HAS(FIXED_POINT_GEOMETRY)
 static void gl_transform_to_viewport_vertex_c(GLContext *c, GLVertex *v)
 {
-    {
-        GLfloat winv = 1.0f / v->pc.W;
-        v->zp.x = clamp_viewport_coord(v->pc.X * winv * c->viewport.scale.X +
-                                       c->viewport.trans.X);
-        v->zp.y = clamp_viewport_coord(v->pc.Y * winv * c->viewport.scale.Y +
-                                       c->viewport.trans.Y);
-        v->zp.z = clamp_viewport_coord(v->pc.Z * winv * c->viewport.scale.Z +
-                                       c->viewport.trans.Z);
-    }
+    GLfloat winv = 1.0f / v->pc.W;
+    v->zp.x = clamp_viewport_coord(v->pc.X * winv * c->viewport.scale.X +
+                                   c->viewport.trans.X);
+    v->zp.y = clamp_viewport_coord(v->pc.Y * winv * c->viewport.scale.Y +
+                                   c->viewport.trans.Y);
+    v->zp.z = clamp_viewport_coord(v->pc.Z * winv * c->viewport.scale.Z +
+                                   c->viewport.trans.Z);
+}
+#endif
 
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+static void gl_transform_to_viewport_color_c(GLVertex *v)
+{
+    v->zp.r = gl_fixed_zcolor(gl_fixed(v->color.v[0]));
+    v->zp.g = gl_fixed_zcolor(gl_fixed(v->color.v[1]));
+    v->zp.b = gl_fixed_zcolor(gl_fixed(v->color.v[2]));
+}
+#else
+static void gl_transform_to_viewport_color_c(GLVertex *v)
+{
     v->zp.r =
         (GLint) (v->color.v[0] * COLOR_CORRECTED_MULT_MASK + COLOR_MIN_MULT) &
         COLOR_MASK;
@@ -157,6 +168,18 @@ static void gl_transform_to_viewport_vertex_c(GLContext *c, GLVertex *v)
     v->zp.b =
         (GLint) (v->color.v[2] * COLOR_CORRECTED_MULT_MASK + COLOR_MIN_MULT) &
         COLOR_MASK;
+}
+#endif
+
+/* the color and texture coordinates of the rasterizer */
+static void gl_transform_to_viewport_attributes_c(GLContext *c, GLVertex *v)
+{
+#if TGL_HAS(LAZY_LIGHTING)
+    if (v->shaded)
+#endif
+    {
+        gl_transform_to_viewport_color_c(v);
+    }
 
     if (c->texture_2d_enabled) {
         v->zp.s = (GLint) (v->tex_coord.X * (ZB_POINT_S_MAX - ZB_POINT_S_MIN) +
@@ -185,96 +208,164 @@ int gl_V3_Norm_Fast(V3 *a)
     return 0;
 }
 
-static void gl_vertex_transform(GLContext *c, GLVertex *v)
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+static void gl_vertex_normal(GLContext *c, GLVertex *v)
+{
+    const GLfixed *m = c->fx.model_view_inv;
+    V4 *n = &c->current_normal;
+    GLfixed x = gl_fixed(n->X), y = gl_fixed(n->Y), z = gl_fixed(n->Z);
+
+    v->normal.v[0] = gl_fixed_dot3(x, m[0], y, m[1], z, m[2]);
+    v->normal.v[1] = gl_fixed_dot3(x, m[4], y, m[5], z, m[6]);
+    v->normal.v[2] = gl_fixed_dot3(x, m[8], y, m[9], z, m[10]);
+
+    if (c->normalize_enabled) {
+        gl_fixed_norm3(v->normal.v);
+    }
+}
+
+/*
+ * The transform, the clip code and the mapping to the viewport of the vertex
+ * in fixed point: pc is only converted back to floating point for the
+ * clipper.
+ */
+static void gl_vertex_transform(GLContext *c, GLVertex *v, const V4 *coord)
 {
+    GLfixed x = gl_fixed(coord->X), y = gl_fixed(coord->Y);
+    GLfixed z = gl_fixed(coord->Z);
+    GLfixed px, py, pz, pw;
+    const GLfixed *m;
+    int64_t w;
+
     if (c->lighting_enabled) {
         /* eye coordinates needed for lighting */
-        GLfloat *m = &c->matrix_stack_ptr[0]->m[0][0];
-        v->ec.X =
-            (v->coord.X * m[0] + v->coord.Y * m[1] + v->coord.Z * m[2] + m[3]);
-        v->ec.Y =
-            (v->coord.X * m[4] + v->coord.Y * m[5] + v->coord.Z * m[6] + m[7]);
-        v->ec.Z = (v->coord.X * m[8] + v->coord.Y * m[9] + v->coord.Z * m[10] +
-                   m[11]);
-        v->ec.W = (v->coord.X * m[12] + v->coord.Y * m[13] +
-                   v->coord.Z * m[14] + m[15]);
-
-        /* projection coordinates */
-        m = &c->matrix_stack_ptr[1]->m[0][0];
-        v->pc.X =
-            (v->ec.X * m[0] + v->ec.Y * m[1] + v->ec.Z * m[2] + v->ec.W * m[3]);
-        v->pc.Y =
-            (v->ec.X * m[4] + v->ec.Y * m[5] + v->ec.Z * m[6] + v->ec.W * m[7]);
-        v->pc.Z = (v->ec.X * m[8] + v->ec.Y * m[9] + v->ec.Z * m[10] +
-                   v->ec.W * m[11]);
-        v->pc.W = (v->ec.X * m[12] + v->ec.Y * m[13] + v->ec.Z * m[14] +
-                   v->ec.W * m[15]);
+        m = c->fx.model_view;
+        v->ec.v[0] = gl_fixed_row(m, x, y, z);
+        v->ec.v[1] = gl_fixed_row(m + 4, x, y, z);
+        v->ec.v[2] = gl_fixed_row(m + 8, x, y, z);
 
-        m = &c->matrix_model_view_inv.m[0][0];
-        V4 *n = &c->current_normal;
+        gl_vertex_normal(c, v);
+    }
 
-        v->normal.X = (n->X * m[0] + n->Y * m[1] + n->Z * m[2]);
-        v->normal.Y = (n->X * m[4] + n->Y * m[5] + n->Z * m[6]);
-        v->normal.Z = (n->X * m[8] + n->Y * m[9] + n->Z * m[10]);
+    /* NOTE: W = 1 is assumed */
+    m = c->fx.model_projection;
+    px = gl_fixed_row(m, x, y, z);
+    py = gl_fixed_row(m + 4, x, y, z);
+    pz = gl_fixed_row(m + 8, x, y, z);
+    if (c->matrix_model_projection_no_w_transform)
+        pw = m[15];
+    else
+        pw = gl_fixed_row(m + 12, x, y, z);
+    v->pc.X = gl_fixed_to_float(px);
+    v->pc.Y = gl_fixed_to_float(py);
+    v->pc.Z = gl_fixed_to_float(pz);
+    v->pc.W = gl_fixed_to_float(pw);
+
+    /* gl_clipcode(), with an epsilon of 2^-16 */
+    w = (int64_t) pw + (pw >> GL_FIXED_BITS);
+    v->clip_code = (px < -w) | ((px > w) << 1) | ((py < -w) << 2) |
+                   ((py > w) << 3) | ((pz < -w) << 4) | ((pz > w) << 5);
+
+    if (v->clip_code == 0) {
+        GLViewport *vp = &c->viewport;
+        /* 2^30 / w, so that |p * winv| < 2^47 inside of the view volume */
+        int64_t winv = pw > 0 ? ((int64_t) 1 << (30 + GL_FIXED_BITS)) / pw : 0;
+        int64_t nx = (px * winv) >> 30, ny = (py * winv) >> 30;
+        int64_t nz = (pz * winv) >> 30;
+
+        v->zp.x = gl_fixed_trunc(((nx * vp->scale_fx[0]) >> GL_FIXED_BITS) +
+                                 vp->trans_fx[0]);
+        v->zp.y = gl_fixed_trunc(((ny * vp->scale_fx[1]) >> GL_FIXED_BITS) +
+                                 vp->trans_fx[1]);
+        v->zp.z = gl_fixed_trunc(((nz * vp->scale_fx[2]) >> GL_FIXED_BITS) +
+                                 vp->trans_fx[2]);
+    }
+}
+#else
+static void gl_vertex_normal(GLContext *c, GLVertex *v)
+{
+    GLfloat *m = &c->matrix_model_view_inv.m[0][0];
+    V4 *n = &c->current_normal;
 
-        if (c->normalize_enabled) {
-            gl_V3_Norm_Fast(&v->normal);
-        }
-    } else {
-        /* no eye coordinates needed, no normal */
-        /* NOTE: W = 1 is assumed */
-        GLfloat *m = &c->matrix_model_projection.m[0][0];
+    v->normal.X = (n->X * m[0] + n->Y * m[1] + n->Z * m[2]);
+    v->normal.Y = (n->X * m[4] + n->Y * m[5] + n->Z * m[6]);
+    v->normal.Z = (n->X * m[8] + n->Y * m[9] + n->Z * m[10]);
 
-        v->pc.X =
-            (v->coord.X * m[0] + v->coord.Y * m[1] + v->coord.Z * m[2] + m[3]);
-        v->pc.Y =
-            (v->coord.X * m[4] + v->coord.Y * m[5] + v->coord.Z * m[6] + m[7]);
-        v->pc.Z = (v->coord.X * m[8] + v->coord.Y * m[9] + v->coord.Z * m[10] +
-                   m[11]);
-        if (c->matrix_model_projection_no_w_transform) {
-            v->pc.W = m[15];
-        } else {
-            v->pc.W = (v->coord.X * m[12] + v->coord.Y * m[13] +
-                       v->coord.Z * m[14] + m[15]);
-        }
+    if (c->normalize_enabled) {
+        gl_V3_Norm_Fast(&v->normal);
     }
-
-    v->clip_code = gl_clipcode(v->pc.X, v->pc.Y, v->pc.Z, v->pc.W);
 }
 
-void glopVertex(GLParam *p)
+static void gl_vertex_transform(GLContext *c, GLVertex *v, const V4 *coord)
 {
-    GLint n;
-    GLContext *c = gl_get_context();
-#if TGL_HAS(ERROR_CHECK)
-    if (c->in_begin == 0)
-#define ERROR_FLAG GL_INVALID_OPERATION
-#include "error_check.h"
-#endif
-        n = c->vertex_n;
-    GLint cnt = c->vertex_cnt;
-    cnt++;
-    c->vertex_cnt = cnt;
+    GLfloat *m;
 
-    /* new vertex entry */
-    GLVertex *v = &c->vertex[n];
-    n++;
+    if (c->lighting_enabled) {
+        /* eye coordinates needed for lighting */
+        GLfloat ew;
+        m = &c->matrix_stack_ptr[0]->m[0][0];
+        v->ec.X = (coord->X * m[0] + coord->Y * m[1] + coord->Z * m[2] + m[3]);
+        v->ec.Y = (coord->X * m[4] + coord->Y * m[5] + coord->Z * m[6] + m[7]);
+        v->ec.Z =
+            (coord->X * m[8] + coord->Y * m[9] + coord->Z * m[10] + m[11]);
+        ew = (coord->X * m[12] + coord->Y * m[13] + coord->Z * m[14] + m[15]);
+
+        /* projection coordinates of the eye coordinates, rounded as they
+           always were */
+        m = &c->matrix_stack_ptr[1]->m[0][0];
+        v->pc.X =
+            (v->ec.X * m[0] + v->ec.Y * m[1] + v->ec.Z * m[2] + ew * m[3]);
+        v->pc.Y =
+            (v->ec.X * m[4] + v->ec.Y * m[5] + v->ec.Z * m[6] + ew * m[7]);
+        v->pc.Z =
+            (v->ec.X * m[8] + v->ec.Y * m[9] + v->ec.Z * m[10] + ew * m[11]);
+        v->pc.W =
+            (v->ec.X * m[12] + v->ec.Y * m[13] + v->ec.Z * m[14] + ew * m[15]);
+        v->clip_code = gl_clipcode(v->pc.X, v->pc.Y, v->pc.Z, v->pc.W);
+
+        gl_vertex_normal(c, v);
+        return;
+    }
 
-    v->coord.X = p[1].f;
-    v->coord.Y = p[2].f;
-    v->coord.Z = p[3].f;
-    v->coord.W = p[4].f;
+    /* projection coordinates */
+    /* NOTE: W = 1 is assumed */
+    m = &c->matrix_model_projection.m[0][0];
+    v->pc.X = (coord->X * m[0] + coord->Y * m[1] + coord->Z * m[2] + m[3]);
+    v->pc.Y = (coord->X * m[4] + coord->Y * m[5] + coord->Z * m[6] + m[7]);
+    v->pc.Z = (coord->X * m[8] + coord->Y * m[9] + coord->Z * m[10] + m[11]);
+    if (c->matrix_model_projection_no_w_transform) {
+        v->pc.W = m[15];
+    } else {
+        v->pc.W =
+            (coord->X * m[12] + coord->Y * m[13] + coord->Z * m[14] + m[15]);
+    }
 
-    gl_vertex_transform(c, v);
+    v->clip_code = gl_clipcode(v->pc.X, v->pc.Y, v->pc.Z, v->pc.W);
+}
+#endif
 
+/*
+ * The color and texture coordinates of a vertex, once its position and normal
+ * are transformed.
+ */
+static void gl_vertex_attributes(GLContext *c, GLVertex *v)
+{
     /* color */
 
     if (c->lighting_enabled) {
+#if TGL_HAS(LAZY_LIGHTING)
+        /* lit by gl_light_vertices() once a primitive draws it, with the
+         * color for GL_COLOR_MATERIAL kept until then */
+        v->color = c->current_color;
+        v->shaded = 0;
+#else
         gl_shade_vertex(v);
-#include "error_check.h"
-
+#endif
     } else {
         v->color = c->current_color;
+#if TGL_HAS(LAZY_LIGHTING)
+        v->shaded = 1;
+#endif
     }
     /* tex coords */
 #if TGL_OPTIMIZATION_HINT_BRANCH_COST < 1
@@ -293,44 +384,132 @@ void glopVertex(GLParam *p)
     if (v->clip_code == 0)
 #endif
     {
-        gl_transform_to_viewport_vertex_c(c, v);
+        gl_transform_to_viewport_attributes_c(c, v);
     }
 
     /* edge flag */
     v->edge_flag = c->current_edge_flag;
+}
+
+#if TGL_HAS(LAZY_LIGHTING)
+static void gl_light_batch(GLContext *c, GLVertex **v, GLint n)
+{
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    /* which sets zp.r/g/b as well */
+    gl_shade_vertices(c, v, n);
+#else
+    GLint i;
+
+#if TGL_HAS(BATCHED_LIGHTING)
+    gl_shade_vertices(c, v, n);
+#else
+    (void) c;
+#endif
+    for (i = 0; i < n; i++) {
+#if !TGL_HAS(BATCHED_LIGHTING)
+        gl_shade_vertex(v[i]);
+#endif
+        gl_transform_to_viewport_color_c(v[i]);
+    }
+#endif
+}
+
+/* Light the vertices of v not lit yet, GL_LIGHT_BATCH at a time. */
+void gl_light_vertices(GLContext *c, GLVertex **v, GLint n)
+{
+    GLVertex *batch[GL_LIGHT_BATCH];
+    GLint i, nb = 0;
+
+    for (i = 0; i < n; i++) {
+        if (v[i]->shaded)
+            continue;
+        v[i]->shaded = 1;
+        if (gl_color_material_stale(c, &v[i]->color)) {
+            /* the batch so far is lit with the material it was given */
+            if (nb > 0) {
+                gl_light_batch(c, batch, nb);
+                nb = 0;
+            }
+            gl_color_material(c, &v[i]->color);
+        }
+        batch[nb++] = v[i];
+        if (nb == GL_LIGHT_BATCH) {
+            gl_light_batch(c, batch, nb);
+            nb = 0;
+        }
+    }
+    if (nb > 0)
+        gl_light_batch(c, batch, nb);
+}
+
+/*
+ * Light the vertices of the current primitive not drawn yet, before glMaterial
+ * changes the material they were given.
+ */
+void gl_light_pending(GLContext *c)
+{
+    GLVertex *v[GL_VERTEX_RING];
+    GLint i;
+
+    for (i = 0; i < GL_VERTEX_RING; i++)
+        v[i] = &c->vertex[i];
+    gl_light_vertices(c, v, GL_VERTEX_RING);
+}
+#endif
+
+/* Exchange two slots of the ring, instead of the vertices they hold. */
+static inline void gl_vertex_swap(GLContext *c, GLint i, GLint j)
+{
+    GLVertex *v = c->vertex_ring[i];
+    c->vertex_ring[i] = c->vertex_ring[j];
+    c->vertex_ring[j] = v;
+}
+
+/*
+ * Assemble the primitives ending with the vertex c->vertex_ring[c->vertex_n].
+ * The vertices kept for the next primitives are moved to the front of the
+ * ring by swapping its slots, never by copying them.
+ */
+void gl_vertex_assemble(GLContext *c)
+{
+    GLVertex **v = c->vertex_ring;
+    GLint n = c->vertex_n + 1;
+    GLint cnt = ++c->vertex_cnt;
 
     switch (c->begin_type) {
     case GL_POINTS:
-        gl_draw_point(&c->vertex[0]);
+        gl_draw_point(v[0]);
         n = 0;
         break;
 
     case GL_LINES:
         if (n == 2) {
-            gl_draw_line(&c->vertex[0], &c->vertex[1]);
+            gl_draw_line(v[0], v[1]);
             n = 0;
         }
         break;
     case GL_LINE_STRIP:
+        if (n == 2) {
+            gl_draw_line(v[0], v[1]);
+            gl_vertex_swap(c, 0, 1);
+            n = 1;
+        }
+        break;
 #if TGL_HAS(GL_POLYGON)
+    /* the first vertex stays in v[0], the last one in v[1] */
     case GL_LINE_LOOP:
-#endif
-        switch (n) {
-        case 1: {
-            c->vertex[2] = c->vertex[0];
-        } break;
-        case 2: {
-            gl_draw_line(&c->vertex[0], &c->vertex[1]);
-            c->vertex[0] = c->vertex[1];
-            n = 1;
-        } break;
-        default:
-            break;
-        };
+        if (n == 2) {
+            gl_draw_line(v[0], v[1]);
+        } else if (n == 3) {
+            gl_draw_line(v[1], v[2]);
+            gl_vertex_swap(c, 1, 2);
+            n = 2;
+        }
         break;
+#endif
     case GL_TRIANGLES:
         if (n == 3) {
-            gl_draw_triangle(&c->vertex[0], &c->vertex[1], &c->vertex[2]);
+            gl_draw_triangle(v[0], v[1], v[2]);
             n = 0;
         }
         break;
@@ -341,46 +520,52 @@ void glopVertex(GLParam *p)
             /* needed to respect triangle orientation */
             switch (cnt & 1) {
             case 0:
-                gl_draw_triangle(&c->vertex[2], &c->vertex[1], &c->vertex[0]);
+                gl_draw_triangle(v[2], v[1], v[0]);
                 break;
             default:
             case 1:
-                gl_draw_triangle(&c->vertex[0], &c->vertex[1], &c->vertex[2]);
+                gl_draw_triangle(v[0], v[1], v[2]);
                 break;
             }
         }
         break;
     case GL_TRIANGLE_FAN:
         if (n == 3) {
-            gl_draw_triangle(&c->vertex[0], &c->vertex[1], &c->vertex[2]);
-            c->vertex[1] = c->vertex[2];
+            gl_draw_triangle(v[0], v[1], v[2]);
+            gl_vertex_swap(c, 1, 2);
             n = 2;
         }
         break;
 
     case GL_QUADS:
         if (n == 4) {
-            c->vertex[2].edge_flag = 0;
-            gl_draw_triangle(&c->vertex[0], &c->vertex[1], &c->vertex[2]);
-            c->vertex[2].edge_flag = 1;
-            c->vertex[0].edge_flag = 0;
-            gl_draw_triangle(&c->vertex[0], &c->vertex[2], &c->vertex[3]);
+            v[2]->edge_flag = 0;
+            gl_draw_triangle(v[0], v[1], v[2]);
+            v[2]->edge_flag = 1;
+            v[0]->edge_flag = 0;
+            gl_draw_triangle(v[0], v[2], v[3]);
             n = 0;
         }
         break;
 
     case GL_QUAD_STRIP:
         if (n == 4) {
-            gl_draw_triangle(&c->vertex[0], &c->vertex[1], &c->vertex[2]);
-            gl_draw_triangle(&c->vertex[1], &c->vertex[3], &c->vertex[2]);
-            for (GLint i = 0; i < 2; i++)
-                c->vertex[i] = c->vertex[i + 2];
+            gl_draw_triangle(v[0], v[1], v[2]);
+            gl_draw_triangle(v[1], v[3], v[2]);
+            gl_vertex_swap(c, 0, 2);
+            gl_vertex_swap(c, 1, 3);
             n = 2;
         }
         break;
 
 #if TGL_HAS(GL_POLYGON)
+    /* a fan around the first vertex */
     case GL_POLYGON:
+        if (n == 3) {
+            gl_draw_triangle(v[2], v[0], v[1]);
+            gl_vertex_swap(c, 1, 2);
+            n = 2;
+        }
         break;
 #endif
 #if TGL_HAS(ERROR_CHECK)
@@ -395,6 +580,174 @@ void glopVertex(GLParam *p)
     c->vertex_n = n;
 }
 
+#if GL_BULK_TRANSFORM
+/*
+ * gl_vertex_transform() and the mapping to the viewport of a whole batch of
+ * vertices, one loop per step so that the compiler turns each of them into
+ * SSE2/NEON code. The operations are the very same, in the same order, so
+ * that every vertex has the exact coordinates glVertex would give it.
+ */
+void gl_transform_vertices(GLContext *c, GLVertexBatch *b, GLint n)
+{
+    GLfloat sx = c->viewport.scale.X, tx = c->viewport.trans.X;
+    GLfloat sy = c->viewport.scale.Y, ty = c->viewport.trans.Y;
+    GLfloat sz = c->viewport.scale.Z, tz = c->viewport.trans.Z;
+    GLfloat m[16];
+    GLint i;
+
+    /* a copy, that the stores to the batch cannot alias */
+    if (c->lighting_enabled) {
+        memcpy(m, c->matrix_stack_ptr[0]->m, sizeof(m));
+        for (i = 0; i < n; i++) {
+            GLfloat x = b->x[i], y = b->y[i], z = b->z[i];
+            b->ex[i] = (x * m[0] + y * m[1] + z * m[2] + m[3]);
+            b->ey[i] = (x * m[4] + y * m[5] + z * m[6] + m[7]);
+            b->ez[i] = (x * m[8] + y * m[9] + z * m[10] + m[11]);
+            b->ew[i] = (x * m[12] + y * m[13] + z * m[14] + m[15]);
+        }
+        memcpy(m, c->matrix_stack_ptr[1]->m, sizeof(m));
+        for (i = 0; i < n; i++) {
+            GLfloat x = b->ex[i], y = b->ey[i], z = b->ez[i], w = b->ew[i];
+            b->px[i] = (x * m[0] + y * m[1] + z * m[2] + w * m[3]);
+            b->py[i] = (x * m[4] + y * m[5] + z * m[6] + w * m[7]);
+            b->pz[i] = (x * m[8] + y * m[9] + z * m[10] + w * m[11]);
+            b->pw[i] = (x * m[12] + y * m[13] + z * m[14] + w * m[15]);
+        }
+    } else {
+        /* NOTE: W = 1 is assumed */
+        memcpy(m, c->matrix_model_projection.m, sizeof(m));
+        for (i = 0; i < n; i++) {
+            GLfloat x = b->x[i], y = b->y[i], z = b->z[i];
+            b->px[i] = (x * m[0] + y * m[1] + z * m[2] + m[3]);
+            b->py[i] = (x * m[4] + y * m[5] + z * m[6] + m[7]);
+            b->pz[i] = (x * m[8] + y * m[9] + z * m[10] + m[11]);
+            b->pw[i] = (x * m[12] + y * m[13] + z * m[14] + m[15]);
+        }
+        if (c->matrix_model_projection_no_w_transform)
+            for (i = 0; i < n; i++)
+                b->pw[i] = m[15];
+    }
+
+    /* gl_clipcode() */
+    for (i = 0; i < n; i++) {
+        GLfloat x = b->px[i], y = b->py[i], z = b->pz[i];
+        GLfloat w = b->pw[i] * (1.0 + CLIP_EPSILON);
+        b->clip_code[i] = (x < -w) | ((x > w) << 1) | ((y < -w) << 2) |
+                          ((y > w) << 3) | ((z < -w) << 4) | ((z > w) << 5);
+    }
+
+    /* gl_transform_to_viewport_vertex_c(), for the clipped vertices too */
+    for (i = 0; i < n; i++) {
+        GLfloat winv = 1.0f / b->pw[i];
+        b->wx[i] = clamp_viewport_coord(b->px[i] * winv * sx + tx);
+        b->wy[i] = clamp_viewport_coord(b->py[i] * winv * sy + ty);
+        b->wz[i] = clamp_viewport_coord(b->pz[i] * winv * sz + tz);
+    }
+}
+
+/* glVertex, for the i-th vertex of a batch gone through gl_transform_vertices() */
+void gl_add_vertex(GLContext *c, const GLVertexBatch *b, GLint i)
+{
+    GLVertex *v = c->vertex_ring[c->vertex_n];
+
+    if (c->lighting_enabled) {
+        v->ec.X = b->ex[i];
+        v->ec.Y = b->ey[i];
+        v->ec.Z = b->ez[i];
+        gl_vertex_normal(c, v);
+    }
+    v->pc.X = b->px[i];
+    v->pc.Y = b->py[i];
+    v->pc.Z = b->pz[i];
+    v->pc.W = b->pw[i];
+    v->clip_code = b->clip_code[i];
+    v->zp.x = b->wx[i];
+    v->zp.y = b->wy[i];
+    v->zp.z = b->wz[i];
+
+    gl_vertex_attributes(c, v);
+#include "error_check.h"
+    gl_vertex_assemble(c);
+}
+#endif
+
+/* Everything glVertex computes for the vertex of object coordinates coord. */
+void gl_eval_vertex(GLContext *c, GLVertex *v, const V4 *coord)
+{
+    gl_vertex_transform(c, v, coord);
+#if !TGL_HAS(FIXED_POINT_GEOMETRY)
+#if TGL_OPTIMIZATION_HINT_BRANCH_COST < 2
+    if (v->clip_code == 0)
+#endif
+    {
+        gl_transform_to_viewport_vertex_c(c, v);
+    }
+#endif
+    gl_vertex_attributes(c, v);
+}
+
+void gl_vertex4f(GLContext *c, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+    GLVertex *v;
+    V4 coord = {.X = x, .Y = y, .Z = z, .W = w};
+#if TGL_HAS(ERROR_CHECK)
+    if (c->in_begin == 0)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
+#endif
+        /* new vertex entry */
+        v = c->vertex_ring[c->vertex_n];
+
+    gl_eval_vertex(c, v, &coord);
+#include "error_check.h"
+    gl_vertex_assemble(c);
+}
+
+void glopVertex(GLParam *p)
+{
+    gl_vertex4f(gl_get_context(), p[1].f, p[2].f, p[3].f, p[4].f);
+}
+
+/*
+ * glBegin(p[1]), glVertex3fv for each of the p[2] positions at p[3], and
+ * glEnd: a primitive the display list optimizer packed.
+ */
+void glopVertexBatch(GLParam *p)
+{
+    GLContext *c = gl_get_context();
+    const GLfloat *a = p[3].p;
+    GLint count = p[2].i;
+    GLint i;
+#if GL_BULK_TRANSFORM
+    GLVertexBatch b;
+    GLint j, n;
+#endif
+
+    glopBegin(p);
+#include "error_check.h"
+#if GL_BULK_TRANSFORM
+    for (i = 0; i < count; i += n) {
+        n = count - i < GL_VERTEX_BATCH ? count - i : GL_VERTEX_BATCH;
+        for (j = 0; j < n; j++, a += 3) {
+            b.x[j] = a[0];
+            b.y[j] = a[1];
+            b.z[j] = a[2];
+        }
+        gl_transform_vertices(c, &b, n);
+        for (j = 0; j < n; j++)
+            gl_add_vertex(c, &b, j);
+    }
+#else
+    for (i = 0; i < count; i++, a += 3) {
+        V4 coord = {.X = a[0], .Y = a[1], .Z = a[2], .W = 1.0f};
+        gl_eval_vertex(c, c->vertex_ring[c->vertex_n], &coord);
+#include "error_check.h"
+        gl_vertex_assemble(c);
+    }
+#endif
+    glopEnd(p);
+}
+
 void glopEnd(GLParam *param)
 {
     GLContext *c = gl_get_context();
@@ -408,18 +761,16 @@ void glopEnd(GLParam *param)
 #endif
 
 #if TGL_HAS(GL_POLYGON)
-        if (c->begin_type == GL_LINE_LOOP) {
-            if (c->vertex_cnt >= 3) {
-                gl_draw_line(&c->vertex[0], &c->vertex[2]);
-            }
-        } else if (c->begin_type == GL_POLYGON) {
-            GLint i = c->vertex_cnt;
-            while (i >= 3) {
-                i--;
-                gl_draw_triangle(&c->vertex[i], &c->vertex[0],
-                                 &c->vertex[i - 1]);
-            }
-        }
+        if (c->begin_type == GL_LINE_LOOP && c->vertex_cnt >= 3)
+            gl_draw_line(c->vertex_ring[1], c->vertex_ring[0]);
+#endif
+#if GL_BATCHED_SETUP
+    gl_flush_triangles(c);
+    c->batch_triangles = 0;
+#endif
+#if TGL_HAS(LAZY_LIGHTING)
+    /* the material of the last glColor, as after glColor outside glBegin */
+    gl_color_material_update(c, &c->current_color);
 #endif
     c->in_begin = 0;
 }
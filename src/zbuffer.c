@@ -63,6 +63,20 @@ ZBuffer *ZB_open(GLint xsize,
 #if TGL_HAS(DIRTY_RECTANGLE)
     zb->dirty_rect.valid = 0;
 #endif
+#if ZB_CLIP_ROWS
+    zb->clip_ymin = 0;
+    zb->clip_ymax = zb->ysize - 1;
+#endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    ZB_initHiZ(zb);
+#endif
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+    ZB_initTiles(zb);
+#endif
+#if TGL_HAS(DEPTH_PREPASS)
+    zb->depth_prepass = 0;
+    zb->prepass = NULL;
+#endif
 
     return zb;
 error:
@@ -72,6 +86,15 @@ error:
 
 void ZB_close(ZBuffer *zb)
 {
+#if TGL_HAS(DEPTH_PREPASS)
+    ZB_closePrepass(zb);
+#endif
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+    ZB_closeTiles(zb);
+#endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    ZB_closeHiZ(zb);
+#endif
     if (zb->frame_buffer_allocated)
         gl_free(zb->pbuf);
 
@@ -79,6 +102,19 @@ void ZB_close(ZBuffer *zb)
     gl_free(zb);
 }
 
+#if TGL_HAS(MULTITHREADED_TILED_RASTER) || TGL_HAS(DEPTH_PREPASS)
+void ZB_flushTriangles(ZBuffer *zb)
+{
+#if TGL_HAS(DEPTH_PREPASS)
+    /* the second pass may go to the tile bins */
+    ZB_flushPrepass(zb);
+#endif
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+    ZB_flushTiles(zb);
+#endif
+}
+#endif
+
 /*
  * Resize the ZBuffer. Returns 0 on success, -1 on allocation failure.
  * On failure, the original buffer state is preserved.
@@ -106,6 +142,8 @@ GLint ZB_resize(ZBuffer *zb, void *frame_buffer, GLint xsize, GLint ysize)
         }
     }
 
+    ZB_flushTriangles(zb);
+
     /* Only free old buffers after successful allocation */
     gl_free(zb->zbuf);
     if (zb->frame_buffer_allocated)
@@ -128,6 +166,19 @@ GLint ZB_resize(ZBuffer *zb, void *frame_buffer, GLint xsize, GLint ysize)
     /* Reset dirty rectangle after resize to avoid stale bounds */
     ZB_resetDirtyRect(zb);
 #endif
+#if ZB_CLIP_ROWS
+    zb->clip_ymin = 0;
+    zb->clip_ymax = zb->ysize - 1;
+#endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    ZB_closeHiZ(zb);
+    ZB_initHiZ(zb);
+#endif
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+    /* the number of bands follows the height */
+    ZB_closeTiles(zb);
+    ZB_initTiles(zb);
+#endif
 
     return 0;
 }
@@ -209,6 +260,8 @@ static void ZB_copyBuffer(ZBuffer *zb, void *buf, GLint linesize)
     GLint i;
 #endif
 
+    ZB_flushTriangles(zb);
+
 #if TGL_HAS(DIRTY_RECTANGLE)
     /* Selective copy: only copy dirty region if valid */
     GLint y_start, y_end, x_start, x_end, copy_width;
@@ -374,6 +427,8 @@ void ZB_clear(ZBuffer *zb,
     GLint y;
     PIXEL *pp;
 
+    ZB_flushTriangles(zb);
+
 #if TGL_HAS(DIRTY_RECTANGLE)
     /* Mark entire framebuffer as dirty when clearing color buffer */
     if (clear_color) {
@@ -393,6 +448,9 @@ void ZB_clear(ZBuffer *zb,
             /* Arbitrary 16-bit value - use manual loop */
             memset_s(zb->zbuf, z, zbuf_size);
         }
+#if TGL_HAS(HIERARCHICAL_Z)
+        ZB_clearHiZ(zb, z);
+#endif
     }
     if (clear_color) {
         pp = zb->pbuf;
@@ -0,0 +1,153 @@
+/*
+ * s15.16 fixed point arithmetic, for TGL_FEATURE_FIXED_POINT_GEOMETRY.
+ *
+ * A GLfixed holds x * 65536, like the 16.16 edge slopes and the color
+ * components of the rasterizers. Products and their sums are computed on 64
+ * bits and saturated to +-32767.99998 when they are brought back to 32. Only
+ * integer additions, multiplications, shifts and divisions are used, save for
+ * the conversions from and to float at the ends of the vertex path.
+ */
+
+#ifndef ZFIXED_H
+#define ZFIXED_H
+
+#include <stdint.h>
+#include <TGL/gl.h>
+
+#define GL_FIXED_BITS 16
+#define GL_FIXED_ONE (1 << GL_FIXED_BITS)
+
+typedef GLint GLfixed;
+
+/* the eye coordinates and normals of the vertices */
+typedef struct {
+    GLfixed v[3];
+} V3X;
+
+static inline GLfixed gl_fixed_sat(int64_t x)
+{
+    return x > INT32_MAX    ? INT32_MAX
+           : x < -INT32_MAX ? -INT32_MAX
+                            : (GLfixed) x;
+}
+
+static inline GLfixed gl_fixed(GLfloat f)
+{
+    GLfloat x = f * GL_FIXED_ONE;
+
+    if (!(x == x))
+        return 0;
+    return x >= 2147483647.0f    ? INT32_MAX
+           : x <= -2147483647.0f ? -INT32_MAX
+                                 : (GLfixed) x;
+}
+
+static inline GLfloat gl_fixed_to_float(GLfixed x)
+{
+    return x * (1.0f / GL_FIXED_ONE);
+}
+
+static inline GLfixed gl_fixed_add(GLfixed a, GLfixed b)
+{
+    return gl_fixed_sat((int64_t) a + b);
+}
+
+static inline GLfixed gl_fixed_mul(GLfixed a, GLfixed b)
+{
+    return gl_fixed_sat(((int64_t) a * b) >> GL_FIXED_BITS);
+}
+
+/* a / b, saturated when b is 0 */
+static inline GLfixed gl_fixed_div(GLfixed a, GLfixed b)
+{
+    if (b == 0)
+        return a < 0 ? -INT32_MAX : INT32_MAX;
+    return gl_fixed_sat(((int64_t) a << GL_FIXED_BITS) / b);
+}
+
+/* a0 * b0 + a1 * b1 + a2 * b2 */
+static inline GLfixed gl_fixed_dot3(GLfixed a0,
+                                    GLfixed b0,
+                                    GLfixed a1,
+                                    GLfixed b1,
+                                    GLfixed a2,
+                                    GLfixed b2)
+{
+    return gl_fixed_sat(((int64_t) a0 * b0 + (int64_t) a1 * b1 +
+                         (int64_t) a2 * b2) >>
+                        GL_FIXED_BITS);
+}
+
+/* the product of the row m[0..3] of a matrix with (x, y, z, 1) */
+static inline GLfixed gl_fixed_row(const GLfixed *m,
+                                   GLfixed x,
+                                   GLfixed y,
+                                   GLfixed z)
+{
+    int64_t s = (int64_t) m[0] * x + (int64_t) m[1] * y + (int64_t) m[2] * z;
+
+    return gl_fixed_sat((s + ((int64_t) m[3] << GL_FIXED_BITS)) >>
+                        GL_FIXED_BITS);
+}
+
+/* floor(sqrt(x)), bit by bit */
+static inline GLuint gl_isqrt64(uint64_t x)
+{
+    uint64_t r = 0, b = (uint64_t) 1 << 62;
+
+    while (b > x)
+        b >>= 2;
+    while (b != 0) {
+        if (x >= r + b) {
+            x -= r + b;
+            r = (r >> 1) + b;
+        } else {
+            r >>= 1;
+        }
+        b >>= 2;
+    }
+    return (GLuint) r;
+}
+
+/* the length of (x, y, z); the squares of GLfixed values fit in 62 bits */
+static inline GLfixed gl_fixed_length(GLfixed x, GLfixed y, GLfixed z)
+{
+    uint64_t s = (uint64_t) ((int64_t) x * x) + (uint64_t) ((int64_t) y * y) +
+                 (uint64_t) ((int64_t) z * z);
+    GLuint r = gl_isqrt64(s);
+
+    return r > INT32_MAX ? INT32_MAX : (GLfixed) r;
+}
+
+/*
+ * Divide v by len, its length, through 2^30 / len: the quotients keep their
+ * 16 fraction bits for any length, and no component exceeds len.
+ */
+static inline void gl_fixed_scale3(GLfixed *v, GLfixed len)
+{
+    int64_t inv = ((int64_t) 1 << (30 + GL_FIXED_BITS)) / len;
+
+    v[0] = (GLfixed) (((int64_t) v[0] * inv) >> 30);
+    v[1] = (GLfixed) (((int64_t) v[1] * inv) >> 30);
+    v[2] = (GLfixed) (((int64_t) v[2] * inv) >> 30);
+}
+
+/* gl_V3_Norm_Fast(): returns 1, leaving v as it is, when its length is 0 */
+static inline GLint gl_fixed_norm3(GLfixed *v)
+{
+    GLfixed len = gl_fixed_length(v[0], v[1], v[2]);
+
+    if (len == 0)
+        return 1;
+    gl_fixed_scale3(v, len);
+    return 0;
+}
+
+/* x truncated to an integer, from a value with 16 fraction bits */
+static inline GLint gl_fixed_trunc(int64_t x)
+{
+    x = x >= 0 ? x >> GL_FIXED_BITS : -(-x >> GL_FIXED_BITS);
+    return x > INT32_MAX ? INT32_MAX : x < INT32_MIN ? INT32_MIN : (GLint) x;
+}
+
+#endif /* ZFIXED_H */
@@ -9,9 +9,13 @@
 #include "zbuffer.h"
 #include "zfeatures.h"
 #include "zmath.h"
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+#include "zfixed.h"
+#endif
 
 #include <limits.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -36,16 +40,30 @@ static inline GLint clamp_viewport_coord(GLfloat result)
     return (GLint) result;
 }
 
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+#if !TGL_HAS(BATCHED_LIGHTING)
+#error "TGL_FEATURE_FIXED_POINT_GEOMETRY needs TGL_FEATURE_BATCHED_LIGHTING"
+#endif
+
+/* the 8.16 color component of the rasterizers, from one from 0 to 1 */
+static inline GLint gl_fixed_zcolor(GLfixed x)
+{
+    return (x * (COLOR_CORRECTED_MULT_MASK >> GL_FIXED_BITS) + COLOR_MIN_MULT) &
+           COLOR_MASK;
+}
+#endif
+
 enum {
 #define ADD_OP(a, b, c) OP_##a,
 #include "opinfo.h"
 };
 
-#if TGL_HAS(GL_POLYGON)
-#define POLYGON_MAX_VERTEX 16
-#else
-#define POLYGON_MAX_VERTEX 4
-#endif
+/*
+ * Number of vertex slots for the primitive being assembled: a quad. Polygons
+ * and line loops keep their first vertex and the last one, whatever their
+ * number of vertices.
+ */
+#define GL_VERTEX_RING 4
 
 /* Max # of specular light pow buffers */
 #define MAX_SPECULAR_BUFFERS 32
@@ -66,8 +84,10 @@ enum {
 #define NORMAL_ARRAY 0x0004
 #define TEXCOORD_ARRAY 0x0008
 
+/* reported by glGet; the display lists are only limited by memory */
 #define MAX_DISPLAY_LISTS 16384
-#define OP_BUFFER_MAX_SIZE 4096
+/* the initial size of the ops of a display list, and of its name table */
+#define LIST_MIN_SIZE 32
 
 #define TGL_OFFSET_FILL 0x1
 #define TGL_OFFSET_LINE 0x2
@@ -80,6 +100,23 @@ typedef struct GLSpecBuf {
     struct GLSpecBuf *next;
 } GLSpecBuf;
 
+#if TGL_HAS(BATCHED_LIGHTING)
+/*
+ * pow(x, e) for x from 0 to 1: pow(x, e / 2^squarings) at the ends of the
+ * intervals, interpolated linearly and squared back to the power e, or pow()
+ * itself when squarings is negative.
+ */
+typedef struct GLPowTable {
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    GLfixed v[TGL_POW_TABLE_SIZE + 1];
+#else
+    GLfloat v[TGL_POW_TABLE_SIZE + 1];
+#endif
+    GLint squarings;
+    GLfloat e;
+} GLPowTable;
+#endif
+
 typedef struct GLLight {
     V4 ambient;
     V4 diffuse;
@@ -93,6 +130,20 @@ typedef struct GLLight {
     GLfloat attenuation[3];
     /* precomputed values */
     GLfloat cos_spot_cutoff;
+#if TGL_HAS(BATCHED_LIGHTING)
+    /* products with the front material, and pow(x, spot_exponent) */
+    V3 ambient_m, diffuse_m, specular_m;
+    GLPowTable spot_table;
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    /* the values gl_shade_vertices() reads, in fixed point */
+    struct {
+        GLfixed ambient_m[3], diffuse_m[3], specular_m[3];
+        GLfixed position[3], norm_position[3], norm_spot_direction[3];
+        GLfixed attenuation[3], cos_spot_cutoff;
+        GLint at_infinity, spot;
+    } fx;
+#endif
+#endif
 
     /* we use a linked list to know which are the enabled lights */
 
@@ -110,11 +161,19 @@ typedef struct GLMaterial {
     /* computed values */
     GLint shininess_i;
     GLint do_specular;
+#if TGL_HAS(BATCHED_LIGHTING)
+    /* pow(x, shininess) */
+    GLPowTable shininess_table;
+#endif
 } GLMaterial;
 
 typedef struct GLViewport {
     V3 scale;
     V3 trans;
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    /* scale and trans, with 16 fraction bits */
+    int64_t scale_fx[3], trans_fx[3];
+#endif
     GLint xmin, ymin, xsize, ysize;
 
 } GLViewport;
@@ -127,30 +186,86 @@ typedef union {
     void *p;
 } GLParam;
 
-typedef struct GLParamBuffer {
-    GLParam ops[OP_BUFFER_MAX_SIZE];
-    struct GLParamBuffer *next;
-} GLParamBuffer;
+/*
+ * With computed gotos, a compiled op is preceded by its code: the address of
+ * the code in the list interpreter running it (see list.c).
+ */
+#if TGL_HAS(THREADED_LISTS) && defined(__GNUC__) && !TGL_HAS(ERROR_CHECK)
+#define GL_OP_CODE 1
+#else
+#define GL_OP_CODE 0
+#endif
+
+#if TGL_HAS(LIST_FILES)
+/* a file of display lists loaded by glLoadListsTGL(), for as long as one of
+   its lists is */
+typedef struct GLListFile {
+    void *addr;
+    size_t size;
+    GLint mapped, refs;
+} GLListFile;
+#endif
 
 typedef struct GLList {
-    GLParamBuffer *first_op_buffer;
-    /* TODO: extensions for an hash table or a better allocating scheme */
+    /*
+     * The ops of the list, in a block doubling in size as they are compiled,
+     * and shrunk to fit at glEndList. The positions of the vertices packed by
+     * the optimizer follow them.
+     */
+    GLParam *ops;
+    GLint size, max_size;
+    GLuint name;
+#if TGL_HAS(LIST_FILES)
+    /* the file ops points into, instead of a block of their own */
+    GLListFile *file;
+#endif
+#if TGL_HAS(BOUNDS_CULLING)
+    /*
+     * The box of the vertices, when the list only draws primitives, between
+     * the glBegin and glEnd it contains.
+     */
+    GLint bounded, in_begin;
+    V3 min, max;
+    /* where its last glColor, glNormal, glTexCoord and glEdgeFlag are, or -1 */
+    GLint current[4];
+#endif
 } GLList;
 
+/*
+ * A vertex once glVertex has transformed it. The fields read by the clipper
+ * and the rasterizers for every primitive come first, and fit in a cache line.
+ * The colors, texture coordinates and lighting inputs follow, read while a
+ * vertex is lit, clipped or projected to the viewport. The object coordinates
+ * are not kept: nothing reads them after the transform.
+ *
+ * The two parts stay in one structure, rather than in a hot and a cold array
+ * indexed alike: the clipper makes vertices of its own on the stack, the ring
+ * and the locked arrays cache move whole vertices by pointer or by copy, and
+ * feedback and glRasterPos read them whole. Each of those would need a pair
+ * of pointers, for a layout the vertex benchmarks do not tell apart.
+ */
 typedef struct GLVertex {
-    V3 normal;
-    V4 coord;
-    V4 tex_coord;
-    V4 color;
-
-    /* computed values */
-    V4 ec;           /* eye coordinates */
-    V4 pc;           /* coordinates in the normalized volume */
     ZBufferPoint zp; /* GLinteger coordinates for the rasterization */
+    V4 pc;           /* coordinates in the normalized volume */
     GLint clip_code; /* clip code */
-    GLint edge_flag;
+    GLubyte edge_flag;
+#if TGL_HAS(LAZY_LIGHTING)
+    GLubyte shaded; /* color and zp.r/g/b are lit */
+#endif
+
+    V4 color;
+    V4 tex_coord;
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    V3X normal;
+    V3X ec;
+#else
+    V3 normal; /* eye coordinates of the normal, for lighting */
+    V3 ec;     /* eye coordinates, for lighting */
+#endif
 } GLVertex;
 
+extern char TGL_BUILDT_GLVertex_hot[1 - 2 * (offsetof(GLVertex, color) > 64)];
+
 typedef struct GLImage {
     PIXEL pixmap[TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM];
     GLint xsize, ysize;
@@ -173,15 +288,82 @@ typedef struct GLBuffer {
     GLuint size;
 } GLBuffer;
 
+/* occlusion queries */
+#define MAX_QUERIES 1024
+typedef struct GLQuery {
+    GLubyte used;
+    GLuint result;
+} GLQuery;
+
 /* shared state */
 typedef struct GLSharedState {
+    /*
+     * The display lists, in a hash table of their names with open addressing,
+     * of list_slots entries, twice the number of lists at least. glGenLists
+     * gives the names from list_next on.
+     */
     GLList **lists;
+    GLuint list_slots, list_count, list_next;
     GLTexture **texture_hash_table;
     GLBuffer **buffers;
 } GLSharedState;
 
+/*
+ * Batched triangle setup; the tile bins defer the triangles already, and draw
+ * each of them once per band they cover.
+ */
+#define GL_BATCHED_SETUP \
+    (TGL_HAS(BATCHED_SETUP) && !TGL_HAS(MULTITHREADED_TILED_RASTER))
+
+/* The batches of vertices are transformed in floating point only. */
+#define GL_BULK_TRANSFORM \
+    (TGL_HAS(BULK_TRANSFORM) && !TGL_HAS(FIXED_POINT_GEOMETRY))
+
+#if TGL_HAS(LOCKED_ARRAYS)
+/*
+ * Everything the vertex of an array element depends on, besides the element
+ * itself. The vertices kept for the locked arrays stay valid while it does
+ * not change.
+ */
+typedef struct GLArrayState {
+    GLuint matrix_gen, light_gen;
+    GLint client_states, lighting_enabled, normalize_enabled;
+    GLint color_material_enabled, texture_2d_enabled, apply_texture_matrix;
+    GLint xmin, ymin, xsize, ysize;
+    V4 color, normal, tex_coord;
+    GLint edge_flag;
+    GLfloat *vertex_array, *normal_array, *color_array, *texcoord_array;
+    GLint vertex_array_size, vertex_array_stride, normal_array_stride;
+    GLint color_array_size, color_array_stride;
+    GLint texcoord_array_size, texcoord_array_stride;
+} GLArrayState;
+#endif
+
 struct GLContext;
 
+/*
+ * What glVertex, glColor, glNormal and glTexCoord call: the vertex code
+ * directly, or gl_add_op() while a list is compiled (see api.c).
+ */
+typedef struct GLDispatch {
+    void (*vertex)(struct GLContext *c,
+                   GLfloat x,
+                   GLfloat y,
+                   GLfloat z,
+                   GLfloat w);
+    void (*color)(struct GLContext *c,
+                  GLfloat r,
+                  GLfloat g,
+                  GLfloat b,
+                  GLfloat a);
+    void (*normal)(struct GLContext *c, GLfloat x, GLfloat y, GLfloat z);
+    void (*tex_coord)(struct GLContext *c,
+                      GLfloat s,
+                      GLfloat t,
+                      GLfloat r,
+                      GLfloat q);
+} GLDispatch;
+
 typedef void (*gl_draw_triangle_func)(GLVertex *p0, GLVertex *p1, GLVertex *p2);
 
 /* display context */
@@ -192,11 +374,24 @@ typedef struct GLContext {
     /* viewport */
     GLViewport viewport;
     GLMaterial materials[2];
-    GLVertex vertex[POLYGON_MAX_VERTEX];
+    GLVertex vertex[GL_VERTEX_RING];
 
     M4 matrix_model_view_inv;
     M4 matrix_model_projection;
     V4 ambient_light_model;
+#if TGL_HAS(BATCHED_LIGHTING)
+    /* emission + ambient * ambient_light_model, of the front material */
+    V3 light_model_color;
+#endif
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+    /* the matrices and the color read for every vertex, in fixed point */
+    struct {
+        GLfixed model_projection[16];
+        GLfixed model_view[12];
+        GLfixed model_view_inv[12];
+        GLfixed light_model_color[3];
+    } fx;
+#endif
     V4 clear_color;
     V4 current_color;
     V4 current_normal;
@@ -209,7 +404,6 @@ typedef struct GLContext {
     ZBuffer *zb;
     GLLight *first_light;
     GLTexture *current_texture;
-    GLParamBuffer *current_op_buffer;
     M4 *matrix_stack[3];
     M4 *matrix_stack_ptr[3];
     gl_draw_triangle_func draw_triangle_front, draw_triangle_back;
@@ -235,6 +429,9 @@ typedef struct GLContext {
     GLint color_material_enabled;
     GLint current_color_material_mode;
     GLint current_color_material_type;
+#if TGL_HAS(LAZY_LIGHTING)
+    V4 color_material; /* the color the material was last given */
+#endif
 
     /* textures */
 
@@ -242,9 +439,10 @@ typedef struct GLContext {
 
     /* current list */
 
-    GLint current_op_buffer_index;
     GLint exec_flag, compile_flag, print_flag;
+    GLList *compile_list;
     GLuint listbase;
+    const GLDispatch *dispatch;
     /* matrix */
 
     GLint matrix_mode;
@@ -252,6 +450,7 @@ typedef struct GLContext {
     GLint matrix_stack_depth_max[3];
 
     GLint matrix_model_projection_updated;
+    GLint matrix_model_view_inv_updated;
     GLint matrix_model_projection_no_w_transform;
     GLint apply_texture_matrix;
 
@@ -298,6 +497,8 @@ typedef struct GLContext {
     GLint in_begin;
     GLint begin_type;
     GLint vertex_n, vertex_cnt;
+    /* c->vertex in the order of the primitive, rotated rather than copied */
+    GLVertex *vertex_ring[GL_VERTEX_RING];
 
     /* opengl 1.1 arrays  */
 
@@ -310,6 +511,21 @@ typedef struct GLContext {
     GLint texcoord_array_size;
     GLint texcoord_array_stride;
     GLint client_states;
+#if TGL_HAS(BOUNDS_CULLING)
+    /* glVertexBoundsTGL(), until the next glVertexPointer */
+    GLint vertex_array_bounded;
+    V3 vertex_array_min, vertex_array_max;
+#endif
+#if TGL_HAS(LOCKED_ARRAYS)
+    /* glLockArraysEXT(): the vertices of the locked elements, once valid */
+    GLint locked_first, locked_count;
+    GLVertex *locked_vertex;
+    GLubyte *locked_valid;
+    /* the state after the last draw from the locked arrays */
+    GLArrayState locked_state;
+    /* bumped by every change of the matrices, and of the lighting */
+    GLuint matrix_gen, light_gen;
+#endif
 
     /* opengl 1.1 polygon offset */
     GLfloat offset_factor;
@@ -335,11 +551,21 @@ typedef struct GLContext {
     GLTEXTSIZE textsize;
     /* buffers */
     GLint boundarraybuffer;
+    GLint boundelementbuffer;
     GLint boundvertexbuffer;
     GLint boundnormalbuffer;
     GLint boundcolorbuffer;
     GLint boundtexcoordbuffer;
     GLubyte rasterposvalid;
+    /* occlusion queries: name of the active one, or 0 */
+    GLQuery queries[MAX_QUERIES];
+    GLuint current_query;
+#if GL_BATCHED_SETUP
+    /* filled triangles of the current glBegin/glEnd, drawn at glEnd or when
+       the batch is full, when batch_triangles is set by glBegin */
+    ZBufferTriangles triangles;
+    GLubyte batch_triangles;
+#endif
 #if TGL_HAS(ERROR_CHECK)
     GLenum error_flag;
 #endif
@@ -351,7 +577,15 @@ extern GLContext *gl_get_context(void);
 extern void (*op_table_func[])(GLParam *);
 extern GLint op_table_size[];
 extern void gl_compile_op(GLParam *p);
+extern void gl_free_list(GLList *l);
+extern GLList *gl_find_list(GLuint list);
+extern GLint gl_insert_list(GLList *l);
+extern void gl_put_op_code(GLParam *q);
+#if TGL_HAS(LIST_FILES)
+extern void gl_release_list_file(GLListFile *f);
+#endif
 extern void gl_add_op(GLParam *p);
+void gl_set_dispatch(GLContext *c);
 
 /* select.c */
 void gl_add_select(GLuint zmin, GLuint zmax);
@@ -366,6 +600,9 @@ void gl_add_feedback(GLfloat token,
 #define CLIP_EPSILON (1E-5)
 
 extern GLint gl_clipcode(GLfloat x, GLfloat y, GLfloat z, GLfloat w1);
+#if TGL_HAS(BOUNDS_CULLING)
+GLint gl_box_outside(GLContext *c, const V3 *min, const V3 *max);
+#endif
 
 #define CLIP_XMIN (1 << 0)
 #define CLIP_XMAX (1 << 1)
@@ -396,8 +633,95 @@ void gl_draw_triangle_line(GLVertex *p0, GLVertex *p1, GLVertex *p2);
 void gl_draw_triangle_fill(GLVertex *p0, GLVertex *p1, GLVertex *p2);
 void gl_draw_triangle_select(GLVertex *p0, GLVertex *p1, GLVertex *p2);
 void gl_draw_triangle_feedback(GLVertex *p0, GLVertex *p1, GLVertex *p2);
+#if GL_BATCHED_SETUP
+void gl_flush_triangles(GLContext *c);
+#endif
+/* vertex.c */
+void gl_eval_vertex(GLContext *c, GLVertex *v, const V4 *coord);
+void gl_vertex4f(GLContext *c, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+void gl_color4f(GLContext *c, GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+void gl_normal3f(GLContext *c, GLfloat x, GLfloat y, GLfloat z);
+void gl_tex_coord4f(GLContext *c, GLfloat s, GLfloat t, GLfloat r, GLfloat q);
+void gl_vertex_assemble(GLContext *c);
+void gl_color_material(GLContext *c, const V4 *col);
+#if TGL_HAS(LAZY_LIGHTING)
+void gl_light_vertices(GLContext *c, GLVertex **v, GLint n);
+void gl_light_pending(GLContext *c);
+#endif
+
+#if TGL_HAS(LAZY_LIGHTING)
+/*
+ * With GL_COLOR_MATERIAL, glColor within glBegin/glEnd leaves the material as
+ * it is, and the vertices given the color take it to the material when they
+ * are lit. Whether the material is to be given col.
+ */
+static inline GLint gl_color_material_stale(const GLContext *c, const V4 *col)
+{
+    return c->color_material_enabled &&
+           (col->X != c->color_material.X || col->Y != c->color_material.Y ||
+            col->Z != c->color_material.Z || col->W != c->color_material.W);
+}
+
+static inline void gl_color_material_update(GLContext *c, const V4 *col)
+{
+    if (gl_color_material_stale(c, col))
+        gl_color_material(c, col);
+}
+#endif
+
+/* Light v, if lighting was left for the primitives drawing it to do. */
+static inline void gl_light_lazy(GLContext *c, GLVertex *v)
+{
+#if TGL_HAS(LAZY_LIGHTING)
+    if (!v->shaded)
+        gl_light_vertices(c, &v, 1);
+#else
+    (void) c;
+    (void) v;
+#endif
+}
+
+/* The same for the three vertices of a triangle, lit together. */
+static inline void gl_light_lazy_triangle(GLContext *c,
+                                          GLVertex *p0,
+                                          GLVertex *p1,
+                                          GLVertex *p2)
+{
+#if TGL_HAS(LAZY_LIGHTING)
+    if (!(p0->shaded & p1->shaded & p2->shaded)) {
+        GLVertex *v[3] = {p0, p1, p2};
+        gl_light_vertices(c, v, 3);
+    }
+#else
+    (void) c;
+    (void) p0;
+    (void) p1;
+    (void) p2;
+#endif
+}
+#if GL_BULK_TRANSFORM
+#define GL_VERTEX_BATCH 64
+/*
+ * The positions of a run of vertices from the arrays, as structures of arrays:
+ * object, eye (with lighting only), clip and window coordinates.
+ */
+typedef struct GLVertexBatch {
+    GLfloat x[GL_VERTEX_BATCH], y[GL_VERTEX_BATCH], z[GL_VERTEX_BATCH];
+    GLfloat ex[GL_VERTEX_BATCH], ey[GL_VERTEX_BATCH], ez[GL_VERTEX_BATCH];
+    GLfloat ew[GL_VERTEX_BATCH];
+    GLfloat px[GL_VERTEX_BATCH], py[GL_VERTEX_BATCH];
+    GLfloat pz[GL_VERTEX_BATCH], pw[GL_VERTEX_BATCH];
+    GLint clip_code[GL_VERTEX_BATCH];
+    GLint wx[GL_VERTEX_BATCH], wy[GL_VERTEX_BATCH], wz[GL_VERTEX_BATCH];
+} GLVertexBatch;
+void gl_transform_vertices(GLContext *c, GLVertexBatch *b, GLint n);
+void gl_add_vertex(GLContext *c, const GLVertexBatch *b, GLint i);
+#endif
 /* matrix.c */
 void gl_print_matrix(const GLfloat *m);
+void gl_eval_model_projection(GLContext *c);
+void gl_eval_model_view_inv(GLContext *c);
+void gl_op_matrix(M4 *m, const GLParam *p);
 /*
 void glopLoadIdentity(GLParam *p);
 void glopTranslate(GLParam *p);*/
@@ -405,6 +729,12 @@ void glopTranslate(GLParam *p);*/
 /* light.c */
 void gl_enable_disable_light(GLint light, GLint v);
 void gl_shade_vertex(GLVertex *v);
+/* Number of vertices lit at a time. */
+#define GL_LIGHT_BATCH 8
+#if TGL_HAS(BATCHED_LIGHTING)
+void gl_shade_vertices(GLContext *c, GLVertex **v, GLint n);
+void gl_init_lighting(GLContext *c);
+#endif
 
 void glInitTextures();
 void glEndTextures();
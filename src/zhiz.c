@@ -0,0 +1,272 @@
+/*
+ * Hierarchical Z.
+ *
+ * For every block of TGL_HIZ_BLOCK x TGL_HIZ_BLOCK pixels, hzbuf holds a
+ * lower bound of the depth values of the block. A fragment passes the depth
+ * test when its z is greater than or equal to the depth buffer, so a triangle
+ * whose largest z is below the bound of every block it covers cannot draw a
+ * single pixel, and is discarded before it is rasterized.
+ *
+ * Keeping the bound exact on every depth write would cost more than it saves,
+ * so writers only mark the blocks they touch:
+ *   - with the depth test on, depth values can only grow: the bound stays
+ *     valid, but may be loose;
+ *   - with the depth test off, they can shrink: the bound drops to 0.
+ * Either way the block is flagged stale, and its bound is recomputed from the
+ * depth buffer the next time it could decide whether a triangle is hidden.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msghandling.h"
+#include "zbuffer.h"
+
+#if TGL_HAS(HIERARCHICAL_Z)
+
+#define TGL_HIZ_BLOCK (1 << TGL_HIZ_BLOCK_POW2)
+
+#if TGL_HAS(MULTITHREADED_TILED_RASTER) && \
+    TGL_TILE_HEIGHT_POW2 < TGL_HIZ_BLOCK_POW2
+#error "A raster band must hold whole hierarchical Z blocks"
+#endif
+
+/* If the blocks cannot be allocated, triangles are never discarded. */
+void ZB_initHiZ(ZBuffer *zb)
+{
+    GLint n;
+
+    zb->hzxsize = (zb->xsize + TGL_HIZ_BLOCK - 1) >> TGL_HIZ_BLOCK_POW2;
+    zb->hzysize = (zb->ysize + TGL_HIZ_BLOCK - 1) >> TGL_HIZ_BLOCK_POW2;
+    n = zb->hzxsize * zb->hzysize;
+    /* the depth buffer is not initialized yet: no bound is known */
+    zb->hzbuf = gl_zalloc(n * sizeof(GLushort));
+    zb->hzstale = gl_malloc(n);
+    if (zb->hzbuf == NULL || zb->hzstale == NULL) {
+        gl_free(zb->hzbuf);
+        gl_free(zb->hzstale);
+        zb->hzbuf = NULL;
+        zb->hzstale = NULL;
+        return;
+    }
+    memset(zb->hzstale, 1, n);
+}
+
+void ZB_closeHiZ(ZBuffer *zb)
+{
+    gl_free(zb->hzbuf);
+    gl_free(zb->hzstale);
+    zb->hzbuf = NULL;
+    zb->hzstale = NULL;
+}
+
+/* The whole depth buffer was set to z. */
+void ZB_clearHiZ(ZBuffer *zb, GLushort z)
+{
+    GLint i, n = zb->hzxsize * zb->hzysize;
+
+    if (zb->hzbuf == NULL)
+        return;
+    for (i = 0; i < n; i++)
+        zb->hzbuf[i] = z;
+    memset(zb->hzstale, 0, n);
+}
+
+/*
+ * Depth values of the rectangle (inclusive, in pixels) were written. lowered
+ * is set when they may have decreased, i.e. without the depth test.
+ */
+void ZB_markHiZ(ZBuffer *zb,
+                GLint xmin,
+                GLint ymin,
+                GLint xmax,
+                GLint ymax,
+                GLint lowered)
+{
+    GLint bx, by;
+
+    if (zb->hzbuf == NULL)
+        return;
+    if (xmin < 0)
+        xmin = 0;
+    if (ymin < 0)
+        ymin = 0;
+    if (xmax >= zb->xsize)
+        xmax = zb->xsize - 1;
+    if (ymax >= zb->ysize)
+        ymax = zb->ysize - 1;
+    if (xmin > xmax || ymin > ymax)
+        return;
+
+    for (by = ymin >> TGL_HIZ_BLOCK_POW2; by <= (ymax >> TGL_HIZ_BLOCK_POW2);
+         by++) {
+        GLint i = by * zb->hzxsize + (xmin >> TGL_HIZ_BLOCK_POW2);
+        for (bx = xmin >> TGL_HIZ_BLOCK_POW2;
+             bx <= (xmax >> TGL_HIZ_BLOCK_POW2); bx++, i++) {
+            if (lowered)
+                zb->hzbuf[i] = 0;
+            zb->hzstale[i] = 1;
+        }
+    }
+}
+
+/* Recompute the exact bound of block (bx, by) from the depth buffer. */
+static void ZB_refreshHiZ(ZBuffer *zb, GLint bx, GLint by)
+{
+    GLint x0 = bx << TGL_HIZ_BLOCK_POW2, y0 = by << TGL_HIZ_BLOCK_POW2;
+    GLint x1 = x0 + TGL_HIZ_BLOCK, y1 = y0 + TGL_HIZ_BLOCK;
+    GLint x, y;
+    GLushort zmin = 0xffff;
+
+    if (x1 > zb->xsize)
+        x1 = zb->xsize;
+    if (y1 > zb->ysize)
+        y1 = zb->ysize;
+    for (y = y0; y < y1; y++) {
+        GLushort *pz = zb->zbuf + y * zb->xsize;
+        for (x = x0; x < x1; x++)
+            if (pz[x] < zmin)
+                zmin = pz[x];
+    }
+    zb->hzbuf[by * zb->hzxsize + bx] = zmin;
+    zb->hzstale[by * zb->hzxsize + bx] = 0;
+}
+
+/*
+ * Returns 1 when no pixel of the rectangle (inclusive, in pixels, within the
+ * buffer) with a depth up to zmax can pass the depth test.
+ */
+static GLint ZB_occludedHiZ(ZBuffer *zb,
+                            GLint xmin,
+                            GLint ymin,
+                            GLint xmax,
+                            GLint ymax,
+                            GLint zmax)
+{
+    GLint bx, by;
+
+    for (by = ymin >> TGL_HIZ_BLOCK_POW2; by <= (ymax >> TGL_HIZ_BLOCK_POW2);
+         by++) {
+        GLint i = by * zb->hzxsize + (xmin >> TGL_HIZ_BLOCK_POW2);
+        for (bx = xmin >> TGL_HIZ_BLOCK_POW2;
+             bx <= (xmax >> TGL_HIZ_BLOCK_POW2); bx++, i++) {
+            if (zb->hzbuf[i] > zmax)
+                continue;
+            if (!zb->hzstale[i])
+                return 0;
+            ZB_refreshHiZ(zb, bx, by);
+            if (zb->hzbuf[i] <= zmax)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+void ZB_fillTriangleHiZ(ZBuffer *zb,
+                        ZB_fillTriangleFunc func,
+                        GLint depth_test,
+                        GLint depth_write,
+                        ZBufferPoint *p0,
+                        ZBufferPoint *p1,
+                        ZBufferPoint *p2)
+{
+    GLint xmin, xmax, ymin, ymax;
+
+    if (zb->hzbuf == NULL) {
+        func(zb, p0, p1, p2);
+        return;
+    }
+
+    /* the rasterizers may reach one pixel past the vertices */
+    xmin = p0->x;
+    xmax = p0->x;
+    ymin = p0->y;
+    ymax = p0->y;
+    if (p1->x < xmin)
+        xmin = p1->x;
+    if (p1->x > xmax)
+        xmax = p1->x;
+    if (p2->x < xmin)
+        xmin = p2->x;
+    if (p2->x > xmax)
+        xmax = p2->x;
+    if (p1->y < ymin)
+        ymin = p1->y;
+    if (p1->y > ymax)
+        ymax = p1->y;
+    if (p2->y < ymin)
+        ymin = p2->y;
+    if (p2->y > ymax)
+        ymax = p2->y;
+    xmin--;
+    ymin--;
+    xmax++;
+    ymax++;
+    if (xmin < 0)
+        xmin = 0;
+    if (xmax >= zb->xsize)
+        xmax = zb->xsize - 1;
+#if ZB_CLIP_ROWS
+    if (ymin < zb->clip_ymin)
+        ymin = zb->clip_ymin;
+    if (ymax > zb->clip_ymax)
+        ymax = zb->clip_ymax;
+#else
+    if (ymin < 0)
+        ymin = 0;
+    if (ymax >= zb->ysize)
+        ymax = zb->ysize - 1;
+#endif
+    if (xmin > xmax || ymin > ymax)
+        return;
+
+    /* not worth it below the size of a block */
+    if (depth_test && (xmax - xmin + 1) * (ymax - ymin + 1) >=
+                          TGL_HIZ_BLOCK * TGL_HIZ_BLOCK) {
+        GLint zmin, zmax, margin;
+        GLfloat fdx1 = p1->x - p0->x, fdy1 = p1->y - p0->y;
+        GLfloat fdx2 = p2->x - p0->x, fdy2 = p2->y - p0->y;
+        GLfloat fz = fdx1 * fdy2 - fdx2 * fdy1;
+
+        zmin = p0->z;
+        zmax = p0->z;
+        if (p1->z < zmin)
+            zmin = p1->z;
+        if (p1->z > zmax)
+            zmax = p1->z;
+        if (p2->z < zmin)
+            zmin = p2->z;
+        if (p2->z > zmax)
+            zmax = p2->z;
+
+        /*
+         * Pixels on the edges are up to a pixel outside of the triangle, where
+         * the plane of z goes beyond the vertices: allow for two steps of its
+         * gradient. Slivers have huge gradients, and are simply drawn.
+         */
+        if (fz != 0) {
+            GLfloat d1 = p1->z - p0->z, d2 = p2->z - p0->z;
+            GLfloat dzdx = (fdy2 * d1 - fdy1 * d2) / fz;
+            GLfloat dzdy = (fdx1 * d2 - fdx2 * d1) / fz;
+            GLfloat m = 2 * (fabsf(dzdx) + fabsf(dzdy));
+            margin = m < (GLfloat) (1 << 30) ? (GLint) m : (1 << 30);
+        } else {
+            margin = 0;
+        }
+        margin += 2 << ZB_POINT_Z_FRAC_BITS;
+
+        /* z is unsigned once shifted: below 0 it would pass any test */
+        if (zmin - margin >= 0 && zmax < (1 << 30) - margin &&
+            ZB_occludedHiZ(zb, xmin, ymin, xmax, ymax,
+                           (zmax + margin) >> ZB_POINT_Z_FRAC_BITS))
+            return;
+    }
+
+    func(zb, p0, p1, p2);
+
+    if (depth_write)
+        ZB_markHiZ(zb, xmin, ymin, xmax, ymax, !depth_test);
+}
+
+#endif /* TGL_HAS(HIERARCHICAL_Z) */
@@ -4,7 +4,7 @@
 #define ZCMP(z, zpix) (!(zbdt) || z >= (zpix))
 
 /* Dirty rectangle helper macros */
-#if TGL_HAS(DIRTY_RECTANGLE)
+#if TGL_HAS(DIRTY_RECTANGLE) || TGL_HAS(HIERARCHICAL_Z)
 #define TGL_MIN2(a, b) (((a) < (b)) ? (a) : (b))
 #define TGL_MAX2(a, b) (((a) > (b)) ? (a) : (b))
 #endif
@@ -19,6 +19,7 @@ void ZB_plot(ZBuffer *zb, ZBufferPoint *p)
     GLubyte zbdt = zb->depth_test;
     GLfloat zbps = zb->pointsize;
 
+    ZB_flushTriangles(zb);
 #if TGL_HAS(DIRTY_RECTANGLE)
     /* Mark dirty region for point (may have point size) */
     if (zbps <= 1.0f) {
@@ -31,6 +32,13 @@ void ZB_plot(ZBuffer *zb, ZBufferPoint *p)
         GLint ymax = (GLint) ((GLfloat) p->y + hzbps);
         ZB_markDirty(zb, xmin, ymin, xmax, ymax);
     }
+#endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    if (zbdw) {
+        GLint hzbps = (GLint) (zbps / 2.0f) + 1;
+        ZB_markHiZ(zb, p->x - hzbps, p->y - hzbps, p->x + hzbps, p->y + hzbps,
+                   !zbdt);
+    }
 #endif
     TGL_BLEND_VARS
     zz = p->z >> ZB_POINT_Z_FRAC_BITS;
@@ -128,6 +136,7 @@ void ZB_line_z(ZBuffer *zb, ZBufferPoint *p1, ZBufferPoint *p2)
 {
     GLint color1, color2;
 
+    ZB_flushTriangles(zb);
 #if TGL_HAS(DIRTY_RECTANGLE)
     /* Mark dirty region for line bounding box */
     GLint xmin = TGL_MIN2(p1->x, p2->x);
@@ -136,6 +145,12 @@ void ZB_line_z(ZBuffer *zb, ZBufferPoint *p1, ZBufferPoint *p2)
     GLint ymax = TGL_MAX2(p1->y, p2->y);
     ZB_markDirty(zb, xmin, ymin, xmax, ymax);
 #endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    if (zb->depth_write)
+        ZB_markHiZ(zb, TGL_MIN2(p1->x, p2->x), TGL_MIN2(p1->y, p2->y),
+                   TGL_MAX2(p1->x, p2->x), TGL_MAX2(p1->y, p2->y),
+                   !zb->depth_test);
+#endif
 
     color1 = RGB_TO_PIXEL(p1->r, p1->g, p1->b);
     color2 = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
@@ -152,6 +167,7 @@ void ZB_line(ZBuffer *zb, ZBufferPoint *p1, ZBufferPoint *p2)
 {
     GLint color1, color2;
 
+    ZB_flushTriangles(zb);
 #if TGL_HAS(DIRTY_RECTANGLE)
     /* Mark dirty region for line bounding box */
     GLint xmin = TGL_MIN2(p1->x, p2->x);
@@ -2,6 +2,13 @@
 #include <string.h>
 
 #include "zmath.h"
+#include "zsimd.h"
+
+#if TGL_HAS(SIMD_MATRIX) && defined(ZF_SIMD)
+#define GL_SIMD_MATRIX 1
+#else
+#define GL_SIMD_MATRIX 0
+#endif
 
 void gl_M4_Id(M4 *a)
 {
@@ -25,8 +32,33 @@ GLint gl_M4_IsId(M4 *a)
     return (memcmp(a->m, c.m, 16 * sizeof(GLfloat)) == 0);
 }
 
+#if GL_SIMD_MATRIX
+/*
+ * c = a * b: each row of c is the sum of the rows of b, weighted by the row of
+ * a, added in the same order as the loops below. c may be a.
+ */
+static inline void gl_M4_Mul_simd(GLfloat *c,
+                                  const GLfloat *a,
+                                  const GLfloat *b)
+{
+    zf_vec b0 = ZF_LOAD(b), b1 = ZF_LOAD(b + 4);
+    zf_vec b2 = ZF_LOAD(b + 8), b3 = ZF_LOAD(b + 12);
+
+    for (GLint i = 0; i < 16; i += 4) {
+        zf_vec s = ZF_MUL(ZF_SET1(a[i]), b0);
+        s = ZF_ADD(s, ZF_MUL(ZF_SET1(a[i + 1]), b1));
+        s = ZF_ADD(s, ZF_MUL(ZF_SET1(a[i + 2]), b2));
+        s = ZF_ADD(s, ZF_MUL(ZF_SET1(a[i + 3]), b3));
+        ZF_STORE(c + i, s);
+    }
+}
+#endif
+
 void gl_M4_Mul(M4 *c, M4 *a, M4 *b)
 {
+#if GL_SIMD_MATRIX
+    gl_M4_Mul_simd(&c->m[0][0], &a->m[0][0], &b->m[0][0]);
+#else
 #ifdef _OPENMP
 #pragma omp simd
 #endif
@@ -37,11 +69,15 @@ void gl_M4_Mul(M4 *c, M4 *a, M4 *b)
                 s += a->m[i][k] * b->m[k][j];
             c->m[i][j] = s;
         }
+#endif
 }
 
 /* c = c * a */
 void gl_M4_MulLeft(M4 *c, M4 *b)
 {
+#if GL_SIMD_MATRIX
+    gl_M4_Mul_simd(&c->m[0][0], &c->m[0][0], &b->m[0][0]);
+#else
     M4 a = *c;
 
 #ifdef _OPENMP
@@ -54,6 +90,7 @@ void gl_M4_MulLeft(M4 *c, M4 *b)
                 s += a.m[i][k] * b->m[k][j];
             c->m[i][j] = s;
         }
+#endif
 }
 
 void gl_M4_Move(M4 *a, M4 *b)
@@ -85,6 +122,15 @@ void gl_MulM3V3(V3 *a, M4 *b, V3 *c)
 
 void gl_M4_MulV4(V4 *a, M4 *b, V4 *c)
 {
+#if GL_SIMD_MATRIX
+    /* the products of each row, transposed to be summed lane by lane */
+    zf_vec v = ZF_LOAD(c->v);
+    zf_vec p0 = ZF_MUL(ZF_LOAD(b->m[0]), v), p1 = ZF_MUL(ZF_LOAD(b->m[1]), v);
+    zf_vec p2 = ZF_MUL(ZF_LOAD(b->m[2]), v), p3 = ZF_MUL(ZF_LOAD(b->m[3]), v);
+
+    ZF_TRANSPOSE(p0, p1, p2, p3);
+    ZF_STORE(a->v, ZF_ADD(ZF_ADD(ZF_ADD(p0, p1), p2), p3));
+#else
     a->X = b->m[0][0] * c->X + b->m[0][1] * c->Y + b->m[0][2] * c->Z +
            b->m[0][3] * c->W;
     a->Y = b->m[1][0] * c->X + b->m[1][1] * c->Y + b->m[1][2] * c->Z +
@@ -93,6 +139,7 @@ void gl_M4_MulV4(V4 *a, M4 *b, V4 *c)
            b->m[2][3] * c->W;
     a->W = b->m[3][0] * c->X + b->m[3][1] * c->Y + b->m[3][2] * c->Z +
            b->m[3][3] * c->W;
+#endif
 }
 
 /* transposition of a 4x4 matrix */
@@ -206,13 +253,64 @@ GLint Matrix_Inv(GLfloat *r, GLfloat *m, GLint n)
     return 0;
 }
 
+#if GL_SIMD_MATRIX
+/* Matrix_Inv() for n = 4, with the operations on whole rows vectorized. */
+static GLint gl_M4_Inv_simd(GLfloat *r, GLfloat *m)
+{
+    GLfloat max;
+
+    for (GLint i = 0; i < 16; i++)
+        r[i] = (i % 5) == 0;
+    for (GLint j = 0; j < 4; j++) {
+        zf_vec mj, rj;
+        GLint k = j;
+
+        max = m[j * 4 + j];
+        for (GLint i = j + 1; i < 4; i++)
+            if (fabs(m[i * 4 + j]) > fabs(max)) {
+                k = i;
+                max = m[i * 4 + j];
+            }
+
+        if (max == 0)
+            return 1;
+
+        if (k != j) {
+            zf_vec mk = ZF_LOAD(m + k * 4), rk = ZF_LOAD(r + k * 4);
+            ZF_STORE(m + k * 4, ZF_LOAD(m + j * 4));
+            ZF_STORE(r + k * 4, ZF_LOAD(r + j * 4));
+            ZF_STORE(m + j * 4, mk);
+            ZF_STORE(r + j * 4, rk);
+        }
+
+        max = 1 / max;
+        mj = ZF_MUL(ZF_LOAD(m + j * 4), ZF_SET1(max));
+        rj = ZF_MUL(ZF_LOAD(r + j * 4), ZF_SET1(max));
+        ZF_STORE(m + j * 4, mj);
+        ZF_STORE(r + j * 4, rj);
+        for (GLint l = 0; l < 4; l++)
+            if (l != j) {
+                zf_vec t = ZF_SET1(m[l * 4 + j]);
+                ZF_STORE(m + l * 4, ZF_SUB(ZF_LOAD(m + l * 4), ZF_MUL(mj, t)));
+                ZF_STORE(r + l * 4, ZF_SUB(ZF_LOAD(r + l * 4), ZF_MUL(rj, t)));
+            }
+    }
+
+    return 0;
+}
+#endif
+
 /* inversion of a 4x4 matrix */
 
 void gl_M4_Inv(M4 *a, M4 *b)
 {
     M4 tmp;
     memcpy(&tmp, b, sizeof(M4));
+#if GL_SIMD_MATRIX
+    gl_M4_Inv_simd(&a->m[0][0], &tmp.m[0][0]);
+#else
     Matrix_Inv(&a->m[0][0], &tmp.m[0][0], 4);
+#endif
 }
 
 void gl_M4_Rotate(M4 *a, GLfloat t, GLint u)
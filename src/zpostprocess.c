@@ -7,6 +7,7 @@ void glPostProcess(
 {
     GLint i, j;
     GLContext *c = gl_get_context();
+    ZB_flushTriangles(c->zb);
 #if TGL_HAS(DIRTY_RECTANGLE)
     /* Post-processing modifies the entire framebuffer */
     ZB_markFullDirty(c->zb);
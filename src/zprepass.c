@@ -0,0 +1,134 @@
+/*
+ * Depth prepass.
+ *
+ * With glEnable(GL_DEPTH_PREPASS_TGL), the opaque triangles drawn with depth
+ * test and depth write are recorded (their screen points, the rasterizer
+ * variants that draw them and their texture) instead of being drawn. When
+ * they are flushed, a first pass writes the depth of every one of them, and
+ * nothing else. The depth buffer then holds the depth of the nearest
+ * triangle, and a second pass shades them with the variants testing the
+ * depth without writing it: z >= zbuf only passes where z == zbuf. Hidden
+ * pixels are never textured nor lit, and each visible one is shaded by the
+ * triangles at its depth, in submission order, so the last of them wins just
+ * like when they are drawn one by one.
+ *
+ * Both passes draw with variants from the same dispatch table, which compute
+ * the same depth for every pixel.
+ */
+
+#include <stdlib.h>
+
+#include "msghandling.h"
+#include "zbuffer.h"
+
+#if TGL_HAS(DEPTH_PREPASS)
+
+typedef struct {
+    ZB_fillTriangleFunc depth, func;
+    PIXEL *texture;
+    ZBufferPoint p[3];
+} ZBPrepassTriangle;
+
+struct ZBPrepass {
+    GLint nb_tris;
+    ZBPrepassTriangle tris[TGL_PREPASS_MAX_TRIANGLES];
+};
+
+void ZB_closePrepass(ZBuffer *zb)
+{
+    gl_free(zb->prepass);
+    zb->prepass = NULL;
+}
+
+/* Draw with depth test, and depth write dw, the way clip.c does. */
+static void ZB_drawPrepass(ZBuffer *zb,
+                           ZB_fillTriangleFunc func,
+                           GLint dw,
+                           ZBufferPoint *p0,
+                           ZBufferPoint *p1,
+                           ZBufferPoint *p2)
+{
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+    (void) dw;
+    ZB_binTriangle(zb, func, p0, p1, p2);
+#elif TGL_HAS(HIERARCHICAL_Z)
+    ZB_fillTriangleHiZ(zb, func, 1, dw, p0, p1, p2);
+#else
+    (void) dw;
+    func(zb, p0, p1, p2);
+#endif
+}
+
+/* If the triangles cannot be recorded, both passes are drawn right away. */
+void ZB_prepassTriangle(ZBuffer *zb,
+                        ZB_fillTriangleFunc depth,
+                        ZB_fillTriangleFunc func,
+                        ZBufferPoint *p0,
+                        ZBufferPoint *p1,
+                        ZBufferPoint *p2)
+{
+    struct ZBPrepass *pp = zb->prepass;
+    ZBPrepassTriangle *t;
+
+    if (pp == NULL) {
+        pp = zb->prepass = gl_malloc(sizeof(struct ZBPrepass));
+        if (pp == NULL) {
+            GLint depth_write = zb->depth_write;
+            ZBufferPoint q0 = *p0, q1 = *p1, q2 = *p2;
+            ZB_drawPrepass(zb, depth, 1, &q0, &q1, &q2);
+            zb->depth_write = 0;
+            ZB_drawPrepass(zb, func, 0, p0, p1, p2);
+            zb->depth_write = depth_write;
+            return;
+        }
+        pp->nb_tris = 0;
+    }
+
+    if (pp->nb_tris == TGL_PREPASS_MAX_TRIANGLES)
+        ZB_flushPrepass(zb);
+
+    t = &pp->tris[pp->nb_tris++];
+    t->depth = depth;
+    t->func = func;
+    t->texture = zb->current_texture;
+    t->p[0] = *p0;
+    t->p[1] = *p1;
+    t->p[2] = *p2;
+}
+
+void ZB_flushPrepass(ZBuffer *zb)
+{
+    struct ZBPrepass *pp = zb->prepass;
+    /* the tile bins record this state along with the triangles */
+    PIXEL *texture = zb->current_texture;
+    GLint depth_test = zb->depth_test, depth_write = zb->depth_write;
+    GLint i, n;
+
+    if (pp == NULL || pp->nb_tris == 0)
+        return;
+    n = pp->nb_tris;
+    pp->nb_tris = 0;
+
+    zb->depth_test = 1;
+    zb->depth_write = 1;
+    for (i = 0; i < n; i++) {
+        ZBPrepassTriangle *t = &pp->tris[i];
+        /* the rasterizers scribble on their points */
+        ZBufferPoint p0 = t->p[0], p1 = t->p[1], p2 = t->p[2];
+        ZB_drawPrepass(zb, t->depth, 1, &p0, &p1, &p2);
+    }
+
+    zb->depth_write = 0;
+    for (i = 0; i < n; i++) {
+        ZBPrepassTriangle *t = &pp->tris[i];
+        ZBufferPoint p0 = t->p[0], p1 = t->p[1], p2 = t->p[2];
+        zb->current_texture = t->texture;
+        ZB_drawPrepass(zb, t->func, 0, &p0, &p1, &p2);
+    }
+
+    zb->current_texture = texture;
+    zb->depth_test = depth_test;
+    zb->depth_write = depth_write;
+}
+
+#endif /* TGL_HAS(DEPTH_PREPASS) */
@@ -3,7 +3,7 @@
 #include "zbuffer.h"
 #include "zgl.h"
 
-static void gl_vertex_transform_raster(GLVertex *v)
+static void gl_vertex_transform_raster(GLVertex *v, const V4 *coord)
 {
     GLContext *c = gl_get_context();
 
@@ -12,28 +12,28 @@ static void gl_vertex_transform_raster(GLVertex *v)
         /* NOTE: W = 1 is assumed */
         GLfloat *m = &c->matrix_model_projection.m[0][0];
 
-        v->pc.X =
-            (v->coord.X * m[0] + v->coord.Y * m[1] + v->coord.Z * m[2] + m[3]);
-        v->pc.Y =
-            (v->coord.X * m[4] + v->coord.Y * m[5] + v->coord.Z * m[6] + m[7]);
-        v->pc.Z = (v->coord.X * m[8] + v->coord.Y * m[9] + v->coord.Z * m[10] +
-                   m[11]);
+        v->pc.X = (coord->X * m[0] + coord->Y * m[1] + coord->Z * m[2] + m[3]);
+        v->pc.Y = (coord->X * m[4] + coord->Y * m[5] + coord->Z * m[6] + m[7]);
+        v->pc.Z =
+            (coord->X * m[8] + coord->Y * m[9] + coord->Z * m[10] + m[11]);
 
         if (c->matrix_model_projection_no_w_transform) {
             v->pc.W = m[15];
         } else {
-            v->pc.W = (v->coord.X * m[12] + v->coord.Y * m[13] +
-                       v->coord.Z * m[14] + m[15]);
+            v->pc.W = (coord->X * m[12] + coord->Y * m[13] + coord->Z * m[14] +
+                       m[15]);
         }
         m = &c->matrix_stack_ptr[0]->m[0][0];
-        v->ec.X =
-            (v->coord.X * m[0] + v->coord.Y * m[1] + v->coord.Z * m[2] + m[3]);
-        v->ec.Y =
-            (v->coord.X * m[4] + v->coord.Y * m[5] + v->coord.Z * m[6] + m[7]);
-        v->ec.Z = (v->coord.X * m[8] + v->coord.Y * m[9] + v->coord.Z * m[10] +
-                   m[11]);
-        v->ec.W = (v->coord.X * m[12] + v->coord.Y * m[13] +
-                   v->coord.Z * m[14] + m[15]);
+#if TGL_HAS(FIXED_POINT_GEOMETRY)
+        /* only the distance is read */
+        v->ec.v[2] = gl_fixed(coord->X * m[8] + coord->Y * m[9] +
+                              coord->Z * m[10] + m[11]);
+#else
+        v->ec.X = (coord->X * m[0] + coord->Y * m[1] + coord->Z * m[2] + m[3]);
+        v->ec.Y = (coord->X * m[4] + coord->Y * m[5] + coord->Z * m[6] + m[7]);
+        v->ec.Z =
+            (coord->X * m[8] + coord->Y * m[9] + coord->Z * m[10] + m[11]);
+#endif
     }
 
     v->clip_code = gl_clipcode(v->pc.X, v->pc.Y, v->pc.Z, v->pc.W);
@@ -53,11 +53,13 @@ void glopRasterPos(GLParam *p)
 {
     GLContext *c = gl_get_context();
     GLVertex v;
-    v.coord.X = p[1].f;
-    v.coord.Y = p[2].f;
-    v.coord.Z = p[3].f;
-    v.coord.W = p[4].f;
-    gl_vertex_transform_raster(&v);
+    V4 coord;
+    coord.X = p[1].f;
+    coord.Y = p[2].f;
+    coord.Z = p[3].f;
+    coord.W = p[4].f;
+    gl_eval_model_projection(c);
+    gl_vertex_transform_raster(&v, &coord);
     if (v.clip_code == 0) {
         {
             GLfloat winv = 1.0f / v.pc.W;
@@ -171,6 +173,8 @@ void glopDrawPixels(GLParam *p)
     if (!c->rasterposvalid)
         return;
 
+    ZB_flushTriangles(zb);
+
 #if TGL_HAS(DIRTY_RECTANGLE)
     /* Mark dirty region for the pixel rectangle being drawn */
     {
@@ -181,6 +185,24 @@ void glopDrawPixels(GLParam *p)
         ZB_markDirty(zb, xmin, ymin, xmax, ymax);
     }
 #endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    if (zbdw) {
+        GLfloat x0 = rastpos.v[0], x1 = x0 + (GLfloat) w * pzoomx;
+        GLfloat y0 = rastpos.v[1], y1 = y0 - (GLfloat) h * pzoomy;
+        if (x1 < x0) {
+            GLfloat t = x0;
+            x0 = x1;
+            x1 = t;
+        }
+        if (y1 < y0) {
+            GLfloat t = y0;
+            y0 = y1;
+            y1 = t;
+        }
+        ZB_markHiZ(zb, (GLint) x0 - 1, (GLint) y0 - 1, (GLint) x1 + 1,
+                   (GLint) y1 + 1, !zbdt);
+    }
+#endif
 
 #if TGL_HAS(ALT_RENDERMODES)
     if (c->render_mode == GL_SELECT) {
@@ -196,7 +218,7 @@ void glopDrawPixels(GLParam *p)
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-    for (sy = h; --sy;)
+    for (sy = h - 1; sy > 0; sy--)
         for (sx = w; --sx;) {
             PIXEL col = d[sy * w + sx];
             V4 rastoffset;
@@ -0,0 +1,240 @@
+/*
+ * Minimal SIMD layer: SSE2 or NEON when the compiler targets them, plain C
+ * otherwise. Only what the rasterizers and the matrix kernels need is
+ * provided.
+ */
+
+#ifndef ZSIMD_H
+#define ZSIMD_H
+
+#include "zbuffer.h"
+
+/*
+ * 4 x 32-bit integer vector, shared by the rasterizers.
+ *
+ * ZV_MOVEMASK returns the sign bits of the lanes, lane i in bit i. ZV_SELECT
+ * takes the lanes of a where m is all ones, and of b where m is zero. Shift
+ * amounts must be constants.
+ */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+#define ZV_SIMD 1
+
+typedef __m128i zv_vec;
+#define ZV_SET1(a) _mm_set1_epi32(a)
+#define ZV_RAMP(a) _mm_setr_epi32(0, (a), (a) * 2, (a) * 3)
+#define ZV_ADD(a, b) _mm_add_epi32(a, b)
+#define ZV_OR(a, b) _mm_or_si128(a, b)
+#define ZV_AND(a, b) _mm_and_si128(a, b)
+#define ZV_SRLI(a, n) _mm_srli_epi32(a, n)
+#define ZV_SRAI(a, n) _mm_srai_epi32(a, n)
+#define ZV_CMPGT(a, b) _mm_cmpgt_epi32(a, b)
+#define ZV_SELECT(m, a, b) \
+    _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b))
+#define ZV_MOVEMASK(a) _mm_movemask_ps(_mm_castsi128_ps(a))
+#define ZV_LOAD(p) _mm_loadu_si128((const __m128i *) (p))
+#define ZV_STORE(p, a) _mm_storeu_si128((__m128i *) (p), a)
+
+static inline zv_vec zv_load_z(const GLushort *pz)
+{
+    return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) pz),
+                              _mm_setzero_si128());
+}
+
+static inline void zv_store_z(GLushort *pz, zv_vec z)
+{
+    /* SSE2 only has a saturating pack: sign extend the low halves first, so
+     * that z is truncated like the scalar code does */
+    z = _mm_srai_epi32(_mm_slli_epi32(z, 16), 16);
+    _mm_storel_epi64((__m128i *) pz, _mm_packs_epi32(z, z));
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+
+#define ZV_SIMD 1
+
+typedef int32x4_t zv_vec;
+#define ZV_SET1(a) vdupq_n_s32(a)
+#define ZV_ADD(a, b) vaddq_s32(a, b)
+#define ZV_OR(a, b) vorrq_s32(a, b)
+#define ZV_AND(a, b) vandq_s32(a, b)
+#define ZV_SRLI(a, n) \
+    vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), n))
+#define ZV_SRAI(a, n) vshrq_n_s32(a, n)
+#define ZV_CMPGT(a, b) vreinterpretq_s32_u32(vcgtq_s32(a, b))
+#define ZV_SELECT(m, a, b) vbslq_s32(vreinterpretq_u32_s32(m), a, b)
+#define ZV_LOAD(p) vld1q_s32((const int32_t *) (p))
+#define ZV_STORE(p, a) vst1q_s32((int32_t *) (p), a)
+
+static inline zv_vec ZV_RAMP(GLint a)
+{
+    const int32_t lanes[4] = {0, 1, 2, 3};
+    return vmulq_n_s32(vld1q_s32(lanes), a);
+}
+
+static inline GLint ZV_MOVEMASK(zv_vec a)
+{
+    const int32_t bits[4] = {1, 2, 4, 8};
+    return vaddvq_s32(vandq_s32(vshrq_n_s32(a, 31), vld1q_s32(bits)));
+}
+
+static inline zv_vec zv_load_z(const GLushort *pz)
+{
+    return vreinterpretq_s32_u32(vmovl_u16(vld1_u16(pz)));
+}
+
+static inline void zv_store_z(GLushort *pz, zv_vec z)
+{
+    vst1_u16(pz, vmovn_u32(vreinterpretq_u32_s32(z)));
+}
+
+#else
+#include <string.h>
+
+/*
+ * Portable fallback; lanes wrap around like the vector instructions do.
+ * ZV_SIMD is left undefined, so that callers can prefer their own scalar
+ * loops.
+ */
+typedef struct {
+    GLint v[4];
+} zv_vec;
+
+static inline zv_vec ZV_SET1(GLint a)
+{
+    zv_vec r = {{a, a, a, a}};
+    return r;
+}
+
+static inline zv_vec ZV_RAMP(GLint a)
+{
+    zv_vec r = {{0, a, a * 2, a * 3}};
+    return r;
+}
+
+#define ZV_LANEWISE(name, expr)                   \
+    static inline zv_vec name(zv_vec a, zv_vec b) \
+    {                                             \
+        zv_vec r;                                 \
+        GLint i;                                  \
+        for (i = 0; i < 4; i++)                   \
+            r.v[i] = (expr);                      \
+        return r;                                 \
+    }
+ZV_LANEWISE(ZV_ADD, (GLint) ((GLuint) a.v[i] + (GLuint) b.v[i]))
+ZV_LANEWISE(ZV_OR, a.v[i] | b.v[i])
+ZV_LANEWISE(ZV_AND, a.v[i] & b.v[i])
+ZV_LANEWISE(ZV_CMPGT, -(a.v[i] > b.v[i]))
+#undef ZV_LANEWISE
+
+static inline zv_vec ZV_SELECT(zv_vec m, zv_vec a, zv_vec b)
+{
+    zv_vec r;
+    GLint i;
+    for (i = 0; i < 4; i++)
+        r.v[i] = (m.v[i] & a.v[i]) | (~m.v[i] & b.v[i]);
+    return r;
+}
+
+static inline zv_vec zv_srli(zv_vec a, GLint n)
+{
+    zv_vec r;
+    GLint i;
+    for (i = 0; i < 4; i++)
+        r.v[i] = (GLint) ((GLuint) a.v[i] >> n);
+    return r;
+}
+#define ZV_SRLI(a, n) zv_srli(a, n)
+
+/* only used to spread the sign bit */
+static inline zv_vec zv_srai(zv_vec a, GLint n)
+{
+    zv_vec r;
+    GLint i;
+    for (i = 0; i < 4; i++)
+        r.v[i] = a.v[i] < 0 ? -1 : 0;
+    return r;
+}
+#define ZV_SRAI(a, n) zv_srai(a, n)
+
+static inline GLint ZV_MOVEMASK(zv_vec a)
+{
+    return ((GLuint) a.v[0] >> 31) | (((GLuint) a.v[1] >> 31) << 1) |
+           (((GLuint) a.v[2] >> 31) << 2) | (((GLuint) a.v[3] >> 31) << 3);
+}
+
+#define ZV_LOAD(p) zv_load((const GLint *) (p))
+#define ZV_STORE(p, a) memcpy((p), (a).v, sizeof((a).v))
+
+static inline zv_vec zv_load(const GLint *p)
+{
+    zv_vec r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+
+static inline zv_vec zv_load_z(const GLushort *pz)
+{
+    zv_vec r = {{pz[0], pz[1], pz[2], pz[3]}};
+    return r;
+}
+
+static inline void zv_store_z(GLushort *pz, zv_vec z)
+{
+    pz[0] = z.v[0];
+    pz[1] = z.v[1];
+    pz[2] = z.v[2];
+    pz[3] = z.v[3];
+}
+
+#endif
+
+/*
+ * 4 x 32-bit float vector, for the matrix kernels of zmath.c. ZF_TRANSPOSE
+ * transposes the 4x4 matrix of which a, b, c and d are the rows. There is no
+ * fallback: without SSE2 or NEON, ZF_SIMD is left undefined and zmath.c keeps
+ * its scalar loops.
+ */
+#if defined(__SSE2__)
+
+#define ZF_SIMD 1
+
+typedef __m128 zf_vec;
+#define ZF_SET1(a) _mm_set1_ps(a)
+#define ZF_ADD(a, b) _mm_add_ps(a, b)
+#define ZF_SUB(a, b) _mm_sub_ps(a, b)
+#define ZF_MUL(a, b) _mm_mul_ps(a, b)
+#define ZF_LOAD(p) _mm_loadu_ps(p)
+#define ZF_STORE(p, a) _mm_storeu_ps(p, a)
+#define ZF_TRANSPOSE(a, b, c, d) _MM_TRANSPOSE4_PS(a, b, c, d)
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+#define ZF_SIMD 1
+
+typedef float32x4_t zf_vec;
+#define ZF_SET1(a) vdupq_n_f32(a)
+#define ZF_ADD(a, b) vaddq_f32(a, b)
+#define ZF_SUB(a, b) vsubq_f32(a, b)
+#define ZF_MUL(a, b) vmulq_f32(a, b)
+#define ZF_LOAD(p) vld1q_f32(p)
+#define ZF_STORE(p, a) vst1q_f32(p, a)
+
+static inline void zf_transpose(zf_vec *a, zf_vec *b, zf_vec *c, zf_vec *d)
+{
+    float64x2_t ab0 = vreinterpretq_f64_f32(vtrn1q_f32(*a, *b));
+    float64x2_t ab1 = vreinterpretq_f64_f32(vtrn2q_f32(*a, *b));
+    float64x2_t cd0 = vreinterpretq_f64_f32(vtrn1q_f32(*c, *d));
+    float64x2_t cd1 = vreinterpretq_f64_f32(vtrn2q_f32(*c, *d));
+    *a = vreinterpretq_f32_f64(vtrn1q_f64(ab0, cd0));
+    *b = vreinterpretq_f32_f64(vtrn1q_f64(ab1, cd1));
+    *c = vreinterpretq_f32_f64(vtrn2q_f64(ab0, cd0));
+    *d = vreinterpretq_f32_f64(vtrn2q_f64(ab1, cd1));
+}
+#define ZF_TRANSPOSE(a, b, c, d) zf_transpose(&(a), &(b), &(c), &(d))
+
+#endif
+
+#endif /* ZSIMD_H */
@@ -47,6 +47,7 @@ void glopPlotPixel(GLParam *p)
     GLContext *c = gl_get_context();
     GLint idx = p[1].i;
     PIXEL pix = p[2].ui;
+    ZB_flushTriangles(c->zb);
 #if TGL_HAS(DIRTY_RECTANGLE)
     /* Convert linear index back to x,y for dirty marking */
     GLint px = idx % c->zb->xsize;
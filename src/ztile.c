@@ -0,0 +1,202 @@
+/*
+ * Tile-binned triangle rasterization.
+ *
+ * Instead of drawing each triangle as soon as it leaves the clipper, the
+ * triangle (its screen points, the rasterizer variant selected for it and the
+ * ZBuffer state that variant reads while drawing) is recorded once, and its
+ * index is appended to every band of TGL_TILE_HEIGHT rows it covers.
+ *
+ * When the bins are flushed each band is handed to a worker, which replays
+ * its triangles in submission order through the regular ztriangle.h
+ * rasterizers with clip_ymin/clip_ymax restricted to the band. Bands do not
+ * share any pixel, so the workers run without locks, and as each pixel still
+ * sees its triangles in order the result is identical to serial rendering.
+ */
+
+#include <stdlib.h>
+
+#include "msghandling.h"
+#include "zbuffer.h"
+
+#if TGL_HAS(MULTITHREADED_TILED_RASTER)
+
+#define TGL_TILE_HEIGHT (1 << TGL_TILE_HEIGHT_POW2)
+
+typedef struct {
+    ZB_fillTriangleFunc func;
+    PIXEL *texture;
+#if TGL_HAS(BLEND)
+    GLenum blendeq, sfactor, dfactor;
+#endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    GLubyte depth_test, depth_write;
+#endif
+    ZBufferPoint p[3];
+} ZBTileTriangle;
+
+struct ZBTileBins {
+    ZBTileTriangle *tris;
+    GLint nb_tris;
+    GLint nb_bins;
+    GLint *bin_count;
+    /* nb_bins lists of TGL_TILE_MAX_TRIANGLES indices into tris */
+    GLushort *bin_tris;
+};
+
+/* If the bins cannot be allocated, triangles are simply drawn immediately. */
+void ZB_initTiles(ZBuffer *zb)
+{
+    struct ZBTileBins *tb;
+    GLint nb_bins = (zb->ysize + TGL_TILE_HEIGHT - 1) >> TGL_TILE_HEIGHT_POW2;
+
+    zb->clip_ymin = 0;
+    zb->clip_ymax = zb->ysize - 1;
+    zb->tiles = NULL;
+
+    tb = gl_zalloc(sizeof(struct ZBTileBins));
+    if (tb == NULL)
+        return;
+    tb->nb_bins = nb_bins;
+    tb->tris = gl_malloc(TGL_TILE_MAX_TRIANGLES * sizeof(ZBTileTriangle));
+    tb->bin_count = gl_zalloc(nb_bins * sizeof(GLint));
+    tb->bin_tris =
+        gl_malloc(nb_bins * TGL_TILE_MAX_TRIANGLES * sizeof(GLushort));
+    if (tb->tris == NULL || tb->bin_count == NULL || tb->bin_tris == NULL) {
+        gl_free(tb->tris);
+        gl_free(tb->bin_count);
+        gl_free(tb->bin_tris);
+        gl_free(tb);
+        return;
+    }
+    zb->tiles = tb;
+}
+
+/* Pending triangles are dropped: the buffers they target are going away. */
+void ZB_closeTiles(ZBuffer *zb)
+{
+    struct ZBTileBins *tb = zb->tiles;
+    if (tb == NULL)
+        return;
+    gl_free(tb->tris);
+    gl_free(tb->bin_count);
+    gl_free(tb->bin_tris);
+    gl_free(tb);
+    zb->tiles = NULL;
+}
+
+void ZB_binTriangle(ZBuffer *zb,
+                    ZB_fillTriangleFunc func,
+                    ZBufferPoint *p0,
+                    ZBufferPoint *p1,
+                    ZBufferPoint *p2)
+{
+    struct ZBTileBins *tb = zb->tiles;
+    ZBTileTriangle *t;
+    GLint ymin, ymax, bin, idx;
+
+    if (tb == NULL) {
+#if TGL_HAS(HIERARCHICAL_Z)
+        ZB_fillTriangleHiZ(zb, func, zb->depth_test, zb->depth_write, p0, p1,
+                           p2);
+#else
+        func(zb, p0, p1, p2);
+#endif
+        return;
+    }
+
+    ymin = p0->y;
+    ymax = p0->y;
+    if (p1->y < ymin)
+        ymin = p1->y;
+    if (p1->y > ymax)
+        ymax = p1->y;
+    if (p2->y < ymin)
+        ymin = p2->y;
+    if (p2->y > ymax)
+        ymax = p2->y;
+    if (ymin < 0)
+        ymin = 0;
+    if (ymax >= zb->ysize)
+        ymax = zb->ysize - 1;
+    if (ymin > ymax)
+        return;
+
+    if (tb->nb_tris == TGL_TILE_MAX_TRIANGLES)
+        ZB_flushTiles(zb);
+
+    idx = tb->nb_tris++;
+    t = &tb->tris[idx];
+    t->func = func;
+    t->texture = zb->current_texture;
+#if TGL_HAS(BLEND)
+    t->blendeq = zb->blendeq;
+    t->sfactor = zb->sfactor;
+    t->dfactor = zb->dfactor;
+#endif
+#if TGL_HAS(HIERARCHICAL_Z)
+    t->depth_test = zb->depth_test != 0;
+    t->depth_write = zb->depth_write != 0;
+#endif
+    t->p[0] = *p0;
+    t->p[1] = *p1;
+    t->p[2] = *p2;
+
+    for (bin = ymin >> TGL_TILE_HEIGHT_POW2;
+         bin <= (ymax >> TGL_TILE_HEIGHT_POW2); bin++)
+        tb->bin_tris[bin * TGL_TILE_MAX_TRIANGLES + tb->bin_count[bin]++] =
+            idx;
+}
+
+void ZB_flushTiles(ZBuffer *zb)
+{
+    struct ZBTileBins *tb = zb->tiles;
+    GLint bin;
+
+    if (tb == NULL || tb->nb_tris == 0)
+        return;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (bin = 0; bin < tb->nb_bins; bin++) {
+        /* Private copy: the band limits and the recorded state are per
+         * worker, everything else is shared with the other bands. */
+        ZBuffer tzb = *zb;
+        GLushort *list = tb->bin_tris + bin * TGL_TILE_MAX_TRIANGLES;
+        GLint i, n = tb->bin_count[bin];
+
+        tzb.samples_passed = 0;
+        tzb.clip_ymin = bin << TGL_TILE_HEIGHT_POW2;
+        tzb.clip_ymax = tzb.clip_ymin + TGL_TILE_HEIGHT - 1;
+        if (tzb.clip_ymax >= zb->ysize)
+            tzb.clip_ymax = zb->ysize - 1;
+
+        for (i = 0; i < n; i++) {
+            ZBTileTriangle *t = &tb->tris[list[i]];
+            /* the rasterizers scribble on their points */
+            ZBufferPoint p0 = t->p[0], p1 = t->p[1], p2 = t->p[2];
+            tzb.current_texture = t->texture;
+#if TGL_HAS(BLEND)
+            tzb.blendeq = t->blendeq;
+            tzb.sfactor = t->sfactor;
+            tzb.dfactor = t->dfactor;
+#endif
+#if TGL_HAS(HIERARCHICAL_Z)
+            ZB_fillTriangleHiZ(&tzb, t->func, t->depth_test, t->depth_write,
+                               &p0, &p1, &p2);
+#else
+            t->func(&tzb, &p0, &p1, &p2);
+#endif
+        }
+        tb->bin_count[bin] = 0;
+        if (tzb.samples_passed) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+            zb->samples_passed += tzb.samples_passed;
+        }
+    }
+    tb->nb_tris = 0;
+}
+
+#endif /* TGL_HAS(MULTITHREADED_TILED_RASTER) */
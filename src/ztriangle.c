@@ -10,8 +10,12 @@
  *   _DT0_DW1: depth_test=off, depth_write=on
  *   _DT1_DW0: depth_test=on, depth_write=off
  *   _DT1_DW1: depth_test=on, depth_write=on
+ *
+ * The variants with blending are generated from ztriangle_blend.h, once for
+ * any blend state and once for each blend mode of ZTRI_BLEND_MODES.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include "msghandling.h"
 #include "zbuffer.h"
@@ -46,176 +50,187 @@
 #define NODRAWTEST(c)
 #endif
 
-/* Texture setup */
-void ZB_setTexture(ZBuffer *zb, PIXEL *texture)
-{
-    zb->current_texture = texture;
-}
-
 /*
- * ============================================================================
- * Flat shaded triangle - with blending
- * ============================================================================
+ * Slope of an edge spanning dy rows, in 16.16 fixed point. Most edges of
+ * small triangles are only a few rows high: those are divided by a constant,
+ * which the compiler turns into a shift or a multiply.
  */
-
-/* Variant DT0_DW0 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
-
-void ZB_fillTriangleFlat_DT0_DW0(ZBuffer *zb,
-                                 ZBufferPoint *p0,
-                                 ZBufferPoint *p1,
-                                 ZBufferPoint *p2)
+static inline GLint ZB_edgeSlope(GLint dx, GLint dy)
 {
-    GLuint color;
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-
-#define DRAW_INIT()                                \
-    {                                              \
-        color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); \
-    }
-
-#define PUT_PIXEL(_a)                                   \
-    {                                                   \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
-        /* DT=0: always pass depth test */              \
-        if (1 STIPTEST(_a)) {                           \
-            TGL_BLEND_FUNC(color, (pp[_a]))             \
-            /* DW=0: no depth write */                  \
-        }                                               \
-        z += dzdx;                                      \
+#if TGL_HAS(SMALL_TRIANGLES)
+    switch (dy) {
+    case 1:
+        return dx << 16;
+    case 2:
+        return (dx << 16) / 2;
+    case 3:
+        return (dx << 16) / 3;
+    case 4:
+        return (dx << 16) / 4;
     }
-
-#include "ztriangle.h"
+#endif
+    if (dy > 0)
+        return (dx << 16) / dy;
+    return 0;
 }
 
-/* Variant DT0_DW1 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
-
-void ZB_fillTriangleFlat_DT0_DW1(ZBuffer *zb,
-                                 ZBufferPoint *p0,
-                                 ZBufferPoint *p1,
-                                 ZBufferPoint *p2)
+/* Texture setup */
+void ZB_setTexture(ZBuffer *zb, PIXEL *texture)
 {
-    GLuint color;
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-
-#define DRAW_INIT()                                \
-    {                                              \
-        color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); \
-    }
-
-#define PUT_PIXEL(_a)                                   \
-    {                                                   \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
-        /* DT=0: always pass depth test */              \
-        if (1 STIPTEST(_a)) {                           \
-            TGL_BLEND_FUNC(color, (pp[_a]))             \
-            /* DW=1: always write depth */              \
-            pz[_a] = zz;                                \
-        }                                               \
-        z += dzdx;                                      \
-    }
-
-#include "ztriangle.h"
+    zb->current_texture = texture;
 }
 
-/* Variant DT1_DW0 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
+/*
+ * Vector span writers for the opaque flat and smooth variants, 4 pixels per
+ * step: the depth test yields a lane mask, and the lanes that fail it write
+ * back the pixels and depths they loaded. They draw exactly what PUT_PIXEL
+ * draws. Without SSE2/NEON, or when the stipple needs a test per pixel, the
+ * variants keep their unrolled PUT_PIXEL loop.
+ */
+#if TGL_HAS(SIMD_SPANS) && TGL_FEATURE_RENDER_BITS == 32 && \
+    !TGL_HAS(POLYGON_STIPPLE)
+#include "zsimd.h"
+#endif
 
-void ZB_fillTriangleFlat_DT1_DW0(ZBuffer *zb,
-                                 ZBufferPoint *p0,
-                                 ZBufferPoint *p1,
-                                 ZBufferPoint *p2)
+#ifdef ZV_SIMD
+#define ZB_SIMD_SPANS 1
+
+/* n pixels from pp/pz; dt and dw are constants, and fold away */
+static inline void ZB_spanFlat(PIXEL *pp,
+                               GLushort *pz,
+                               GLint n,
+                               GLuint z,
+                               GLint dzdx,
+                               PIXEL color,
+                               GLint dt,
+                               GLint dw)
 {
-    GLuint color;
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-
-#define DRAW_INIT()                                \
-    {                                              \
-        color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); \
+    zv_vec zv = ZV_ADD(ZV_SET1(z), ZV_RAMP(dzdx));
+    zv_vec zstep = ZV_SET1((GLint) ((GLuint) dzdx * 4));
+    zv_vec c = ZV_SET1(color);
+
+    for (; n >= 4; n -= 4) {
+        zv_vec zz = ZV_SRLI(zv, ZB_POINT_Z_FRAC_BITS);
+        if (dt) {
+            zv_vec zold = zv_load_z(pz);
+            zv_vec fail = ZV_CMPGT(zold, zz);
+            GLint m = ZV_MOVEMASK(fail);
+            if (m == 0) {
+                ZV_STORE(pp, c);
+                if (dw)
+                    zv_store_z(pz, zz);
+            } else if (m != 0xf) {
+                ZV_STORE(pp, ZV_SELECT(fail, ZV_LOAD(pp), c));
+                if (dw)
+                    zv_store_z(pz, ZV_SELECT(fail, zold, zz));
+            }
+        } else {
+            ZV_STORE(pp, c);
+            if (dw)
+                zv_store_z(pz, zz);
+        }
+        zv = ZV_ADD(zv, zstep);
+        z += (GLuint) dzdx * 4;
+        pp += 4;
+        pz += 4;
     }
-
-#define PUT_PIXEL(_a)                                   \
-    {                                                   \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
-        /* DT=1: test depth */                          \
-        if ((zz >= pz[_a]) STIPTEST(_a)) {              \
-            TGL_BLEND_FUNC(color, (pp[_a]))             \
-            /* DW=0: no depth write */                  \
-        }                                               \
-        z += dzdx;                                      \
+    for (; n > 0; n--) {
+        GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;
+        if (!dt || zz >= *pz) {
+            *pp = color;
+            if (dw)
+                *pz = zz;
+        }
+        z += dzdx;
+        pp++;
+        pz++;
     }
-
-#include "ztriangle.h"
 }
 
-/* Variant DT1_DW1 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
-
-void ZB_fillTriangleFlat_DT1_DW1(ZBuffer *zb,
-                                 ZBufferPoint *p0,
-                                 ZBufferPoint *p1,
-                                 ZBufferPoint *p2)
+static inline void ZB_spanSmooth(PIXEL *pp,
+                                 GLushort *pz,
+                                 GLint n,
+                                 GLuint z,
+                                 GLint dzdx,
+                                 GLint r,
+                                 GLint drdx,
+                                 GLint g,
+                                 GLint dgdx,
+                                 GLint b,
+                                 GLint dbdx,
+                                 GLint dt,
+                                 GLint dw)
 {
-    GLuint color;
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-
-#define DRAW_INIT()                                \
-    {                                              \
-        color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); \
+    zv_vec zv = ZV_ADD(ZV_SET1(z), ZV_RAMP(dzdx));
+    zv_vec rv = ZV_ADD(ZV_SET1(r), ZV_RAMP(drdx));
+    zv_vec gv = ZV_ADD(ZV_SET1(g), ZV_RAMP(dgdx));
+    zv_vec bv = ZV_ADD(ZV_SET1(b), ZV_RAMP(dbdx));
+    zv_vec zstep = ZV_SET1((GLint) ((GLuint) dzdx * 4));
+    zv_vec rstep = ZV_SET1(drdx * 4), gstep = ZV_SET1(dgdx * 4);
+    zv_vec bstep = ZV_SET1(dbdx * 4);
+    zv_vec rmask = ZV_SET1(0xff0000), gmask = ZV_SET1(0xff00);
+    zv_vec bmask = ZV_SET1(0xff);
+
+    for (; n >= 4; n -= 4) {
+        zv_vec zz = ZV_SRLI(zv, ZB_POINT_Z_FRAC_BITS);
+        /* RGB_TO_PIXEL */
+        zv_vec c = ZV_OR(ZV_AND(rv, rmask),
+                         ZV_OR(ZV_AND(ZV_SRLI(gv, 8), gmask),
+                               ZV_AND(ZV_SRLI(bv, 16), bmask)));
+        if (dt) {
+            zv_vec zold = zv_load_z(pz);
+            zv_vec fail = ZV_CMPGT(zold, zz);
+            GLint m = ZV_MOVEMASK(fail);
+            if (m == 0) {
+                ZV_STORE(pp, c);
+                if (dw)
+                    zv_store_z(pz, zz);
+            } else if (m != 0xf) {
+                ZV_STORE(pp, ZV_SELECT(fail, ZV_LOAD(pp), c));
+                if (dw)
+                    zv_store_z(pz, ZV_SELECT(fail, zold, zz));
+            }
+        } else {
+            ZV_STORE(pp, c);
+            if (dw)
+                zv_store_z(pz, zz);
+        }
+        zv = ZV_ADD(zv, zstep);
+        rv = ZV_ADD(rv, rstep);
+        gv = ZV_ADD(gv, gstep);
+        bv = ZV_ADD(bv, bstep);
+        z += (GLuint) dzdx * 4;
+        r += drdx * 4;
+        g += dgdx * 4;
+        b += dbdx * 4;
+        pp += 4;
+        pz += 4;
     }
-
-#define PUT_PIXEL(_a)                                   \
-    {                                                   \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
-        /* DT=1: test depth */                          \
-        if ((zz >= pz[_a]) STIPTEST(_a)) {              \
-            TGL_BLEND_FUNC(color, (pp[_a]))             \
-            /* DW=1: always write depth */              \
-            pz[_a] = zz;                                \
-        }                                               \
-        z += dzdx;                                      \
+    for (; n > 0; n--) {
+        GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;
+        if (!dt || zz >= *pz) {
+            *pp = RGB_TO_PIXEL(r, g, b);
+            if (dw)
+                *pz = zz;
+        }
+        z += dzdx;
+        r += drdx;
+        g += dgdx;
+        b += dbdx;
+        pp++;
+        pz++;
     }
-
-#include "ztriangle.h"
 }
 
+/* the span of the current line, for DRAW_LINE in ztriangle.h */
+#define ZB_SPAN_FLAT(dt, dw)                                              \
+    ZB_spanFlat(pp1 + x1, pz1 + x1, (x2 >> 16) - x1 + 1, z1, dzdx, color, \
+                dt, dw)
+#define ZB_SPAN_SMOOTH(dt, dw)                                           \
+    ZB_spanSmooth(pp1 + x1, pz1 + x1, (x2 >> 16) - x1 + 1, z1, dzdx, r1, \
+                  drdx, g1, dgdx, b1, dbdx, dt, dw)
+#endif
+
 /*
  * ============================================================================
  * Flat shaded triangle - no blending
@@ -254,6 +269,10 @@ void ZB_fillTriangleFlatNOBLEND_DT0_DW0(ZBuffer *zb,
         z += dzdx;                                      \
     }
 
+#ifdef ZB_SIMD_SPANS
+#define DRAW_LINE() ZB_SPAN_FLAT(0, 0)
+#endif
+
 #include "ztriangle.h"
 }
 
@@ -290,6 +309,10 @@ void ZB_fillTriangleFlatNOBLEND_DT0_DW1(ZBuffer *zb,
         z += dzdx;                                      \
     }
 
+#ifdef ZB_SIMD_SPANS
+#define DRAW_LINE() ZB_SPAN_FLAT(0, 1)
+#endif
+
 #include "ztriangle.h"
 }
 
@@ -325,6 +348,10 @@ void ZB_fillTriangleFlatNOBLEND_DT1_DW0(ZBuffer *zb,
         z += dzdx;                                      \
     }
 
+#ifdef ZB_SIMD_SPANS
+#define DRAW_LINE() ZB_SPAN_FLAT(1, 0)
+#endif
+
 #include "ztriangle.h"
 }
 
@@ -361,17 +388,19 @@ void ZB_fillTriangleFlatNOBLEND_DT1_DW1(ZBuffer *zb,
         z += dzdx;                                      \
     }
 
+#ifdef ZB_SIMD_SPANS
+#define DRAW_LINE() ZB_SPAN_FLAT(1, 1)
+#endif
+
 #include "ztriangle.h"
 }
 
 /*
  * ============================================================================
- * Smooth shaded triangle - with blending
+ * Smooth shaded triangle - no blending
  * ============================================================================
  */
 
-#define SAR_RND_TO_ZERO(v, n) (v / (1 << n))
-
 /* Variant DT0_DW0 */
 #undef INTERP_Z
 #undef INTERP_RGB
@@ -381,12 +410,11 @@ void ZB_fillTriangleFlatNOBLEND_DT1_DW1(ZBuffer *zb,
 #undef PUT_PIXEL
 #undef DRAW_LINE
 
-void ZB_fillTriangleSmooth_DT0_DW0(ZBuffer *zb,
-                                   ZBufferPoint *p0,
-                                   ZBufferPoint *p1,
-                                   ZBufferPoint *p2)
+void ZB_fillTriangleSmoothNOBLEND_DT0_DW0(ZBuffer *zb,
+                                          ZBufferPoint *p0,
+                                          ZBufferPoint *p1,
+                                          ZBufferPoint *p2)
 {
-    TGL_BLEND_VARS
     TGL_STIPPLEVARS
 
 #define INTERP_Z
@@ -396,18 +424,22 @@ void ZB_fillTriangleSmooth_DT0_DW0(ZBuffer *zb,
     {               \
     }
 
-#define PUT_PIXEL(_a)                                    \
-    {                                                    \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;  \
-        if (1 STIPTEST(_a)) {                            \
-            TGL_BLEND_FUNC_RGB(or1, og1, ob1, (pp[_a])); \
-        }                                                \
-        z += dzdx;                                       \
-        og1 += dgdx;                                     \
-        or1 += drdx;                                     \
-        ob1 += dbdx;                                     \
+#define PUT_PIXEL(_a)                                   \
+    {                                                   \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
+        if (1 STIPTEST(_a)) {                           \
+            pp[_a] = RGB_TO_PIXEL(or1, og1, ob1);       \
+        }                                               \
+        z += dzdx;                                      \
+        og1 += dgdx;                                    \
+        or1 += drdx;                                    \
+        ob1 += dbdx;                                    \
     }
 
+#ifdef ZB_SIMD_SPANS
+#define DRAW_LINE() ZB_SPAN_SMOOTH(0, 0)
+#endif
+
 #include "ztriangle.h"
 }
 
@@ -420,12 +452,11 @@ void ZB_fillTriangleSmooth_DT0_DW0(ZBuffer *zb,
 #undef PUT_PIXEL
 #undef DRAW_LINE
 
-void ZB_fillTriangleSmooth_DT0_DW1(ZBuffer *zb,
-                                   ZBufferPoint *p0,
-                                   ZBufferPoint *p1,
-                                   ZBufferPoint *p2)
+void ZB_fillTriangleSmoothNOBLEND_DT0_DW1(ZBuffer *zb,
+                                          ZBufferPoint *p0,
+                                          ZBufferPoint *p1,
+                                          ZBufferPoint *p2)
 {
-    TGL_BLEND_VARS
     TGL_STIPPLEVARS
 
 #define INTERP_Z
@@ -435,19 +466,23 @@ void ZB_fillTriangleSmooth_DT0_DW1(ZBuffer *zb,
     {               \
     }
 
-#define PUT_PIXEL(_a)                                    \
-    {                                                    \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;  \
-        if (1 STIPTEST(_a)) {                            \
-            TGL_BLEND_FUNC_RGB(or1, og1, ob1, (pp[_a])); \
-            pz[_a] = zz;                                 \
-        }                                                \
-        z += dzdx;                                       \
-        og1 += dgdx;                                     \
-        or1 += drdx;                                     \
-        ob1 += dbdx;                                     \
+#define PUT_PIXEL(_a)                                   \
+    {                                                   \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
+        if (1 STIPTEST(_a)) {                           \
+            pp[_a] = RGB_TO_PIXEL(or1, og1, ob1);       \
+            pz[_a] = zz;                                \
+        }                                               \
+        z += dzdx;                                      \
+        og1 += dgdx;                                    \
+        or1 += drdx;                                    \
+        ob1 += dbdx;                                    \
     }
 
+#ifdef ZB_SIMD_SPANS
+#define DRAW_LINE() ZB_SPAN_SMOOTH(0, 1)
+#endif
+
 #include "ztriangle.h"
 }
 
@@ -460,12 +495,11 @@ void ZB_fillTriangleSmooth_DT0_DW1(ZBuffer *zb,
 #undef PUT_PIXEL
 #undef DRAW_LINE
 
-void ZB_fillTriangleSmooth_DT1_DW0(ZBuffer *zb,
-                                   ZBufferPoint *p0,
-                                   ZBufferPoint *p1,
-                                   ZBufferPoint *p2)
+void ZB_fillTriangleSmoothNOBLEND_DT1_DW0(ZBuffer *zb,
+                                          ZBufferPoint *p0,
+                                          ZBufferPoint *p1,
+                                          ZBufferPoint *p2)
 {
-    TGL_BLEND_VARS
     TGL_STIPPLEVARS
 
 #define INTERP_Z
@@ -475,68 +509,26 @@ void ZB_fillTriangleSmooth_DT1_DW0(ZBuffer *zb,
     {               \
     }
 
-#define PUT_PIXEL(_a)                                    \
-    {                                                    \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;  \
-        if ((zz >= pz[_a]) STIPTEST(_a)) {               \
-            TGL_BLEND_FUNC_RGB(or1, og1, ob1, (pp[_a])); \
-        }                                                \
-        z += dzdx;                                       \
-        og1 += dgdx;                                     \
-        or1 += drdx;                                     \
-        ob1 += dbdx;                                     \
-    }
-
-#include "ztriangle.h"
-}
-
-/* Variant DT1_DW1 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
-
-void ZB_fillTriangleSmooth_DT1_DW1(ZBuffer *zb,
-                                   ZBufferPoint *p0,
-                                   ZBufferPoint *p1,
-                                   ZBufferPoint *p2)
-{
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-#define INTERP_RGB
-
-#define DRAW_INIT() \
-    {               \
+#define PUT_PIXEL(_a)                                   \
+    {                                                   \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
+        if ((zz >= pz[_a]) STIPTEST(_a)) {              \
+            pp[_a] = RGB_TO_PIXEL(or1, og1, ob1);       \
+        }                                               \
+        z += dzdx;                                      \
+        og1 += dgdx;                                    \
+        or1 += drdx;                                    \
+        ob1 += dbdx;                                    \
     }
 
-#define PUT_PIXEL(_a)                                    \
-    {                                                    \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;  \
-        if ((zz >= pz[_a]) STIPTEST(_a)) {               \
-            TGL_BLEND_FUNC_RGB(or1, og1, ob1, (pp[_a])); \
-            pz[_a] = zz;                                 \
-        }                                                \
-        z += dzdx;                                       \
-        og1 += dgdx;                                     \
-        or1 += drdx;                                     \
-        ob1 += dbdx;                                     \
-    }
+#ifdef ZB_SIMD_SPANS
+#define DRAW_LINE() ZB_SPAN_SMOOTH(1, 0)
+#endif
 
 #include "ztriangle.h"
 }
 
-/*
- * ============================================================================
- * Smooth shaded triangle - no blending
- * ============================================================================
- */
-
-/* Variant DT0_DW0 */
+/* Variant DT1_DW1 */
 #undef INTERP_Z
 #undef INTERP_RGB
 #undef INTERP_ST
@@ -545,7 +537,7 @@ void ZB_fillTriangleSmooth_DT1_DW1(ZBuffer *zb,
 #undef PUT_PIXEL
 #undef DRAW_LINE
 
-void ZB_fillTriangleSmoothNOBLEND_DT0_DW0(ZBuffer *zb,
+void ZB_fillTriangleSmoothNOBLEND_DT1_DW1(ZBuffer *zb,
                                           ZBufferPoint *p0,
                                           ZBufferPoint *p1,
                                           ZBufferPoint *p2)
@@ -562,8 +554,9 @@ void ZB_fillTriangleSmoothNOBLEND_DT0_DW0(ZBuffer *zb,
 #define PUT_PIXEL(_a)                                   \
     {                                                   \
         register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
-        if (1 STIPTEST(_a)) {                           \
+        if ((zz >= pz[_a]) STIPTEST(_a)) {              \
             pp[_a] = RGB_TO_PIXEL(or1, og1, ob1);       \
+            pz[_a] = zz;                                \
         }                                               \
         z += dzdx;                                      \
         og1 += dgdx;                                    \
@@ -571,10 +564,20 @@ void ZB_fillTriangleSmoothNOBLEND_DT0_DW0(ZBuffer *zb,
         ob1 += dbdx;                                    \
     }
 
+#ifdef ZB_SIMD_SPANS
+#define DRAW_LINE() ZB_SPAN_SMOOTH(1, 1)
+#endif
+
 #include "ztriangle.h"
 }
 
-/* Variant DT0_DW1 */
+/*
+ * ============================================================================
+ * Samples passed - occlusion queries
+ * ============================================================================
+ */
+
+/* Depth test off: every pixel of the triangle passes */
 #undef INTERP_Z
 #undef INTERP_RGB
 #undef INTERP_ST
@@ -583,37 +586,39 @@ void ZB_fillTriangleSmoothNOBLEND_DT0_DW0(ZBuffer *zb,
 #undef PUT_PIXEL
 #undef DRAW_LINE
 
-void ZB_fillTriangleSmoothNOBLEND_DT0_DW1(ZBuffer *zb,
-                                          ZBufferPoint *p0,
-                                          ZBufferPoint *p1,
-                                          ZBufferPoint *p2)
+void ZB_fillTriangleSamples_DT0(ZBuffer *zb,
+                                ZBufferPoint *p0,
+                                ZBufferPoint *p1,
+                                ZBufferPoint *p2)
 {
     TGL_STIPPLEVARS
 
 #define INTERP_Z
-#define INTERP_RGB
 
 #define DRAW_INIT() \
     {               \
     }
 
-#define PUT_PIXEL(_a)                                   \
-    {                                                   \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
-        if (1 STIPTEST(_a)) {                           \
-            pp[_a] = RGB_TO_PIXEL(or1, og1, ob1);       \
-            pz[_a] = zz;                                \
-        }                                               \
-        z += dzdx;                                      \
-        og1 += dgdx;                                    \
-        or1 += drdx;                                    \
-        ob1 += dbdx;                                    \
+#define PUT_PIXEL(_a)             \
+    {                             \
+        if (1 STIPTEST(_a))       \
+            zb->samples_passed++; \
+        z += dzdx;                \
     }
 
+#if !TGL_HAS(POLYGON_STIPPLE)
+#define DRAW_LINE()                    \
+    {                                  \
+        GLint n = (x2 >> 16) - x1 + 1; \
+        if (n > 0)                     \
+            zb->samples_passed += n;   \
+    }
+#endif
+
 #include "ztriangle.h"
 }
 
-/* Variant DT1_DW0 */
+/* Depth test on */
 #undef INTERP_Z
 #undef INTERP_RGB
 #undef INTERP_ST
@@ -622,15 +627,14 @@ void ZB_fillTriangleSmoothNOBLEND_DT0_DW1(ZBuffer *zb,
 #undef PUT_PIXEL
 #undef DRAW_LINE
 
-void ZB_fillTriangleSmoothNOBLEND_DT1_DW0(ZBuffer *zb,
-                                          ZBufferPoint *p0,
-                                          ZBufferPoint *p1,
-                                          ZBufferPoint *p2)
+void ZB_fillTriangleSamples_DT1(ZBuffer *zb,
+                                ZBufferPoint *p0,
+                                ZBufferPoint *p1,
+                                ZBufferPoint *p2)
 {
     TGL_STIPPLEVARS
 
 #define INTERP_Z
-#define INTERP_RGB
 
 #define DRAW_INIT() \
     {               \
@@ -639,19 +643,20 @@ void ZB_fillTriangleSmoothNOBLEND_DT1_DW0(ZBuffer *zb,
 #define PUT_PIXEL(_a)                                   \
     {                                                   \
         register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
-        if ((zz >= pz[_a]) STIPTEST(_a)) {              \
-            pp[_a] = RGB_TO_PIXEL(or1, og1, ob1);       \
-        }                                               \
+        if ((zz >= pz[_a]) STIPTEST(_a))                \
+            zb->samples_passed++;                       \
         z += dzdx;                                      \
-        og1 += dgdx;                                    \
-        or1 += drdx;                                    \
-        ob1 += dbdx;                                    \
     }
 
 #include "ztriangle.h"
 }
 
-/* Variant DT1_DW1 */
+/*
+ * ============================================================================
+ * Depth only - depth prepass
+ * ============================================================================
+ */
+
 #undef INTERP_Z
 #undef INTERP_RGB
 #undef INTERP_ST
@@ -660,15 +665,14 @@ void ZB_fillTriangleSmoothNOBLEND_DT1_DW0(ZBuffer *zb,
 #undef PUT_PIXEL
 #undef DRAW_LINE
 
-void ZB_fillTriangleSmoothNOBLEND_DT1_DW1(ZBuffer *zb,
-                                          ZBufferPoint *p0,
-                                          ZBufferPoint *p1,
-                                          ZBufferPoint *p2)
+void ZB_fillTriangleDepth(ZBuffer *zb,
+                          ZBufferPoint *p0,
+                          ZBufferPoint *p1,
+                          ZBufferPoint *p2)
 {
     TGL_STIPPLEVARS
 
 #define INTERP_Z
-#define INTERP_RGB
 
 #define DRAW_INIT() \
     {               \
@@ -677,14 +681,9 @@ void ZB_fillTriangleSmoothNOBLEND_DT1_DW1(ZBuffer *zb,
 #define PUT_PIXEL(_a)                                   \
     {                                                   \
         register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
-        if ((zz >= pz[_a]) STIPTEST(_a)) {              \
-            pp[_a] = RGB_TO_PIXEL(or1, og1, ob1);       \
+        if ((zz >= pz[_a]) STIPTEST(_a))                \
             pz[_a] = zz;                                \
-        }                                               \
         z += dzdx;                                      \
-        og1 += dgdx;                                    \
-        or1 += drdx;                                    \
-        ob1 += dbdx;                                    \
     }
 
 #include "ztriangle.h"
@@ -783,227 +782,34 @@ void ZB_fillTriangleSmoothNOBLEND_DT1_DW1(ZBuffer *zb,
 
 /*
  * ============================================================================
- * Texture mapped triangle - with blending
+ * Flat, smooth and texture mapped triangles - with blending
  * ============================================================================
  */
 
-/* Variant DT0_DW0 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
-#undef PUT_PIXEL_TEXTURED
-
-void ZB_fillTriangleMappingPerspective_DT0_DW0(ZBuffer *zb,
-                                               ZBufferPoint *p0,
-                                               ZBufferPoint *p1,
-                                               ZBufferPoint *p2)
-{
-    PIXEL *texture;
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-#define INTERP_STZ
-#define INTERP_RGB
-
-#define DRAW_INIT()                    \
-    {                                  \
-        texture = zb->current_texture; \
-        fdzdx = (GLfloat) dzdx;        \
-        fndzdx = NB_INTERP * fdzdx;    \
-        ndszdx = NB_INTERP * dszdx;    \
-        ndtzdx = NB_INTERP * dtzdx;    \
-    }
-
-#define PUT_PIXEL_TEXTURED(_a, _dt, _dw)                                      \
-    {                                                                         \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                       \
-        if (1 STIPTEST(_a)) {                                                 \
-            TGL_BLEND_FUNC(                                                   \
-                RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), \
-                (pp[_a]));                                                    \
-        }                                                                     \
-        z += dzdx;                                                            \
-        s += dsdx;                                                            \
-        t += dtdx;                                                            \
-        OR1G1B1INCR                                                           \
-    }
-
-#define DRAW_LINE()                             \
-    {                                           \
-        DRAW_LINE_TRI_TEXTURED(0, /* no-op */;) \
-    }
-
-#include "ztriangle.h"
-}
-
-/* Variant DT0_DW1 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
-#undef PUT_PIXEL_TEXTURED
-
-void ZB_fillTriangleMappingPerspective_DT0_DW1(ZBuffer *zb,
-                                               ZBufferPoint *p0,
-                                               ZBufferPoint *p1,
-                                               ZBufferPoint *p2)
-{
-    PIXEL *texture;
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-#define INTERP_STZ
-#define INTERP_RGB
-
-#define DRAW_INIT()                    \
-    {                                  \
-        texture = zb->current_texture; \
-        fdzdx = (GLfloat) dzdx;        \
-        fndzdx = NB_INTERP * fdzdx;    \
-        ndszdx = NB_INTERP * dszdx;    \
-        ndtzdx = NB_INTERP * dtzdx;    \
-    }
-
-#define PUT_PIXEL_TEXTURED(_a, _dt, _dw)                                      \
-    {                                                                         \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                       \
-        if (1 STIPTEST(_a)) {                                                 \
-            TGL_BLEND_FUNC(                                                   \
-                RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), \
-                (pp[_a]));                                                    \
-            pz[_a] = zz;                                                      \
-        }                                                                     \
-        z += dzdx;                                                            \
-        s += dsdx;                                                            \
-        t += dtdx;                                                            \
-        OR1G1B1INCR                                                           \
-    }
-
-#define DRAW_LINE()                             \
-    {                                           \
-        DRAW_LINE_TRI_TEXTURED(0, pz[_a] = zz;) \
-    }
-
-#include "ztriangle.h"
-}
-
-/* Variant DT1_DW0 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
-#undef PUT_PIXEL_TEXTURED
-
-void ZB_fillTriangleMappingPerspective_DT1_DW0(ZBuffer *zb,
-                                               ZBufferPoint *p0,
-                                               ZBufferPoint *p1,
-                                               ZBufferPoint *p2)
-{
-    PIXEL *texture;
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-#define INTERP_STZ
-#define INTERP_RGB
-
-#define DRAW_INIT()                    \
-    {                                  \
-        texture = zb->current_texture; \
-        fdzdx = (GLfloat) dzdx;        \
-        fndzdx = NB_INTERP * fdzdx;    \
-        ndszdx = NB_INTERP * dszdx;    \
-        ndtzdx = NB_INTERP * dtzdx;    \
-    }
-
-#define PUT_PIXEL_TEXTURED(_a, _dt, _dw)                                      \
-    {                                                                         \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                       \
-        if ((zz >= pz[_a]) STIPTEST(_a)) {                                    \
-            TGL_BLEND_FUNC(                                                   \
-                RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), \
-                (pp[_a]));                                                    \
-        }                                                                     \
-        z += dzdx;                                                            \
-        s += dsdx;                                                            \
-        t += dtdx;                                                            \
-        OR1G1B1INCR                                                           \
-    }
-
-#define DRAW_LINE()                             \
-    {                                           \
-        DRAW_LINE_TRI_TEXTURED(1, /* no-op */;) \
-    }
-
-#include "ztriangle.h"
-}
-
-/* Variant DT1_DW1 */
-#undef INTERP_Z
-#undef INTERP_RGB
-#undef INTERP_ST
-#undef INTERP_STZ
-#undef DRAW_INIT
-#undef PUT_PIXEL
-#undef DRAW_LINE
-#undef PUT_PIXEL_TEXTURED
-
-void ZB_fillTriangleMappingPerspective_DT1_DW1(ZBuffer *zb,
-                                               ZBufferPoint *p0,
-                                               ZBufferPoint *p1,
-                                               ZBufferPoint *p2)
-{
-    PIXEL *texture;
-    TGL_BLEND_VARS
-    TGL_STIPPLEVARS
-
-#define INTERP_Z
-#define INTERP_STZ
-#define INTERP_RGB
-
-#define DRAW_INIT()                    \
-    {                                  \
-        texture = zb->current_texture; \
-        fdzdx = (GLfloat) dzdx;        \
-        fndzdx = NB_INTERP * fdzdx;    \
-        ndszdx = NB_INTERP * dszdx;    \
-        ndtzdx = NB_INTERP * dtzdx;    \
-    }
-
-#define PUT_PIXEL_TEXTURED(_a, _dt, _dw)                                      \
-    {                                                                         \
-        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                       \
-        if ((zz >= pz[_a]) STIPTEST(_a)) {                                    \
-            TGL_BLEND_FUNC(                                                   \
-                RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), \
-                (pp[_a]));                                                    \
-            pz[_a] = zz;                                                      \
-        }                                                                     \
-        z += dzdx;                                                            \
-        s += dsdx;                                                            \
-        t += dtdx;                                                            \
-        OR1G1B1INCR                                                           \
-    }
-
-#define DRAW_LINE()                             \
-    {                                           \
-        DRAW_LINE_TRI_TEXTURED(1, pz[_a] = zz;) \
-    }
-
-#include "ztriangle.h"
-}
+#define ZTRI_BLEND_NAME(base, variant) base##variant
+#define ZTRI_BLEND_VARS TGL_BLEND_VARS
+#include "ztriangle_blend.h"
+
+#if TGL_HAS(BLEND) && TGL_HAS(BLEND_MODE_VARIANTS)
+#define ZTRI_BLEND_NAME(base, variant) base##_ADD_ONE_ONE##variant
+#define ZTRI_BLEND_VARS TGL_BLEND_CONST_VARS(GL_FUNC_ADD, GL_ONE, GL_ONE)
+#include "ztriangle_blend.h"
+
+#define ZTRI_BLEND_NAME(base, variant) base##_ADD_INV_ONE##variant
+#define ZTRI_BLEND_VARS \
+    TGL_BLEND_CONST_VARS(GL_FUNC_ADD, GL_ONE_MINUS_SRC_COLOR, GL_ONE)
+#include "ztriangle_blend.h"
+
+#define ZTRI_BLEND_NAME(base, variant) base##_ADD_ONE_INV##variant
+#define ZTRI_BLEND_VARS \
+    TGL_BLEND_CONST_VARS(GL_FUNC_ADD, GL_ONE, GL_ONE_MINUS_DST_COLOR)
+#include "ztriangle_blend.h"
+
+#define ZTRI_BLEND_NAME(base, variant) base##_REVSUB_ONE_ONE##variant
+#define ZTRI_BLEND_VARS \
+    TGL_BLEND_CONST_VARS(GL_FUNC_REVERSE_SUBTRACT, GL_ONE, GL_ONE)
+#include "ztriangle_blend.h"
+#endif
 
 /*
  * ============================================================================
@@ -1428,30 +1234,53 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer *zb,
  * ============================================================================
  */
 
-ZB_TriangleDispatch zb_triangle_dispatch = {
+#define ZTRI_FLAT_VARIANTS(name, eq, sf, df) \
+    , ZTRI_VARIANTS(ZB_fillTriangleFlat_##name)
+#define ZTRI_SMOOTH_VARIANTS(name, eq, sf, df) \
+    , ZTRI_VARIANTS(ZB_fillTriangleSmooth_##name)
+#define ZTRI_TEXTURED_VARIANTS(name, eq, sf, df) \
+    , ZTRI_VARIANTS(ZB_fillTriangleMappingPerspective_##name)
+
+const ZB_TriangleDispatch zb_triangle_dispatch_scanline = {
     /* flat with blend */
-    .flat = {ZB_fillTriangleFlat_DT0_DW0, ZB_fillTriangleFlat_DT0_DW1,
-             ZB_fillTriangleFlat_DT1_DW0, ZB_fillTriangleFlat_DT1_DW1},
+    .flat = {ZTRI_VARIANTS(ZB_fillTriangleFlat)
+                 ZTRI_BLEND_MODES(ZTRI_FLAT_VARIANTS)},
     /* flat without blend */
-    .flat_noblend = {ZB_fillTriangleFlatNOBLEND_DT0_DW0,
-                     ZB_fillTriangleFlatNOBLEND_DT0_DW1,
-                     ZB_fillTriangleFlatNOBLEND_DT1_DW0,
-                     ZB_fillTriangleFlatNOBLEND_DT1_DW1},
+    .flat_noblend = ZTRI_VARIANTS(ZB_fillTriangleFlatNOBLEND),
     /* smooth with blend */
-    .smooth = {ZB_fillTriangleSmooth_DT0_DW0, ZB_fillTriangleSmooth_DT0_DW1,
-               ZB_fillTriangleSmooth_DT1_DW0, ZB_fillTriangleSmooth_DT1_DW1},
+    .smooth = {ZTRI_VARIANTS(ZB_fillTriangleSmooth)
+                   ZTRI_BLEND_MODES(ZTRI_SMOOTH_VARIANTS)},
     /* smooth without blend */
-    .smooth_noblend = {ZB_fillTriangleSmoothNOBLEND_DT0_DW0,
-                       ZB_fillTriangleSmoothNOBLEND_DT0_DW1,
-                       ZB_fillTriangleSmoothNOBLEND_DT1_DW0,
-                       ZB_fillTriangleSmoothNOBLEND_DT1_DW1},
+    .smooth_noblend = ZTRI_VARIANTS(ZB_fillTriangleSmoothNOBLEND),
     /* textured with blend */
-    .textured = {ZB_fillTriangleMappingPerspective_DT0_DW0,
-                 ZB_fillTriangleMappingPerspective_DT0_DW1,
-                 ZB_fillTriangleMappingPerspective_DT1_DW0,
-                 ZB_fillTriangleMappingPerspective_DT1_DW1},
+    .textured = {ZTRI_VARIANTS(ZB_fillTriangleMappingPerspective)
+                     ZTRI_BLEND_MODES(ZTRI_TEXTURED_VARIANTS)},
     /* textured without blend */
-    .textured_noblend = {ZB_fillTriangleMappingPerspectiveNOBLEND_DT0_DW0,
-                         ZB_fillTriangleMappingPerspectiveNOBLEND_DT0_DW1,
-                         ZB_fillTriangleMappingPerspectiveNOBLEND_DT1_DW0,
-                         ZB_fillTriangleMappingPerspectiveNOBLEND_DT1_DW1}};
+    .textured_noblend =
+        ZTRI_VARIANTS(ZB_fillTriangleMappingPerspectiveNOBLEND),
+    /* samples passed */
+    .samples = ZTRI_SAMPLES_VARIANTS(ZB_fillTriangleSamples),
+    .samples_textured = ZTRI_SAMPLES_VARIANTS(ZB_fillTriangleSamples),
+    /* depth only */
+    .depth = ZB_fillTriangleDepth,
+    .depth_textured = ZB_fillTriangleDepth};
+
+#if TGL_FEATURE_HALFSPACE_RASTER == 2
+const ZB_TriangleDispatch *zb_triangle_dispatch =
+    &zb_triangle_dispatch_halfspace;
+#else
+const ZB_TriangleDispatch *zb_triangle_dispatch =
+    &zb_triangle_dispatch_scanline;
+#endif
+
+/* Unknown or unavailable rasterizers select the scanline one. */
+void ZB_setTriangleRasterizer(GLint rasterizer)
+{
+#if TGL_HAS(HALFSPACE_RASTER)
+    if (rasterizer == ZB_RASTERIZER_HALFSPACE) {
+        zb_triangle_dispatch = &zb_triangle_dispatch_halfspace;
+        return;
+    }
+#endif
+    zb_triangle_dispatch = &zb_triangle_dispatch_scanline;
+}
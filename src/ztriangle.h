@@ -22,9 +22,15 @@
     PIXEL *pp1;
 
     GLint part;
-    GLint dx1, dy1, dx2, dy2;
+    GLfloat fz;
+    /* slopes of the edges p0-p1, p0-p2 and p1-p2, in 16.16 fixed point */
+    GLint dxdy01, dxdy02, dxdy12;
 #if TGL_HAS(POLYGON_STIPPLE)
     GLint the_y;
+#endif
+#if ZB_CLIP_ROWS
+    /* only rows clip_ymin..clip_ymax are drawn; the edges are still walked */
+    GLint the_row;
 #endif
     GLint error, derror;
     GLint x1, dxdy_min, dxdy_max;
@@ -66,106 +72,145 @@
         p2 = t;
     }
 
-    /* we compute dXdx and dXdy for all GLinterpolated values */
-    fdx1 = p1->x - p0->x;
-    fdy1 = p1->y - p0->y;
+#if TGL_HAS(BATCHED_SETUP)
+    if (zb->setup) {
+        /* computed ahead by ZB_setupTriangles(), in the same order */
+        const ZBufferSetup *su = zb->setup;
+        fz = su->fz;
+        if (fz == 0)
+            return;
+#ifdef INTERP_Z
+        dzdx = su->dzdx;
+        dzdy = su->dzdy;
+#endif
+#ifdef INTERP_RGB
+        drdx = su->drdx;
+        drdy = su->drdy;
+        dgdx = su->dgdx;
+        dgdy = su->dgdy;
+        dbdx = su->dbdx;
+        dbdy = su->dbdy;
+#endif
+#ifdef INTERP_ST
+#error "INTERP_ST has no batched setup"
+#endif
+#ifdef INTERP_STZ
+        dszdx = su->dszdx;
+        dszdy = su->dszdy;
+        dtzdx = su->dtzdx;
+        dtzdy = su->dtzdy;
+#endif
+        dxdy01 = su->dxdy01;
+        dxdy02 = su->dxdy02;
+        dxdy12 = su->dxdy12;
+    } else
+#endif
+    {
+        /* we compute dXdx and dXdy for all GLinterpolated values */
+        fdx1 = p1->x - p0->x;
+        fdy1 = p1->y - p0->y;
 
-    fdx2 = p2->x - p0->x;
-    fdy2 = p2->y - p0->y;
+        fdx2 = p2->x - p0->x;
+        fdy2 = p2->y - p0->y;
 
-    GLfloat fz = fdx1 * fdy2 - fdx2 * fdy1;
-    /*
-    if (fz == 0)
-        return;
-    fz = 1.0 / fz;
-    */
-    if (fz != 0.0)
+        fz = fdx1 * fdy2 - fdx2 * fdy1;
+        /* the vertices are on whole pixels: there are no sub-pixel triangles,
+           only zero-area ones, which cover nothing */
+        if (fz == 0)
+            return;
         fz = 1.0 / fz;
 
-    fdx1 *= fz;
-    fdy1 *= fz;
-    fdx2 *= fz;
-    fdy2 *= fz;
+        fdx1 *= fz;
+        fdy1 *= fz;
+        fdx2 *= fz;
+        fdy2 *= fz;
 
-    {
-        GLfloat d1, d2;
-#ifdef INTERP_Z
         {
-            d1 = p1->z - p0->z;
-            d2 = p2->z - p0->z;
-            dzdx = (GLint) (fdy2 * d1 - fdy1 * d2);
-            dzdy = (GLint) (fdx1 * d2 - fdx2 * d1);
-        }
+            GLfloat d1, d2;
+#ifdef INTERP_Z
+            {
+                d1 = p1->z - p0->z;
+                d2 = p2->z - p0->z;
+                dzdx = (GLint) (fdy2 * d1 - fdy1 * d2);
+                dzdy = (GLint) (fdx1 * d2 - fdx2 * d1);
+            }
 #endif
 
 #ifdef INTERP_RGB
-        {
-            d1 = p1->r - p0->r;
-            d2 = p2->r - p0->r;
-            drdx = (GLint) (fdy2 * d1 - fdy1 * d2);
-            drdy = (GLint) (fdx1 * d2 - fdx2 * d1);
-        }
-        {
-            d1 = p1->g - p0->g;
-            d2 = p2->g - p0->g;
-            dgdx = (GLint) (fdy2 * d1 - fdy1 * d2);
-            dgdy = (GLint) (fdx1 * d2 - fdx2 * d1);
-        }
-        {
-            d1 = p1->b - p0->b;
-            d2 = p2->b - p0->b;
-            dbdx = (GLint) (fdy2 * d1 - fdy1 * d2);
-            dbdy = (GLint) (fdx1 * d2 - fdx2 * d1);
-        }
+            {
+                d1 = p1->r - p0->r;
+                d2 = p2->r - p0->r;
+                drdx = (GLint) (fdy2 * d1 - fdy1 * d2);
+                drdy = (GLint) (fdx1 * d2 - fdx2 * d1);
+            }
+            {
+                d1 = p1->g - p0->g;
+                d2 = p2->g - p0->g;
+                dgdx = (GLint) (fdy2 * d1 - fdy1 * d2);
+                dgdy = (GLint) (fdx1 * d2 - fdx2 * d1);
+            }
+            {
+                d1 = p1->b - p0->b;
+                d2 = p2->b - p0->b;
+                dbdx = (GLint) (fdy2 * d1 - fdy1 * d2);
+                dbdy = (GLint) (fdx1 * d2 - fdx2 * d1);
+            }
 #endif
 
 #ifdef INTERP_ST
-        {
-            d1 = p1->s - p0->s;
-            d2 = p2->s - p0->s;
-            dsdx = (GLint) (fdy2 * d1 - fdy1 * d2);
-            dsdy = (GLint) (fdx1 * d2 - fdx2 * d1);
-        }
-        {
-            d1 = p1->t - p0->t;
-            d2 = p2->t - p0->t;
-            dtdx = (GLint) (fdy2 * d1 - fdy1 * d2);
-            dtdy = (GLint) (fdx1 * d2 - fdx2 * d1);
-        }
+            {
+                d1 = p1->s - p0->s;
+                d2 = p2->s - p0->s;
+                dsdx = (GLint) (fdy2 * d1 - fdy1 * d2);
+                dsdy = (GLint) (fdx1 * d2 - fdx2 * d1);
+            }
+            {
+                d1 = p1->t - p0->t;
+                d2 = p2->t - p0->t;
+                dtdx = (GLint) (fdy2 * d1 - fdy1 * d2);
+                dtdy = (GLint) (fdx1 * d2 - fdx2 * d1);
+            }
 #endif
 
 #ifdef INTERP_STZ
-        {
-            GLfloat zedzed;
-            zedzed = (GLfloat) p0->z;
-            p0->sz = (GLfloat) p0->s * zedzed;
-            p0->tz = (GLfloat) p0->t * zedzed;
-            zedzed = (GLfloat) p1->z;
-            p1->sz = (GLfloat) p1->s * zedzed;
-            p1->tz = (GLfloat) p1->t * zedzed;
-            zedzed = (GLfloat) p2->z;
-            p2->sz = (GLfloat) p2->s * zedzed;
-            p2->tz = (GLfloat) p2->t * zedzed;
-        }
-        {
-            d1 = p1->sz - p0->sz;
-            d2 = p2->sz - p0->sz;
-            dszdx = (fdy2 * d1 - fdy1 * d2);
-            dszdy = (fdx1 * d2 - fdx2 * d1);
-        }
-        {
-            d1 = p1->tz - p0->tz;
-            d2 = p2->tz - p0->tz;
-            dtzdx = (fdy2 * d1 - fdy1 * d2);
-            dtzdy = (fdx1 * d2 - fdx2 * d1);
-        }
+            {
+                GLfloat zedzed;
+                zedzed = (GLfloat) p0->z;
+                p0->sz = (GLfloat) p0->s * zedzed;
+                p0->tz = (GLfloat) p0->t * zedzed;
+                zedzed = (GLfloat) p1->z;
+                p1->sz = (GLfloat) p1->s * zedzed;
+                p1->tz = (GLfloat) p1->t * zedzed;
+                zedzed = (GLfloat) p2->z;
+                p2->sz = (GLfloat) p2->s * zedzed;
+                p2->tz = (GLfloat) p2->t * zedzed;
+            }
+            {
+                d1 = p1->sz - p0->sz;
+                d2 = p2->sz - p0->sz;
+                dszdx = (fdy2 * d1 - fdy1 * d2);
+                dszdy = (fdx1 * d2 - fdx2 * d1);
+            }
+            {
+                d1 = p1->tz - p0->tz;
+                d2 = p2->tz - p0->tz;
+                dtzdx = (fdy2 * d1 - fdy1 * d2);
+                dtzdy = (fdx1 * d2 - fdx2 * d1);
+            }
 #endif
+        }
+        dxdy01 = ZB_edgeSlope(p1->x - p0->x, p1->y - p0->y);
+        dxdy02 = ZB_edgeSlope(p2->x - p0->x, p2->y - p0->y);
+        dxdy12 = ZB_edgeSlope(p2->x - p1->x, p2->y - p1->y);
     }
     /* screen coordinates */
 
     pp1 = (PIXEL *) (zb->pbuf) + zb->xsize * p0->y;
 #if TGL_HAS(POLYGON_STIPPLE)
     the_y = p0->y;
+#endif
+#if ZB_CLIP_ROWS
+    the_row = p0->y;
 #endif
     pz1 = zb->zbuf + p0->y * zb->xsize;
 
@@ -178,26 +223,27 @@
      I'd also like to figure out if the main while() loop over raster lines can
      be OMP parallelized, but I suspect it isn't worth it.
     */
-    ZBufferPoint *pr1, *pr2, *l1, *l2;
+    ZBufferPoint *pr1, *l1;
     for (part = 0; part < 2; part++) {
         GLint nb_lines;
         {
             register GLint update_left, update_right;
+            register GLint dxdy_left, dxdy_right;
             if (part == 0) {
                 if (fz > 0) {
                     update_left = 1;
                     update_right = 1;
                     l1 = p0;
-                    l2 = p2;
+                    dxdy_left = dxdy02;
                     pr1 = p0;
-                    pr2 = p1;
+                    dxdy_right = dxdy01;
                 } else {
                     update_left = 1;
                     update_right = 1;
                     l1 = p0;
-                    l2 = p1;
+                    dxdy_left = dxdy01;
                     pr1 = p0;
-                    pr2 = p2;
+                    dxdy_right = dxdy02;
                 }
                 nb_lines = p1->y - p0->y;
             } else {
@@ -206,26 +252,20 @@
                     update_left = 0;
                     update_right = 1;
                     pr1 = p1;
-                    pr2 = p2;
+                    dxdy_right = dxdy12;
                 } else {
                     update_left = 1;
                     update_right = 0;
                     l1 = p1;
-                    l2 = p2;
+                    dxdy_left = dxdy12;
                 }
                 nb_lines = p2->y - p1->y + 1;
             }
             /* compute the values for the left edge */
-            /*pr1 and pr2 are not used inside this area.*/
+            /*pr1 is not used inside this area.*/
             if (update_left) {
                 {
-                    register GLint tmp;
-                    dy1 = l2->y - l1->y;
-                    dx1 = l2->x - l1->x;
-                    if (dy1 > 0)
-                        tmp = (dx1 << 16) / dy1;
-                    else
-                        tmp = 0;
+                    register GLint tmp = dxdy_left;
                     x1 = l1->x;
                     error = 0;
                     derror = tmp & 0x0000ffff;
@@ -268,12 +308,7 @@
             /* compute values for the right edge */
 
             if (update_right) { /*Update right tested*/
-                dx2 = (pr2->x - pr1->x);
-                dy2 = (pr2->y - pr1->y); /*LAST USAGE OF PR2*/
-                if (dy2 > 0)
-                    dx2dy2 = (dx2 << 16) / dy2;
-                else
-                    dx2dy2 = 0;
+                dx2dy2 = dxdy_right;
                 x2 = pr1->x << 16; /*LAST USAGE OF PR1*/
             } /*EOF update right*/
         } /*End of lifetime for ZBufferpoints*/
@@ -281,6 +316,53 @@
 
         while (nb_lines > 0) {
             nb_lines--;
+#if TGL_HAS(GUARD_BAND)
+            /* cut the span to the framebuffer; the left edge is restored
+               once it is drawn. A span entirely left of it draws nothing,
+               and is not advanced: its steps could overflow a GLint. */
+            GLint gb_x1 = x1, gb_x2 = x2;
+#ifdef INTERP_Z
+            GLint gb_z1 = z1;
+#endif
+#ifdef INTERP_RGB
+            GLint gb_r1 = r1, gb_g1 = g1, gb_b1 = b1;
+#endif
+#ifdef INTERP_ST
+            GLint gb_s1 = s1, gb_t1 = t1;
+#endif
+#ifdef INTERP_STZ
+            GLfloat gb_sz1 = sz1, gb_tz1 = tz1;
+#endif
+            if (x1 < 0) {
+                int64_t gb_skip = -x1;
+                x1 = 0;
+                if ((x2 >> 16) < 0) {
+                    x2 = -0x10000;
+                } else {
+#ifdef INTERP_Z
+                    z1 = (GLint) (z1 + dzdx * gb_skip);
+#endif
+#ifdef INTERP_RGB
+                    r1 = (GLint) (r1 + drdx * gb_skip);
+                    g1 = (GLint) (g1 + dgdx * gb_skip);
+                    b1 = (GLint) (b1 + dbdx * gb_skip);
+#endif
+#ifdef INTERP_ST
+                    s1 = (GLint) (s1 + dsdx * gb_skip);
+                    t1 = (GLint) (t1 + dtdx * gb_skip);
+#endif
+#ifdef INTERP_STZ
+                    sz1 += dszdx * gb_skip;
+                    tz1 += dtzdx * gb_skip;
+#endif
+                }
+            }
+            if ((x2 >> 16) >= zb->xsize)
+                x2 = (zb->xsize - 1) << 16;
+#endif
+#if ZB_CLIP_ROWS
+            if (the_row >= zb->clip_ymin)
+#endif
 #ifndef DRAW_LINE
             /* generic draw line */
             {
@@ -345,6 +427,26 @@
 #else
             DRAW_LINE();
 #endif
+#if TGL_HAS(GUARD_BAND)
+            x1 = gb_x1;
+#ifdef INTERP_Z
+            z1 = gb_z1;
+#endif
+#ifdef INTERP_RGB
+            r1 = gb_r1;
+            g1 = gb_g1;
+            b1 = gb_b1;
+#endif
+#ifdef INTERP_ST
+            s1 = gb_s1;
+            t1 = gb_t1;
+#endif
+#ifdef INTERP_STZ
+            sz1 = gb_sz1;
+            tz1 = gb_tz1;
+#endif
+            x2 = gb_x2;
+#endif
 
             /* left edge */
             error += derror;
@@ -397,6 +499,10 @@
             the_y++;
 #endif
             pz1 += zb->xsize;
+#if ZB_CLIP_ROWS
+            if (++the_row > zb->clip_ymax)
+                return;
+#endif
         }
     }
 }
@@ -0,0 +1,197 @@
+/*
+ * Batched triangle setup.
+ *
+ * The scanline rasterizer spends a good part of the time it takes to draw a
+ * small triangle on its setup: sorting the vertices, the reciprocal of the
+ * area, the gradients of every interpolated value and the slopes of the
+ * edges. ZB_setupTriangles() computes all of them for a batch of triangles
+ * stored as structures of arrays, with loops written without branches so
+ * that the compiler turns them into SSE2/NEON code working on 4 (or more)
+ * triangles at a time.
+ *
+ * Every value is computed with the very same operations as ztriangle.h, so
+ * that a triangle drawn from its precomputed setup has exactly the pixels it
+ * would have had otherwise.
+ */
+
+#include "msghandling.h"
+#include "zbuffer.h"
+
+#if TGL_HAS(BATCHED_SETUP)
+
+void ZB_addTriangle(ZBufferTriangles *t,
+                    const ZBufferPoint *p0,
+                    const ZBufferPoint *p1,
+                    const ZBufferPoint *p2)
+{
+    const ZBufferPoint *p[3] = {p0, p1, p2};
+    GLint i = t->n++, v;
+
+    for (v = 0; v < 3; v++) {
+        t->x[v][i] = p[v]->x;
+        t->y[v][i] = p[v]->y;
+        t->z[v][i] = p[v]->z;
+        t->s[v][i] = p[v]->s;
+        t->t[v][i] = p[v]->t;
+        t->r[v][i] = p[v]->r;
+        t->g[v][i] = p[v]->g;
+        t->b[v][i] = p[v]->b;
+    }
+}
+
+/*
+ * The vertices are sorted like ztriangle.h does, p1 and p0 first, then p2
+ * into place. sort1 is set when p1 and p0 were swapped, sort2 when p2 went
+ * first, sort3 when it went second.
+ */
+#define ZB_SORT(type, f, f0, f1, f2)                       \
+    {                                                      \
+        type a0 = sort1[i] ? t->f[1][i] : t->f[0][i];      \
+        type a1 = sort1[i] ? t->f[0][i] : t->f[1][i];      \
+        f0 = sort2[i] ? t->f[2][i] : a0;                   \
+        f1 = sort2[i] ? a0 : (sort3[i] ? t->f[2][i] : a1); \
+        f2 = (sort2[i] | sort3[i]) ? a1 : t->f[2][i];      \
+    }
+
+/* df/dx and df/dy from the values of f at the sorted vertices */
+#define ZB_GRADIENT(type, f, dfdx, dfdy)                   \
+    for (i = 0; i < n; i++) {                              \
+        type f0, f1, f2;                                   \
+        GLfloat d1, d2;                                    \
+        ZB_SORT(type, f, f0, f1, f2)                       \
+        d1 = f1 - f0;                                      \
+        d2 = f2 - f0;                                      \
+        t->dfdx[i] = (type) (fdy2[i] * d1 - fdy1[i] * d2); \
+        t->dfdy[i] = (type) (fdx1[i] * d2 - fdx2[i] * d1); \
+    }
+
+/*
+ * The same sort for the integer coordinates, with masks: the loop computing
+ * the area and slopes divides, and GCC does not turn the branches of a loop
+ * that may trap into selects.
+ */
+#define ZB_SORT_MASK(f, fs)                                           \
+    for (i = 0; i < n; i++) {                                         \
+        GLint m1 = -sort1[i], m2 = -sort2[i], m3 = -sort3[i];         \
+        GLint v0 = t->f[0][i], v1 = t->f[1][i], v2 = t->f[2][i];      \
+        GLint a0 = v0 ^ ((v0 ^ v1) & m1), a1 = v1 ^ ((v0 ^ v1) & m1); \
+        GLint b1 = a1 ^ ((a1 ^ v2) & m3);                             \
+        fs[0][i] = a0 ^ ((a0 ^ v2) & m2);                             \
+        fs[1][i] = b1 ^ ((b1 ^ a0) & m2);                             \
+        fs[2][i] = v2 ^ ((v2 ^ a1) & (m2 | m3));                      \
+    }
+
+/*
+ * 16.16 slope of an edge dy >= 0 rows high, 0 when horizontal. The quotient
+ * of a double division truncates like the integer one, and a horizontal edge
+ * divides 0 by 1, so that no lane branches.
+ */
+#define ZB_SLOPE(dx, dy)                              \
+    ((GLint) ((double) ((dx) * 65536 * ((dy) != 0)) / \
+              (double) ((dy) + ((dy) == 0))))
+
+void ZB_setupTriangles(ZBufferTriangles *t, GLint what)
+{
+    GLint sort1[ZB_BATCH_SIZE], sort2[ZB_BATCH_SIZE], sort3[ZB_BATCH_SIZE];
+    GLfloat fdx1[ZB_BATCH_SIZE], fdy1[ZB_BATCH_SIZE];
+    GLfloat fdx2[ZB_BATCH_SIZE], fdy2[ZB_BATCH_SIZE];
+    GLint xs[3][ZB_BATCH_SIZE], ys[3][ZB_BATCH_SIZE];
+    GLint n = (t->n + 3) & ~3, i, v;
+
+    /* the lanes after the last triangle are computed too, and ignored */
+    for (i = t->n; i < n; i++)
+        for (v = 0; v < 3; v++) {
+            t->x[v][i] = t->y[v][i] = t->z[v][i] = 0;
+            t->s[v][i] = t->t[v][i] = 0;
+            t->r[v][i] = t->g[v][i] = t->b[v][i] = 0;
+        }
+
+    for (i = 0; i < n; i++) {
+        GLint y0 = t->y[0][i], y1 = t->y[1][i], y2 = t->y[2][i];
+        GLint ya0 = y1 < y0 ? y1 : y0, ya1 = y1 < y0 ? y0 : y1;
+        sort1[i] = y1 < y0;
+        sort2[i] = y2 < ya0;
+        sort3[i] = !(y2 < ya0) & (y2 < ya1);
+    }
+
+    ZB_SORT_MASK(x, xs)
+    ZB_SORT_MASK(y, ys)
+
+    /* 1 / area, or 0 for an empty triangle, like fz in ztriangle.h */
+    for (i = 0; i < n; i++) {
+        GLfloat fz;
+        fdx1[i] = xs[1][i] - xs[0][i];
+        fdy1[i] = ys[1][i] - ys[0][i];
+        fdx2[i] = xs[2][i] - xs[0][i];
+        fdy2[i] = ys[2][i] - ys[0][i];
+        fz = fdx1[i] * fdy2[i] - fdx2[i] * fdy1[i];
+        fz = (GLfloat) (fz != 0) / (fz + (GLfloat) (fz == 0));
+        t->fz[i] = fz;
+        fdx1[i] *= fz;
+        fdy1[i] *= fz;
+        fdx2[i] *= fz;
+        fdy2[i] *= fz;
+    }
+
+    for (i = 0; i < n; i++) {
+        t->dxdy01[i] = ZB_SLOPE(xs[1][i] - xs[0][i], ys[1][i] - ys[0][i]);
+        t->dxdy02[i] = ZB_SLOPE(xs[2][i] - xs[0][i], ys[2][i] - ys[0][i]);
+        t->dxdy12[i] = ZB_SLOPE(xs[2][i] - xs[1][i], ys[2][i] - ys[1][i]);
+    }
+
+    ZB_GRADIENT(GLint, z, dzdx, dzdy)
+    if (what & ZB_SETUP_RGB) {
+        ZB_GRADIENT(GLint, r, drdx, drdy)
+        ZB_GRADIENT(GLint, g, dgdx, dgdy)
+        ZB_GRADIENT(GLint, b, dbdx, dbdy)
+    }
+    if (what & ZB_SETUP_STZ) {
+        for (v = 0; v < 3; v++)
+            for (i = 0; i < n; i++) {
+                GLfloat zedzed = (GLfloat) t->z[v][i];
+                t->sz[v][i] = (GLfloat) t->s[v][i] * zedzed;
+                t->tz[v][i] = (GLfloat) t->t[v][i] * zedzed;
+            }
+        ZB_GRADIENT(GLfloat, sz, dszdx, dszdy)
+        ZB_GRADIENT(GLfloat, tz, dtzdx, dtzdy)
+    }
+}
+
+void ZB_getTriangle(const ZBufferTriangles *t,
+                    GLint i,
+                    ZBufferPoint *p,
+                    ZBufferSetup *setup)
+{
+    GLint v;
+
+    for (v = 0; v < 3; v++) {
+        p[v].x = t->x[v][i];
+        p[v].y = t->y[v][i];
+        p[v].z = t->z[v][i];
+        p[v].s = t->s[v][i];
+        p[v].t = t->t[v][i];
+        p[v].r = t->r[v][i];
+        p[v].g = t->g[v][i];
+        p[v].b = t->b[v][i];
+        p[v].sz = t->sz[v][i];
+        p[v].tz = t->tz[v][i];
+    }
+    setup->fz = t->fz[i];
+    setup->dzdx = t->dzdx[i];
+    setup->dzdy = t->dzdy[i];
+    setup->drdx = t->drdx[i];
+    setup->drdy = t->drdy[i];
+    setup->dgdx = t->dgdx[i];
+    setup->dgdy = t->dgdy[i];
+    setup->dbdx = t->dbdx[i];
+    setup->dbdy = t->dbdy[i];
+    setup->dszdx = t->dszdx[i];
+    setup->dszdy = t->dszdy[i];
+    setup->dtzdx = t->dtzdx[i];
+    setup->dtzdy = t->dtzdy[i];
+    setup->dxdy01 = t->dxdy01[i];
+    setup->dxdy02 = t->dxdy02[i];
+    setup->dxdy12 = t->dxdy12[i];
+}
+
+#endif /* TGL_HAS(BATCHED_SETUP) */
@@ -0,0 +1,568 @@
+/*
+ * Blended triangle variants, included by ztriangle.c.
+ *
+ * Parameters:
+ *   ZTRI_BLEND_NAME(base, variant) - name of the function of a variant
+ *   ZTRI_BLEND_VARS                - declares zbblendeq, sfactor and dfactor,
+ *                                    for TGL_BLEND_FUNC and TGL_BLEND_FUNC_RGB
+ *
+ * With TGL_BLEND_VARS, the blend state is read from the ZBuffer once per
+ * triangle. With TGL_BLEND_CONST_VARS, it is a constant, and the compiler
+ * removes the switches of the blend functions from the pixel loops.
+ */
+
+/*
+ * ============================================================================
+ * Flat shaded triangle - with blending
+ * ============================================================================
+ */
+
+/* Variant DT0_DW0 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleFlat, _DT0_DW0)(ZBuffer *zb,
+                                                    ZBufferPoint *p0,
+                                                    ZBufferPoint *p1,
+                                                    ZBufferPoint *p2)
+{
+    GLuint color;
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+
+#define DRAW_INIT()                                \
+    {                                              \
+        color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); \
+    }
+
+#define PUT_PIXEL(_a)                                   \
+    {                                                   \
+        /* DT=0: always pass depth test */              \
+        if (1 STIPTEST(_a)) {                           \
+            TGL_BLEND_FUNC(color, (pp[_a]))             \
+            /* DW=0: no depth write */                  \
+        }                                               \
+        z += dzdx;                                      \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT0_DW1 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleFlat, _DT0_DW1)(ZBuffer *zb,
+                                                    ZBufferPoint *p0,
+                                                    ZBufferPoint *p1,
+                                                    ZBufferPoint *p2)
+{
+    GLuint color;
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+
+#define DRAW_INIT()                                \
+    {                                              \
+        color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); \
+    }
+
+#define PUT_PIXEL(_a)                                   \
+    {                                                   \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
+        /* DT=0: always pass depth test */              \
+        if (1 STIPTEST(_a)) {                           \
+            TGL_BLEND_FUNC(color, (pp[_a]))             \
+            /* DW=1: always write depth */              \
+            pz[_a] = zz;                                \
+        }                                               \
+        z += dzdx;                                      \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT1_DW0 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleFlat, _DT1_DW0)(ZBuffer *zb,
+                                                    ZBufferPoint *p0,
+                                                    ZBufferPoint *p1,
+                                                    ZBufferPoint *p2)
+{
+    GLuint color;
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+
+#define DRAW_INIT()                                \
+    {                                              \
+        color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); \
+    }
+
+#define PUT_PIXEL(_a)                                   \
+    {                                                   \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
+        /* DT=1: test depth */                          \
+        if ((zz >= pz[_a]) STIPTEST(_a)) {              \
+            TGL_BLEND_FUNC(color, (pp[_a]))             \
+            /* DW=0: no depth write */                  \
+        }                                               \
+        z += dzdx;                                      \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT1_DW1 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleFlat, _DT1_DW1)(ZBuffer *zb,
+                                                    ZBufferPoint *p0,
+                                                    ZBufferPoint *p1,
+                                                    ZBufferPoint *p2)
+{
+    GLuint color;
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+
+#define DRAW_INIT()                                \
+    {                                              \
+        color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); \
+    }
+
+#define PUT_PIXEL(_a)                                   \
+    {                                                   \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS; \
+        /* DT=1: test depth */                          \
+        if ((zz >= pz[_a]) STIPTEST(_a)) {              \
+            TGL_BLEND_FUNC(color, (pp[_a]))             \
+            /* DW=1: always write depth */              \
+            pz[_a] = zz;                                \
+        }                                               \
+        z += dzdx;                                      \
+    }
+
+#include "ztriangle.h"
+}
+
+/*
+ * ============================================================================
+ * Smooth shaded triangle - with blending
+ * ============================================================================
+ */
+
+/* Variant DT0_DW0 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleSmooth, _DT0_DW0)(ZBuffer *zb,
+                                                      ZBufferPoint *p0,
+                                                      ZBufferPoint *p1,
+                                                      ZBufferPoint *p2)
+{
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+#define INTERP_RGB
+
+#define DRAW_INIT() \
+    {               \
+    }
+
+#define PUT_PIXEL(_a)                                    \
+    {                                                    \
+        if (1 STIPTEST(_a)) {                            \
+            TGL_BLEND_FUNC_RGB(or1, og1, ob1, (pp[_a])); \
+        }                                                \
+        z += dzdx;                                       \
+        og1 += dgdx;                                     \
+        or1 += drdx;                                     \
+        ob1 += dbdx;                                     \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT0_DW1 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleSmooth, _DT0_DW1)(ZBuffer *zb,
+                                                      ZBufferPoint *p0,
+                                                      ZBufferPoint *p1,
+                                                      ZBufferPoint *p2)
+{
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+#define INTERP_RGB
+
+#define DRAW_INIT() \
+    {               \
+    }
+
+#define PUT_PIXEL(_a)                                    \
+    {                                                    \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;  \
+        if (1 STIPTEST(_a)) {                            \
+            TGL_BLEND_FUNC_RGB(or1, og1, ob1, (pp[_a])); \
+            pz[_a] = zz;                                 \
+        }                                                \
+        z += dzdx;                                       \
+        og1 += dgdx;                                     \
+        or1 += drdx;                                     \
+        ob1 += dbdx;                                     \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT1_DW0 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleSmooth, _DT1_DW0)(ZBuffer *zb,
+                                                      ZBufferPoint *p0,
+                                                      ZBufferPoint *p1,
+                                                      ZBufferPoint *p2)
+{
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+#define INTERP_RGB
+
+#define DRAW_INIT() \
+    {               \
+    }
+
+#define PUT_PIXEL(_a)                                    \
+    {                                                    \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;  \
+        if ((zz >= pz[_a]) STIPTEST(_a)) {               \
+            TGL_BLEND_FUNC_RGB(or1, og1, ob1, (pp[_a])); \
+        }                                                \
+        z += dzdx;                                       \
+        og1 += dgdx;                                     \
+        or1 += drdx;                                     \
+        ob1 += dbdx;                                     \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT1_DW1 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleSmooth, _DT1_DW1)(ZBuffer *zb,
+                                                      ZBufferPoint *p0,
+                                                      ZBufferPoint *p1,
+                                                      ZBufferPoint *p2)
+{
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+#define INTERP_RGB
+
+#define DRAW_INIT() \
+    {               \
+    }
+
+#define PUT_PIXEL(_a)                                    \
+    {                                                    \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;  \
+        if ((zz >= pz[_a]) STIPTEST(_a)) {               \
+            TGL_BLEND_FUNC_RGB(or1, og1, ob1, (pp[_a])); \
+            pz[_a] = zz;                                 \
+        }                                                \
+        z += dzdx;                                       \
+        og1 += dgdx;                                     \
+        or1 += drdx;                                     \
+        ob1 += dbdx;                                     \
+    }
+
+#include "ztriangle.h"
+}
+
+/*
+ * ============================================================================
+ * Texture mapped triangle - with blending
+ * ============================================================================
+ */
+
+/* Variant DT0_DW0 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+#undef PUT_PIXEL_TEXTURED
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleMappingPerspective, _DT0_DW0)(
+    ZBuffer *zb,
+    ZBufferPoint *p0,
+    ZBufferPoint *p1,
+    ZBufferPoint *p2)
+{
+    PIXEL *texture;
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+#define INTERP_STZ
+#define INTERP_RGB
+
+#define DRAW_INIT()                    \
+    {                                  \
+        texture = zb->current_texture; \
+        fdzdx = (GLfloat) dzdx;        \
+        fndzdx = NB_INTERP * fdzdx;    \
+        ndszdx = NB_INTERP * dszdx;    \
+        ndtzdx = NB_INTERP * dtzdx;    \
+    }
+
+#define PUT_PIXEL_TEXTURED(_a, _dt, _dw)                                      \
+    {                                                                         \
+        if (1 STIPTEST(_a)) {                                                 \
+            TGL_BLEND_FUNC(                                                   \
+                RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), \
+                (pp[_a]));                                                    \
+        }                                                                     \
+        z += dzdx;                                                            \
+        s += dsdx;                                                            \
+        t += dtdx;                                                            \
+        OR1G1B1INCR                                                           \
+    }
+
+#define DRAW_LINE()                             \
+    {                                           \
+        DRAW_LINE_TRI_TEXTURED(0, /* no-op */;) \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT0_DW1 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+#undef PUT_PIXEL_TEXTURED
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleMappingPerspective, _DT0_DW1)(
+    ZBuffer *zb,
+    ZBufferPoint *p0,
+    ZBufferPoint *p1,
+    ZBufferPoint *p2)
+{
+    PIXEL *texture;
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+#define INTERP_STZ
+#define INTERP_RGB
+
+#define DRAW_INIT()                    \
+    {                                  \
+        texture = zb->current_texture; \
+        fdzdx = (GLfloat) dzdx;        \
+        fndzdx = NB_INTERP * fdzdx;    \
+        ndszdx = NB_INTERP * dszdx;    \
+        ndtzdx = NB_INTERP * dtzdx;    \
+    }
+
+#define PUT_PIXEL_TEXTURED(_a, _dt, _dw)                                      \
+    {                                                                         \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                       \
+        if (1 STIPTEST(_a)) {                                                 \
+            TGL_BLEND_FUNC(                                                   \
+                RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), \
+                (pp[_a]));                                                    \
+            pz[_a] = zz;                                                      \
+        }                                                                     \
+        z += dzdx;                                                            \
+        s += dsdx;                                                            \
+        t += dtdx;                                                            \
+        OR1G1B1INCR                                                           \
+    }
+
+#define DRAW_LINE()                             \
+    {                                           \
+        DRAW_LINE_TRI_TEXTURED(0, pz[_a] = zz;) \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT1_DW0 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+#undef PUT_PIXEL_TEXTURED
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleMappingPerspective, _DT1_DW0)(
+    ZBuffer *zb,
+    ZBufferPoint *p0,
+    ZBufferPoint *p1,
+    ZBufferPoint *p2)
+{
+    PIXEL *texture;
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+#define INTERP_STZ
+#define INTERP_RGB
+
+#define DRAW_INIT()                    \
+    {                                  \
+        texture = zb->current_texture; \
+        fdzdx = (GLfloat) dzdx;        \
+        fndzdx = NB_INTERP * fdzdx;    \
+        ndszdx = NB_INTERP * dszdx;    \
+        ndtzdx = NB_INTERP * dtzdx;    \
+    }
+
+#define PUT_PIXEL_TEXTURED(_a, _dt, _dw)                                      \
+    {                                                                         \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                       \
+        if ((zz >= pz[_a]) STIPTEST(_a)) {                                    \
+            TGL_BLEND_FUNC(                                                   \
+                RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), \
+                (pp[_a]));                                                    \
+        }                                                                     \
+        z += dzdx;                                                            \
+        s += dsdx;                                                            \
+        t += dtdx;                                                            \
+        OR1G1B1INCR                                                           \
+    }
+
+#define DRAW_LINE()                             \
+    {                                           \
+        DRAW_LINE_TRI_TEXTURED(1, /* no-op */;) \
+    }
+
+#include "ztriangle.h"
+}
+
+/* Variant DT1_DW1 */
+#undef INTERP_Z
+#undef INTERP_RGB
+#undef INTERP_ST
+#undef INTERP_STZ
+#undef DRAW_INIT
+#undef PUT_PIXEL
+#undef DRAW_LINE
+#undef PUT_PIXEL_TEXTURED
+
+void ZTRI_BLEND_NAME(ZB_fillTriangleMappingPerspective, _DT1_DW1)(
+    ZBuffer *zb,
+    ZBufferPoint *p0,
+    ZBufferPoint *p1,
+    ZBufferPoint *p2)
+{
+    PIXEL *texture;
+    ZTRI_BLEND_VARS
+    TGL_STIPPLEVARS
+
+#define INTERP_Z
+#define INTERP_STZ
+#define INTERP_RGB
+
+#define DRAW_INIT()                    \
+    {                                  \
+        texture = zb->current_texture; \
+        fdzdx = (GLfloat) dzdx;        \
+        fndzdx = NB_INTERP * fdzdx;    \
+        ndszdx = NB_INTERP * dszdx;    \
+        ndtzdx = NB_INTERP * dtzdx;    \
+    }
+
+#define PUT_PIXEL_TEXTURED(_a, _dt, _dw)                                      \
+    {                                                                         \
+        register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                       \
+        if ((zz >= pz[_a]) STIPTEST(_a)) {                                    \
+            TGL_BLEND_FUNC(                                                   \
+                RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), \
+                (pp[_a]));                                                    \
+            pz[_a] = zz;                                                      \
+        }                                                                     \
+        z += dzdx;                                                            \
+        s += dsdx;                                                            \
+        t += dtdx;                                                            \
+        OR1G1B1INCR                                                           \
+    }
+
+#define DRAW_LINE()                             \
+    {                                           \
+        DRAW_LINE_TRI_TEXTURED(1, pz[_a] = zz;) \
+    }
+
+#include "ztriangle.h"
+}
+
+#undef ZTRI_BLEND_NAME
+#undef ZTRI_BLEND_VARS
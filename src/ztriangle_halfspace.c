@@ -0,0 +1,354 @@
+/*
+ * Half-space triangle rasterizer.
+ *
+ * Alternative to the scanline rasterizer of ztriangle.c for flat and smooth
+ * shaded triangles: the bounding box is walked in blocks of 4 pixels, and the
+ * three edge functions, depth and color are evaluated for a whole block at
+ * once with SSE2 or NEON (or plain C when neither is available). The variants
+ * are generated from ztriangle_halfspace.h for every depth test/depth write
+ * combination, and are gathered in zb_triangle_dispatch_halfspace.
+ *
+ * Textured triangles keep using the scanline rasterizer, whose perspective
+ * correction is already done in blocks of 8 pixels.
+ */
+
+#include <stdlib.h>
+#include "msghandling.h"
+#include "zbuffer.h"
+#include "zsimd.h"
+#include "ztriangle_variants.h"
+
+#if TGL_HAS(HALFSPACE_RASTER)
+
+#if TGL_HAS(POLYGON_STIPPLE)
+/* lane i is all ones when bit i is set */
+static const GLint hs_lane_mask[16][4] = {
+    {0, 0, 0, 0},   {-1, 0, 0, 0},   {0, -1, 0, 0},   {-1, -1, 0, 0},
+    {0, 0, -1, 0},  {-1, 0, -1, 0},  {0, -1, -1, 0},  {-1, -1, -1, 0},
+    {0, 0, 0, -1},  {-1, 0, 0, -1},  {0, -1, 0, -1},  {-1, -1, 0, -1},
+    {0, 0, -1, -1}, {-1, 0, -1, -1}, {0, -1, -1, -1}, {-1, -1, -1, -1}};
+#endif
+
+/* number of bits set in a lane mask */
+static const GLubyte hs_lane_count[16] = {0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4};
+
+/*
+ * Edge functions are evaluated in 32-bit integers; triangles with a vertex
+ * further away from the origin are handed to the scanline rasterizer.
+ */
+#define HS_COORD_LIMIT (1 << 13)
+#define HS_IN_RANGE(p)                                          \
+    ((GLuint) ((p)->x + HS_COORD_LIMIT) < 2 * HS_COORD_LIMIT && \
+     (GLuint) ((p)->y + HS_COORD_LIMIT) < 2 * HS_COORD_LIMIT)
+
+/*
+ * ============================================================================
+ * Flat shaded triangle - with blending
+ * ============================================================================
+ */
+
+static void ZB_fillTriangleHalfspaceFlat_DT0_DW0(ZBuffer *zb,
+                                                 ZBufferPoint *p0,
+                                                 ZBufferPoint *p1,
+                                                 ZBufferPoint *p2)
+{
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 1
+#define HS_FALLBACK zb_triangle_dispatch_scanline.flat[ZTRI_BLEND_GENERIC][0]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceFlat_DT0_DW1(ZBuffer *zb,
+                                                 ZBufferPoint *p0,
+                                                 ZBufferPoint *p1,
+                                                 ZBufferPoint *p2)
+{
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 1
+#define HS_FALLBACK zb_triangle_dispatch_scanline.flat[ZTRI_BLEND_GENERIC][1]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceFlat_DT1_DW0(ZBuffer *zb,
+                                                 ZBufferPoint *p0,
+                                                 ZBufferPoint *p1,
+                                                 ZBufferPoint *p2)
+{
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 1
+#define HS_FALLBACK zb_triangle_dispatch_scanline.flat[ZTRI_BLEND_GENERIC][2]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceFlat_DT1_DW1(ZBuffer *zb,
+                                                 ZBufferPoint *p0,
+                                                 ZBufferPoint *p1,
+                                                 ZBufferPoint *p2)
+{
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 1
+#define HS_FALLBACK zb_triangle_dispatch_scanline.flat[ZTRI_BLEND_GENERIC][3]
+#include "ztriangle_halfspace.h"
+}
+
+/*
+ * ============================================================================
+ * Flat shaded triangle - without blending
+ * ============================================================================
+ */
+
+static void ZB_fillTriangleHalfspaceFlatNOBLEND_DT0_DW0(ZBuffer *zb,
+                                                        ZBufferPoint *p0,
+                                                        ZBufferPoint *p1,
+                                                        ZBufferPoint *p2)
+{
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.flat_noblend[0]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceFlatNOBLEND_DT0_DW1(ZBuffer *zb,
+                                                        ZBufferPoint *p0,
+                                                        ZBufferPoint *p1,
+                                                        ZBufferPoint *p2)
+{
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.flat_noblend[1]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceFlatNOBLEND_DT1_DW0(ZBuffer *zb,
+                                                        ZBufferPoint *p0,
+                                                        ZBufferPoint *p1,
+                                                        ZBufferPoint *p2)
+{
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.flat_noblend[2]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceFlatNOBLEND_DT1_DW1(ZBuffer *zb,
+                                                        ZBufferPoint *p0,
+                                                        ZBufferPoint *p1,
+                                                        ZBufferPoint *p2)
+{
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.flat_noblend[3]
+#include "ztriangle_halfspace.h"
+}
+
+/*
+ * ============================================================================
+ * Smooth shaded triangle - with blending
+ * ============================================================================
+ */
+
+static void ZB_fillTriangleHalfspaceSmooth_DT0_DW0(ZBuffer *zb,
+                                                   ZBufferPoint *p0,
+                                                   ZBufferPoint *p1,
+                                                   ZBufferPoint *p2)
+{
+#define HS_INTERP_RGB
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 1
+#define HS_FALLBACK zb_triangle_dispatch_scanline.smooth[ZTRI_BLEND_GENERIC][0]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceSmooth_DT0_DW1(ZBuffer *zb,
+                                                   ZBufferPoint *p0,
+                                                   ZBufferPoint *p1,
+                                                   ZBufferPoint *p2)
+{
+#define HS_INTERP_RGB
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 1
+#define HS_FALLBACK zb_triangle_dispatch_scanline.smooth[ZTRI_BLEND_GENERIC][1]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceSmooth_DT1_DW0(ZBuffer *zb,
+                                                   ZBufferPoint *p0,
+                                                   ZBufferPoint *p1,
+                                                   ZBufferPoint *p2)
+{
+#define HS_INTERP_RGB
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 1
+#define HS_FALLBACK zb_triangle_dispatch_scanline.smooth[ZTRI_BLEND_GENERIC][2]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceSmooth_DT1_DW1(ZBuffer *zb,
+                                                   ZBufferPoint *p0,
+                                                   ZBufferPoint *p1,
+                                                   ZBufferPoint *p2)
+{
+#define HS_INTERP_RGB
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 1
+#define HS_FALLBACK zb_triangle_dispatch_scanline.smooth[ZTRI_BLEND_GENERIC][3]
+#include "ztriangle_halfspace.h"
+}
+
+/*
+ * ============================================================================
+ * Smooth shaded triangle - without blending
+ * ============================================================================
+ */
+
+static void ZB_fillTriangleHalfspaceSmoothNOBLEND_DT0_DW0(ZBuffer *zb,
+                                                          ZBufferPoint *p0,
+                                                          ZBufferPoint *p1,
+                                                          ZBufferPoint *p2)
+{
+#define HS_INTERP_RGB
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.smooth_noblend[0]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceSmoothNOBLEND_DT0_DW1(ZBuffer *zb,
+                                                          ZBufferPoint *p0,
+                                                          ZBufferPoint *p1,
+                                                          ZBufferPoint *p2)
+{
+#define HS_INTERP_RGB
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.smooth_noblend[1]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceSmoothNOBLEND_DT1_DW0(ZBuffer *zb,
+                                                          ZBufferPoint *p0,
+                                                          ZBufferPoint *p1,
+                                                          ZBufferPoint *p2)
+{
+#define HS_INTERP_RGB
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.smooth_noblend[2]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceSmoothNOBLEND_DT1_DW1(ZBuffer *zb,
+                                                          ZBufferPoint *p0,
+                                                          ZBufferPoint *p1,
+                                                          ZBufferPoint *p2)
+{
+#define HS_INTERP_RGB
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.smooth_noblend[3]
+#include "ztriangle_halfspace.h"
+}
+
+/*
+ * ============================================================================
+ * Samples passed - occlusion queries
+ * ============================================================================
+ */
+
+static void ZB_fillTriangleHalfspaceSamples_DT0(ZBuffer *zb,
+                                                ZBufferPoint *p0,
+                                                ZBufferPoint *p1,
+                                                ZBufferPoint *p2)
+{
+#define HS_SAMPLES
+#define HS_DEPTH_TEST 0
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.samples[0]
+#include "ztriangle_halfspace.h"
+}
+
+static void ZB_fillTriangleHalfspaceSamples_DT1(ZBuffer *zb,
+                                                ZBufferPoint *p0,
+                                                ZBufferPoint *p1,
+                                                ZBufferPoint *p2)
+{
+#define HS_SAMPLES
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 0
+#define HS_BLEND 0
+#define HS_FALLBACK zb_triangle_dispatch_scanline.samples[1]
+#include "ztriangle_halfspace.h"
+}
+
+/*
+ * ============================================================================
+ * Depth only - depth prepass
+ * ============================================================================
+ */
+
+static void ZB_fillTriangleHalfspaceDepth(ZBuffer *zb,
+                                          ZBufferPoint *p0,
+                                          ZBufferPoint *p1,
+                                          ZBufferPoint *p2)
+{
+#define HS_DEPTH_ONLY
+#define HS_DEPTH_TEST 1
+#define HS_DEPTH_WRITE 1
+#define HS_BLEND 0
+#define HS_FALLBACK ZB_fillTriangleDepth
+#include "ztriangle_halfspace.h"
+}
+
+/*
+ * ============================================================================
+ * Dispatch table initialization
+ * ============================================================================
+ */
+
+/*
+ * The blended variants take the blend state from the ZBuffer, and stand for
+ * every blend mode.
+ */
+#define HS_FLAT_VARIANTS(name, eq, sf, df) \
+    , ZTRI_VARIANTS(ZB_fillTriangleHalfspaceFlat)
+#define HS_SMOOTH_VARIANTS(name, eq, sf, df) \
+    , ZTRI_VARIANTS(ZB_fillTriangleHalfspaceSmooth)
+#define HS_TEXTURED_VARIANTS(name, eq, sf, df) \
+    , ZTRI_VARIANTS(ZB_fillTriangleMappingPerspective_##name)
+
+const ZB_TriangleDispatch zb_triangle_dispatch_halfspace = {
+    .flat = {ZTRI_VARIANTS(ZB_fillTriangleHalfspaceFlat)
+                 ZTRI_BLEND_MODES(HS_FLAT_VARIANTS)},
+    .flat_noblend = ZTRI_VARIANTS(ZB_fillTriangleHalfspaceFlatNOBLEND),
+    .smooth = {ZTRI_VARIANTS(ZB_fillTriangleHalfspaceSmooth)
+                   ZTRI_BLEND_MODES(HS_SMOOTH_VARIANTS)},
+    .smooth_noblend = ZTRI_VARIANTS(ZB_fillTriangleHalfspaceSmoothNOBLEND),
+    /* textured triangles are left to the scanline rasterizer */
+    .textured = {ZTRI_VARIANTS(ZB_fillTriangleMappingPerspective)
+                     ZTRI_BLEND_MODES(HS_TEXTURED_VARIANTS)},
+    .textured_noblend =
+        ZTRI_VARIANTS(ZB_fillTriangleMappingPerspectiveNOBLEND),
+    .samples = ZTRI_SAMPLES_VARIANTS(ZB_fillTriangleHalfspaceSamples),
+    .samples_textured = ZTRI_SAMPLES_VARIANTS(ZB_fillTriangleSamples),
+    .depth = ZB_fillTriangleHalfspaceDepth,
+    .depth_textured = ZB_fillTriangleDepth};
+
+#endif /* TGL_HAS(HALFSPACE_RASTER) */
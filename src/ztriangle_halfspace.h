@@ -0,0 +1,355 @@
+/*
+ * Half-space (edge function) triangle rasterizer template.
+ *
+ * Instead of walking the left and right edges, the three edge functions are
+ * evaluated for blocks of 4 horizontally adjacent pixels of the bounding box.
+ * A pixel is covered when all three are non-negative; the sign bits give a
+ * 4-bit coverage mask which is then narrowed by the depth test, and drives the
+ * color and depth writes.
+ *
+ * Parameters (all must be defined to 0 or 1, except HS_INTERP_RGB,
+ * HS_SAMPLES and HS_DEPTH_ONLY):
+ *   HS_INTERP_RGB   - interpolate the color (smooth), else use p2's color
+ *   HS_SAMPLES      - draw nothing, count the pixels passing into
+ *                     zb->samples_passed (occlusion queries)
+ *   HS_DEPTH_ONLY   - write the depth and no color (depth prepass)
+ *   HS_DEPTH_TEST   - test against the depth buffer
+ *   HS_DEPTH_WRITE  - write the depth buffer
+ *   HS_BLEND        - blend with the framebuffer
+ *   HS_FALLBACK     - scanline variant for triangles out of HS_IN_RANGE
+ */
+
+#if defined(HS_SAMPLES) || defined(HS_DEPTH_ONLY)
+#define HS_NO_COLOR
+#endif
+
+{
+    ZBufferPoint *e1 = p1, *e2 = p2;
+    GLint area, xmin, xmax, ymin, ymax, x, y;
+    /* steps of the edge functions along x (a) and y (b) */
+    GLint a0, b0, a1, b1, a2, b2;
+    GLint w0_row, w1_row, w2_row;
+    GLfloat inv_a0, inv_a1, inv_a2;
+#if TGL_HAS(SMALL_TRIANGLES)
+    GLint small;
+#endif
+    zv_vec w0_ramp, w1_ramp, w2_ramp, w0_step, w1_step, w2_step;
+    GLfloat fdx1, fdy1, fdx2, fdy2, fz;
+#if HS_DEPTH_TEST || HS_DEPTH_WRITE
+    GLfloat fdzdx, fdzdy;
+    zv_vec z_ramp, z_step;
+#endif
+#ifdef HS_INTERP_RGB
+    GLfloat fdrdx, fdrdy, fdgdx, fdgdy, fdbdx, fdbdy;
+    zv_vec r_ramp, g_ramp, b_ramp, r_step, g_step, b_step;
+#elif !defined(HS_NO_COLOR)
+    PIXEL color = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
+#if TGL_FEATURE_RENDER_BITS == 32 && !HS_BLEND
+    zv_vec vcolor = ZV_SET1(color);
+#endif
+#endif
+#if HS_BLEND
+    TGL_BLEND_VARS
+#endif
+#if TGL_HAS(POLYGON_STIPPLE)
+    GLubyte *zbstipplepattern = zb->stipplepattern;
+    GLubyte zbdostipple = zb->dostipple;
+#endif
+
+    if (!(HS_IN_RANGE(p0) && HS_IN_RANGE(p1) && HS_IN_RANGE(p2))) {
+        HS_FALLBACK(zb, p0, p1, p2);
+        return;
+    }
+
+    area = (p1->x - p0->x) * (p2->y - p0->y) - (p2->x - p0->x) * (p1->y - p0->y);
+    if (area == 0)
+        return;
+    /* make the edges counter-clockwise so that the inside is positive */
+    if (area < 0) {
+        e1 = p2;
+        e2 = p1;
+    }
+
+    xmin = ymin = 0x7fffffff;
+    xmax = ymax = -0x7fffffff;
+#define HS_BBOX(p)      \
+    if (p->x < xmin)    \
+        xmin = p->x;    \
+    if (p->x > xmax)    \
+        xmax = p->x;    \
+    if (p->y < ymin)    \
+        ymin = p->y;    \
+    if (p->y > ymax)    \
+        ymax = p->y;
+    HS_BBOX(p0)
+    HS_BBOX(p1)
+    HS_BBOX(p2)
+#undef HS_BBOX
+    if (xmin < 0)
+        xmin = 0;
+    if (xmax > zb->xsize - 1)
+        xmax = zb->xsize - 1;
+#if ZB_CLIP_ROWS
+    if (ymin < zb->clip_ymin)
+        ymin = zb->clip_ymin;
+    if (ymax > zb->clip_ymax)
+        ymax = zb->clip_ymax;
+#else
+    if (ymin < 0)
+        ymin = 0;
+    if (ymax > zb->ysize - 1)
+        ymax = zb->ysize - 1;
+#endif
+    if (xmin > xmax || ymin > ymax)
+        return;
+    /* blocks start on a multiple of 4; xsize is one too, so none crosses a
+     * row */
+    xmin &= ~3;
+
+    /* w0 is opposite to p0 (edge e1->e2), w1 to e1, w2 to e2 */
+    a0 = e1->y - e2->y;
+    b0 = e2->x - e1->x;
+    a1 = e2->y - p0->y;
+    b1 = p0->x - e2->x;
+    a2 = p0->y - e1->y;
+    b2 = e1->x - p0->x;
+    w0_row = b0 * (ymin - e1->y) + a0 * (xmin - e1->x);
+    w1_row = b1 * (ymin - e2->y) + a1 * (xmin - e2->x);
+    w2_row = b2 * (ymin - p0->y) + a2 * (xmin - p0->x);
+    w0_ramp = ZV_RAMP(a0);
+    w1_ramp = ZV_RAMP(a1);
+    w2_ramp = ZV_RAMP(a2);
+#if TGL_HAS(SMALL_TRIANGLES)
+    /* the rows of a small triangle are a single block: the edge functions of
+       the block are enough, there is no span to solve */
+    small = xmax - xmin < 4;
+    if (!small)
+#endif
+    {
+        inv_a0 = a0 ? 1.0f / a0 : 0;
+        inv_a1 = a1 ? 1.0f / a1 : 0;
+        inv_a2 = a2 ? 1.0f / a2 : 0;
+    }
+    w0_step = ZV_SET1(a0 * 4);
+    w1_step = ZV_SET1(a1 * 4);
+    w2_step = ZV_SET1(a2 * 4);
+
+    /* the same gradients as the scanline rasterizer */
+    fdx1 = p1->x - p0->x;
+    fdy1 = p1->y - p0->y;
+    fdx2 = p2->x - p0->x;
+    fdy2 = p2->y - p0->y;
+    fz = 1.0f / (GLfloat) area;
+    fdx1 *= fz;
+    fdy1 *= fz;
+    fdx2 *= fz;
+    fdy2 *= fz;
+#define HS_GRADIENT(f, dfdx, dfdy)            \
+    {                                         \
+        GLfloat d1 = p1->f - p0->f;           \
+        GLfloat d2 = p2->f - p0->f;           \
+        dfdx = fdy2 * d1 - fdy1 * d2;         \
+        dfdy = fdx1 * d2 - fdx2 * d1;         \
+    }
+/* value of f at the first block of row y */
+#define HS_ROW_VALUE(f, dfdx, dfdy) \
+    ((GLint) ((GLfloat) p0->f + dfdx * (xl - p0->x) + dfdy * (y - p0->y)))
+/*
+ * narrow xl..xr to where w + a * (x - xmin) >= 0. The float reciprocal may
+ * be off by a pixel, so the bounds are widened by one: the edge test of the
+ * blocks has the final word.
+ */
+#define HS_ROW_SPAN(w, a, inv_a)                               \
+    if (a > 0) {                                               \
+        if (w < 0) {                                           \
+            GLint xe = xmin + (GLint) ((GLfloat) -w * inv_a); \
+            if (xe > xl)                                       \
+                xl = xe;                                       \
+        }                                                      \
+    } else if (w < 0) {                                        \
+        xr = -1;                                               \
+    } else if (a < 0) {                                        \
+        GLint xe = xmin + (GLint) ((GLfloat) w * -inv_a) + 1;  \
+        if (xe < xr)                                           \
+            xr = xe;                                           \
+    }
+#if HS_DEPTH_TEST || HS_DEPTH_WRITE
+    HS_GRADIENT(z, fdzdx, fdzdy)
+    z_ramp = ZV_RAMP((GLint) fdzdx);
+    z_step = ZV_SET1((GLint) fdzdx * 4);
+#endif
+#ifdef HS_INTERP_RGB
+    HS_GRADIENT(r, fdrdx, fdrdy)
+    HS_GRADIENT(g, fdgdx, fdgdy)
+    HS_GRADIENT(b, fdbdx, fdbdy)
+    r_ramp = ZV_RAMP((GLint) fdrdx);
+    g_ramp = ZV_RAMP((GLint) fdgdx);
+    b_ramp = ZV_RAMP((GLint) fdbdx);
+    r_step = ZV_SET1((GLint) fdrdx * 4);
+    g_step = ZV_SET1((GLint) fdgdx * 4);
+    b_step = ZV_SET1((GLint) fdbdx * 4);
+#endif
+
+    for (y = ymin; y <= ymax; y++) {
+#ifndef HS_NO_COLOR
+        PIXEL *pp;
+#endif
+        GLushort *pz;
+        zv_vec w0, w1, w2;
+#if HS_DEPTH_TEST || HS_DEPTH_WRITE
+        zv_vec z;
+#endif
+#ifdef HS_INTERP_RGB
+        zv_vec r, g, b;
+#endif
+        /* covered pixels of the row, solved from the edge functions */
+        GLint xl = xmin, xr = xmax;
+
+#if TGL_HAS(SMALL_TRIANGLES)
+        if (!small)
+#endif
+        {
+            HS_ROW_SPAN(w0_row, a0, inv_a0)
+            HS_ROW_SPAN(w1_row, a1, inv_a1)
+            HS_ROW_SPAN(w2_row, a2, inv_a2)
+            if (xl > xr)
+                goto next_row;
+            xl &= ~3;
+        }
+
+#ifndef HS_NO_COLOR
+        pp = zb->pbuf + y * zb->xsize + xl;
+#endif
+        pz = zb->zbuf + y * zb->xsize + xl;
+        w0 = ZV_ADD(ZV_SET1(w0_row + a0 * (xl - xmin)), w0_ramp);
+        w1 = ZV_ADD(ZV_SET1(w1_row + a1 * (xl - xmin)), w1_ramp);
+        w2 = ZV_ADD(ZV_SET1(w2_row + a2 * (xl - xmin)), w2_ramp);
+#if HS_DEPTH_TEST || HS_DEPTH_WRITE
+        z = ZV_ADD(ZV_SET1(HS_ROW_VALUE(z, fdzdx, fdzdy)), z_ramp);
+#endif
+#ifdef HS_INTERP_RGB
+        r = ZV_ADD(ZV_SET1(HS_ROW_VALUE(r, fdrdx, fdrdy)), r_ramp);
+        g = ZV_ADD(ZV_SET1(HS_ROW_VALUE(g, fdgdx, fdgdy)), g_ramp);
+        b = ZV_ADD(ZV_SET1(HS_ROW_VALUE(b, fdbdx, fdbdy)), b_ramp);
+#endif
+
+        for (x = xl; x <= xr; x += 4) {
+            /* lanes that must not be drawn are all ones: outside of an edge, */
+            zv_vec fail = ZV_SRAI(ZV_OR(ZV_OR(w0, w1), w2), 31);
+            GLint mask;
+#if HS_DEPTH_TEST || HS_DEPTH_WRITE
+            zv_vec zz = ZV_SRLI(z, ZB_POINT_Z_FRAC_BITS);
+#endif
+#if HS_DEPTH_TEST
+            /* behind the depth buffer, */
+            zv_vec zold = zv_load_z(pz);
+            fail = ZV_OR(fail, ZV_CMPGT(zold, zz));
+#elif HS_DEPTH_WRITE && TGL_FEATURE_RENDER_BITS == 32 && !HS_BLEND
+            zv_vec zold = zv_load_z(pz);
+#endif
+#if TGL_HAS(POLYGON_STIPPLE)
+            /* or off in the stipple pattern */
+            if (zbdostipple) {
+                GLint i, off = 0;
+                for (i = 0; i < 4; i++) {
+                    GLint xs = (x + i) & TGL_POLYGON_STIPPLE_MASK_X;
+                    GLint ys = y & TGL_POLYGON_STIPPLE_MASK_Y;
+                    GLint bit = xs | (ys << TGL_POLYGON_STIPPLE_POW2_WIDTH);
+                    if (!(zbstipplepattern[bit >> 3] & (1 << (xs & 7))))
+                        off |= 1 << i;
+                }
+                fail = ZV_OR(fail, ZV_LOAD(hs_lane_mask[off]));
+            }
+#endif
+            mask = ZV_MOVEMASK(fail) ^ 0xf;
+#ifdef HS_SAMPLES
+            zb->samples_passed += hs_lane_count[mask];
+#elif defined(HS_DEPTH_ONLY)
+            if (mask)
+                zv_store_z(pz, ZV_SELECT(fail, zold, zz));
+#else
+            if (mask) {
+#if TGL_FEATURE_RENDER_BITS == 32 && !HS_BLEND
+#ifdef HS_INTERP_RGB
+                zv_vec color =
+                    ZV_OR(ZV_OR(ZV_AND(r, ZV_SET1(0xff0000)),
+                                ZV_AND(ZV_SRLI(g, 8), ZV_SET1(0xff00))),
+                          ZV_AND(ZV_SRLI(b, 16), ZV_SET1(0xff)));
+                ZV_STORE(pp, ZV_SELECT(fail, ZV_LOAD(pp), color));
+#else
+                ZV_STORE(pp, ZV_SELECT(fail, ZV_LOAD(pp), vcolor));
+#endif
+#if HS_DEPTH_WRITE
+                zv_store_z(pz, ZV_SELECT(fail, zold, zz));
+#endif
+#else
+                GLint i;
+#if HS_DEPTH_WRITE
+                GLint lz[4];
+#endif
+#ifdef HS_INTERP_RGB
+                GLint lr[4], lg[4], lb[4];
+                ZV_STORE(lr, r);
+                ZV_STORE(lg, g);
+                ZV_STORE(lb, b);
+#endif
+#if HS_DEPTH_WRITE
+                ZV_STORE(lz, zz);
+#endif
+                for (i = 0; i < 4; i++) {
+                    if (!(mask & (1 << i)))
+                        continue;
+#ifdef HS_INTERP_RGB
+#if HS_BLEND
+                    TGL_BLEND_FUNC_RGB(lr[i], lg[i], lb[i], pp[i]);
+#else
+                    pp[i] = RGB_TO_PIXEL(lr[i], lg[i], lb[i]);
+#endif
+#else
+#if HS_BLEND
+                    TGL_BLEND_FUNC(color, pp[i]);
+#else
+                    pp[i] = color;
+#endif
+#endif
+#if HS_DEPTH_WRITE
+                    pz[i] = lz[i];
+#endif
+                }
+#endif
+            }
+#endif
+            w0 = ZV_ADD(w0, w0_step);
+            w1 = ZV_ADD(w1, w1_step);
+            w2 = ZV_ADD(w2, w2_step);
+#if HS_DEPTH_TEST || HS_DEPTH_WRITE
+            z = ZV_ADD(z, z_step);
+#endif
+#ifdef HS_INTERP_RGB
+            r = ZV_ADD(r, r_step);
+            g = ZV_ADD(g, g_step);
+            b = ZV_ADD(b, b_step);
+#endif
+#ifndef HS_NO_COLOR
+            pp += 4;
+#endif
+            pz += 4;
+        }
+    next_row:
+        w0_row += b0;
+        w1_row += b1;
+        w2_row += b2;
+    }
+#undef HS_GRADIENT
+#undef HS_ROW_VALUE
+#undef HS_ROW_SPAN
+}
+
+#undef HS_INTERP_RGB
+#undef HS_SAMPLES
+#undef HS_DEPTH_ONLY
+#undef HS_NO_COLOR
+#undef HS_DEPTH_TEST
+#undef HS_DEPTH_WRITE
+#undef HS_BLEND
+#undef HS_FALLBACK
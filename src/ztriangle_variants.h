@@ -71,6 +71,34 @@
 #define ZTRI_VARIANT_INDEX(dt, dw) (((dt) << 1) | (dw))
 #define ZTRI_VARIANT_COUNT 4
 
+/*
+ * Blend modes with variants of their own: X(name, equation, sfactor, dfactor),
+ * with the factors and equation as the blend functions of zbuffer.h tell them
+ * apart. Every other mode uses the ZTRI_BLEND_GENERIC variants, which switch
+ * on the blend state for every pixel. Each mode of the list is instantiated
+ * from ztriangle_blend.h in ztriangle.c.
+ */
+#if TGL_HAS(BLEND) && TGL_HAS(BLEND_MODE_VARIANTS)
+#define ZTRI_BLEND_MODES(X)                                     \
+    X(ADD_ONE_ONE, GL_FUNC_ADD, GL_ONE, GL_ONE)                 \
+    X(ADD_INV_ONE, GL_FUNC_ADD, GL_ONE_MINUS_SRC_COLOR, GL_ONE) \
+    X(ADD_ONE_INV, GL_FUNC_ADD, GL_ONE, GL_ONE_MINUS_DST_COLOR) \
+    X(REVSUB_ONE_ONE, GL_FUNC_REVERSE_SUBTRACT, GL_ONE, GL_ONE)
+#else
+#define ZTRI_BLEND_MODES(X)
+#endif
+
+/* Index of the blend variants in the dispatch tables. */
+#define ZTRI_BLEND_ENUM(name, eq, sf, df) ZTRI_BLEND_##name,
+enum {
+    ZTRI_BLEND_GENERIC,
+    ZTRI_BLEND_MODES(ZTRI_BLEND_ENUM) ZTRI_BLEND_VARIANT_COUNT
+};
+#undef ZTRI_BLEND_ENUM
+
+/* Blending is off, or leaves the source color as is. */
+#define ZTRI_BLEND_NONE (-1)
+
 /*
  * ZB_fillTriangleFunc is defined in zbuffer.h
  * We use it for the dispatch table below.
@@ -80,18 +108,75 @@
  * Dispatch table structure for each shading mode.
  */
 typedef struct {
-    ZB_fillTriangleFunc flat[ZTRI_VARIANT_COUNT];
+    ZB_fillTriangleFunc flat[ZTRI_BLEND_VARIANT_COUNT][ZTRI_VARIANT_COUNT];
     ZB_fillTriangleFunc flat_noblend[ZTRI_VARIANT_COUNT];
-    ZB_fillTriangleFunc smooth[ZTRI_VARIANT_COUNT];
+    ZB_fillTriangleFunc smooth[ZTRI_BLEND_VARIANT_COUNT][ZTRI_VARIANT_COUNT];
     ZB_fillTriangleFunc smooth_noblend[ZTRI_VARIANT_COUNT];
-    ZB_fillTriangleFunc textured[ZTRI_VARIANT_COUNT];
+    ZB_fillTriangleFunc textured[ZTRI_BLEND_VARIANT_COUNT][ZTRI_VARIANT_COUNT];
     ZB_fillTriangleFunc textured_noblend[ZTRI_VARIANT_COUNT];
+    /*
+     * Occlusion queries: count the pixels of a triangle passing the depth
+     * test, indexed by depth_test. The textured ones cover the same pixels as
+     * the textured variants.
+     */
+    ZB_fillTriangleFunc samples[2];
+    ZB_fillTriangleFunc samples_textured[2];
+    /*
+     * Depth prepass: write the depth of the pixels of a triangle passing the
+     * depth test, and nothing else. The same pixels as the DT1 variants get
+     * the same depth.
+     */
+    ZB_fillTriangleFunc depth;
+    ZB_fillTriangleFunc depth_textured;
 } ZB_TriangleDispatch;
 
+/* The 4 variants of a base function, in dispatch table order. */
+#define ZTRI_VARIANTS(base) \
+    {base##_DT0_DW0, base##_DT0_DW1, base##_DT1_DW0, base##_DT1_DW1}
+#define ZTRI_SAMPLES_VARIANTS(base) {base##_DT0, base##_DT1}
+
+/*
+ * Dispatch tables. The scanline rasterizer is defined in ztriangle.c, the
+ * half-space one in ztriangle_halfspace.c. zb_triangle_dispatch points to the
+ * one selected with ZB_setTriangleRasterizer().
+ */
+extern const ZB_TriangleDispatch zb_triangle_dispatch_scanline;
+#if TGL_HAS(HALFSPACE_RASTER)
+extern const ZB_TriangleDispatch zb_triangle_dispatch_halfspace;
+#endif
+extern const ZB_TriangleDispatch *zb_triangle_dispatch;
+
 /*
- * Global dispatch table (defined in ztriangle.c)
+ * Prototypes of the 4 variants of a base function, for the tables that share
+ * them.
  */
-extern ZB_TriangleDispatch zb_triangle_dispatch;
+#define ZTRI_DECLARE_VARIANTS(base)                                       \
+    void base##_DT0_DW0(ZBuffer *, ZBufferPoint *, ZBufferPoint *,        \
+                        ZBufferPoint *);                                  \
+    void base##_DT0_DW1(ZBuffer *, ZBufferPoint *, ZBufferPoint *,        \
+                        ZBufferPoint *);                                  \
+    void base##_DT1_DW0(ZBuffer *, ZBufferPoint *, ZBufferPoint *,        \
+                        ZBufferPoint *);                                  \
+    void base##_DT1_DW1(ZBuffer *, ZBufferPoint *, ZBufferPoint *,        \
+                        ZBufferPoint *);
+void ZB_fillTriangleSamples_DT0(ZBuffer *,
+                                ZBufferPoint *,
+                                ZBufferPoint *,
+                                ZBufferPoint *);
+void ZB_fillTriangleSamples_DT1(ZBuffer *,
+                                ZBufferPoint *,
+                                ZBufferPoint *,
+                                ZBufferPoint *);
+void ZB_fillTriangleDepth(ZBuffer *,
+                          ZBufferPoint *,
+                          ZBufferPoint *,
+                          ZBufferPoint *);
+ZTRI_DECLARE_VARIANTS(ZB_fillTriangleMappingPerspective)
+ZTRI_DECLARE_VARIANTS(ZB_fillTriangleMappingPerspectiveNOBLEND)
+#define ZTRI_DECLARE_TEXTURED(name, eq, sf, df) \
+    ZTRI_DECLARE_VARIANTS(ZB_fillTriangleMappingPerspective_##name)
+ZTRI_BLEND_MODES(ZTRI_DECLARE_TEXTURED)
+#undef ZTRI_DECLARE_TEXTURED
 
 /*
  * Inline dispatch function for selecting the right variant.
@@ -104,4 +189,36 @@ static inline ZB_fillTriangleFunc ZB_getTriangleFunc(
     return table[ZTRI_VARIANT_INDEX(depth_test != 0, depth_write != 0)];
 }
 
+/*
+ * Blend variant for the current blend state of zb, or ZTRI_BLEND_NONE when the
+ * variants without blending draw the same pixels.
+ */
+static inline GLint ZB_getBlendVariant(const ZBuffer *zb)
+{
+#if TGL_HAS(BLEND)
+    GLuint eq = zb->blendeq, sf = zb->sfactor, df = zb->dfactor;
+
+    if (!zb->enable_blend)
+        return ZTRI_BLEND_NONE;
+    /* the blend functions take anything else for GL_ONE and GL_FUNC_ADD */
+    if (sf != GL_ONE_MINUS_SRC_COLOR && sf != GL_ZERO)
+        sf = GL_ONE;
+    if (df != GL_ONE_MINUS_DST_COLOR && df != GL_ZERO)
+        df = GL_ONE;
+    if (eq != GL_FUNC_SUBTRACT && eq != GL_FUNC_REVERSE_SUBTRACT)
+        eq = GL_FUNC_ADD;
+    if (eq == GL_FUNC_ADD && sf == GL_ONE && df == GL_ZERO)
+        return ZTRI_BLEND_NONE;
+#define ZTRI_BLEND_MATCH(name, e, s, d)      \
+    if (eq == (e) && sf == (s) && df == (d)) \
+        return ZTRI_BLEND_##name;
+    ZTRI_BLEND_MODES(ZTRI_BLEND_MATCH)
+#undef ZTRI_BLEND_MATCH
+    return ZTRI_BLEND_GENERIC;
+#else
+    (void) zb;
+    return ZTRI_BLEND_NONE;
+#endif
+}
+
 #endif /* ZTRIANGLE_VARIANTS_H */
@@ -597,6 +597,2180 @@ int main(void) {
     return 0;
 }"
 
+# Test: glFinish leaves every triangle in the framebuffer
+run_test "api_finish" "$API_HEADER
+static int is_red(int x, int y) {
+    PIXEL p = zb->pbuf[y * zb->xsize + x];
+    return (p & 0xf00000) == 0xf00000 && (p & 0xffff) == 0;
+}
+int main(void) {
+    setup();
+
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glColor3f(1, 0, 0);
+    glBegin(GL_TRIANGLES);
+    glVertex3f(-0.9f, -0.9f, 0); glVertex3f(0.9f, -0.9f, 0); glVertex3f(0, 0.9f, 0);
+    glEnd();
+    glFinish();
+
+    /* rows near the apex, the middle and the base are all drawn */
+    if (!is_red(64, 12) || !is_red(64, 64) || !is_red(64, 118)) return 1;
+    if (is_red(2, 2)) return 1;
+
+    teardown();
+    return 0;
+}"
+
+# Test: the half-space rasterizer draws what the scanline one draws
+run_test "api_halfspace_raster" "$API_HEADER
+#include <string.h>
+static PIXEL ref[128 * 128];
+static void draw(void) {
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glShadeModel(GL_SMOOTH);
+    glBegin(GL_TRIANGLES);
+    /* near, smooth shaded */
+    glColor3f(1, 0, 0); glVertex3f(-0.9f, -0.9f, -0.5f);
+    glColor3f(0, 1, 0); glVertex3f(0.9f, -0.8f, -0.5f);
+    glColor3f(0, 0, 1); glVertex3f(0.1f, 0.9f, -0.5f);
+    /* far, mostly hidden */
+    glColor3f(1, 1, 1); glVertex3f(-0.8f, 0.8f, 0.5f);
+    glVertex3f(0.8f, -0.2f, 0.5f); glVertex3f(0.9f, 0.9f, 0.5f);
+    glEnd();
+    glFinish();
+}
+int main(void) {
+    int i, diff = 0;
+    setup();
+
+    draw();
+    memcpy(ref, zb->pbuf, sizeof(ref));
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_HALFSPACE);
+    draw();
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_SCANLINE);
+
+    /* only pixels along the edges may differ */
+    for (i = 0; i < 128 * 128; i++)
+        if (zb->pbuf[i] != ref[i])
+            diff++;
+    if (diff > 128 * 4) return 1;
+    if (zb->pbuf[64 * 128 + 64] != ref[64 * 128 + 64]) return 1;
+
+    teardown();
+    return 0;
+}"
+
+# Test: hidden triangles are skipped, depth writes without test reopen them
+run_test "api_hierarchical_z" "$API_HEADER
+static PIXEL center(void) { return zb->pbuf[64 * 128 + 64] & 0xf0f0f0; }
+static void tri(GLfloat z) {
+    glBegin(GL_TRIANGLES);
+    glVertex3f(-0.8f, -0.8f, z); glVertex3f(0.8f, -0.8f, z); glVertex3f(0, 0.8f, z);
+    glEnd();
+}
+int main(void) {
+    setup();
+
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glColor3f(1, 0, 0);
+    glBegin(GL_QUADS);
+    glVertex3f(-1, -1, -0.5f); glVertex3f(1, -1, -0.5f);
+    glVertex3f(1, 1, -0.5f); glVertex3f(-1, 1, -0.5f);
+    glEnd();
+    glColor3f(0, 0, 1);
+    tri(0);
+    glFinish();
+    if (center() != 0xf00000) return 1;
+
+    /* push the depth back without testing, then draw in between */
+    glDisable(GL_DEPTH_TEST);
+    glColor3f(0, 1, 0);
+    tri(0.5f);
+    glEnable(GL_DEPTH_TEST);
+    glColor3f(0, 0, 1);
+    tri(0);
+    glFinish();
+    if (center() != 0x0000f0) return 1;
+
+    teardown();
+    return 0;
+}"
+
+# Test: spans partially failing the depth test keep the hidden pixels
+run_test "api_span_depth_mask" "$API_HEADER
+int main(void) {
+    int x, y;
+    GLushort z0;
+    setup();
+
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    /* a slanted red quad, crossed halfway by a blue triangle */
+    glColor3f(1, 0, 0);
+    glBegin(GL_QUADS);
+    glVertex3f(-1, -1, 0.9f); glVertex3f(1, -1, -0.9f);
+    glVertex3f(1, 1, -0.9f); glVertex3f(-1, 1, 0.9f);
+    glEnd();
+    glColor3f(0, 0, 1);
+    glBegin(GL_TRIANGLES);
+    glVertex3f(-1, -1, 0); glVertex3f(1, -1, 0); glVertex3f(1, 1, 0);
+    glEnd();
+    glFinish();
+
+    /* inside the triangle, each row goes from blue to red exactly once, and
+       the blue pixels are the ones holding the depth of the triangle */
+    z0 = zb->zbuf[120 * 128 + 20];
+    for (y = 8; y < 120; y++) {
+        PIXEL *row = zb->pbuf + y * 128;
+        int switched = 0;
+        for (x = 127 - y + 4; x < 124; x++) {
+            PIXEL c = row[x] & 0xf0f0f0;
+            if (c == 0xf00000)
+                switched = 1;
+            else if (c != 0x0000f0 || switched)
+                return 1;
+            if ((c == 0x0000f0) != (zb->zbuf[y * 128 + x] == z0))
+                return 1;
+        }
+        if (!switched)
+            return 1;
+    }
+
+    teardown();
+    return 0;
+}"
+
+# Test: blend modes with variants of their own, and the replacing blend mode
+run_test "api_blend_modes" "$API_HEADER
+#include <string.h>
+static PIXEL center(void) { return zb->pbuf[64 * 128 + 64]; }
+static int near(PIXEL p, int v) {
+    int r = (p >> 16) & 0xff, g = (p >> 8) & 0xff, b = p & 0xff;
+    return abs(r - v) <= 3 && abs(g - v) <= 3 && abs(b - v) <= 3;
+}
+static void quad(GLfloat v) {
+    glColor3f(v, v, v);
+    glBegin(GL_QUADS);
+    glVertex3f(-1, -1, 0); glVertex3f(1, -1, 0);
+    glVertex3f(1, 1, 0); glVertex3f(-1, 1, 0);
+    glEnd();
+}
+static void tri(void) {
+    glBegin(GL_TRIANGLES);
+    glColor3f(1, 0, 0); glVertex3f(-0.9f, -0.8f, 0);
+    glColor3f(0, 1, 0); glVertex3f(0.8f, -0.6f, 0);
+    glColor3f(0, 0, 1); glVertex3f(0, 0.9f, 0);
+    glEnd();
+}
+int main(void) {
+    static PIXEL ref[128 * 128];
+    setup();
+
+#if TGL_HAS(BLEND)
+    glClearColor(0.2f, 0.2f, 0.2f, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    quad(0.4f);
+    glFinish();
+    if (!near(center(), 153)) return 1;
+
+    glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+    quad(0.4f);
+    glFinish();
+    if (!near(center(), 51)) return 1;
+
+    /* GL_ONE, GL_ZERO replaces the pixels like no blending at all */
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_ONE, GL_ZERO);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    tri();
+    glFinish();
+    memcpy(ref, zb->pbuf, sizeof(ref));
+    glDisable(GL_BLEND);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    tri();
+    glFinish();
+    if (memcmp(ref, zb->pbuf, sizeof(ref))) return 1;
+#endif
+
+    teardown();
+    return 0;
+}"
+
+# Test: occlusion queries count the pixels drawn, on both rasterizers
+run_test "api_occlusion_query" "$API_HEADER
+#include <string.h>
+static PIXEL before[128 * 128];
+static void tri(GLfloat z) {
+    glBegin(GL_TRIANGLES);
+    glVertex3f(-0.7f, -0.9f, z); glVertex3f(0.9f, -0.3f, z);
+    glVertex3f(-0.2f, 0.8f, z);
+    glEnd();
+}
+/* pixels drawn by a proxy triangle at depth z, and its query result */
+static int proxy(GLuint q, GLfloat z, GLfloat g, GLuint *result) {
+    int i, n = 0;
+    glFinish();
+    memcpy(before, zb->pbuf, sizeof(before));
+    glBeginQuery(GL_SAMPLES_PASSED, q);
+    glColor3f(0, g, 1 - g);
+    tri(z);
+    glEndQuery(GL_SAMPLES_PASSED);
+    glFinish();
+    for (i = 0; i < 128 * 128; i++)
+        if (zb->pbuf[i] != before[i])
+            n++;
+    glGetQueryObjectuiv(q, GL_QUERY_RESULT, result);
+    return n;
+}
+static int run(GLuint q) {
+    GLuint result, avail = 0;
+    int n;
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glColor3f(1, 0, 0);
+    glBegin(GL_QUADS);
+    glVertex3f(-0.5f, -0.5f, 0); glVertex3f(0.5f, -0.5f, 0);
+    glVertex3f(0.5f, 0.5f, 0); glVertex3f(-0.5f, 0.5f, 0);
+    glEnd();
+
+    /* partly hidden by the quad */
+    glDepthMask(GL_FALSE);
+    n = proxy(q, 0.5f, 1, &result);
+    if (n == 0 || result != (GLuint) n) return 1;
+    glGetQueryObjectuiv(q, GL_QUERY_RESULT_AVAILABLE, &avail);
+    if (avail != GL_TRUE) return 1;
+    /* in front of it */
+    n = proxy(q, -0.5f, 0, &result);
+    if (n < 128 * 128 / 4 || result != (GLuint) n) return 1;
+    /* without depth test, everything passes */
+    glDisable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT);
+    n = proxy(q, 0.9f, 1, &result);
+    if (result != (GLuint) n) return 1;
+    glDepthMask(GL_TRUE);
+    return 0;
+}
+int main(void) {
+    GLuint q[2];
+    GLint cur = -1;
+    setup();
+
+    glClearColor(0, 0, 0, 0);
+    glGenQueries(2, q);
+    if (!glIsQuery(q[0]) || !glIsQuery(q[1]) || q[0] == q[1]) return 1;
+    if (run(q[0])) return 1;
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_HALFSPACE);
+    if (run(q[1])) return 1;
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_SCANLINE);
+
+    /* a triangle entirely behind the quad passes nothing */
+    glEnable(GL_DEPTH_TEST);
+    glBeginQuery(GL_SAMPLES_PASSED, q[0]);
+    glGetQueryiv(GL_SAMPLES_PASSED, GL_CURRENT_QUERY, &cur);
+    if (cur != (GLint) q[0]) return 1;
+    glBegin(GL_TRIANGLES);
+    glVertex3f(-0.4f, -0.4f, 0.5f); glVertex3f(0.4f, -0.4f, 0.5f);
+    glVertex3f(0, 0.4f, 0.5f);
+    glEnd();
+    glEndQuery(GL_SAMPLES_PASSED);
+    {
+        GLuint result = 1;
+        glGetQueryObjectuiv(q[0], GL_QUERY_RESULT, &result);
+        if (result != 0) return 1;
+    }
+    glDeleteQueries(2, q);
+    if (glIsQuery(q[0])) return 1;
+
+    teardown();
+    return 0;
+}"
+
+# Test: triangles reaching past the framebuffer, with and without guard band
+run_test "api_guard_band" "$API_HEADER
+static void quad(GLfloat e) {
+    glBegin(GL_QUADS);
+    glColor3f(0, 0, 0); glVertex3f(-e, -e, 0);
+    glColor3f(1, 1, 1); glVertex3f(e, -e, 0);
+    glColor3f(1, 1, 1); glVertex3f(e, e, 0);
+    glColor3f(0, 0, 0); glVertex3f(-e, e, 0);
+    glEnd();
+}
+int main(void) {
+    int x, y;
+    setup();
+
+    /* the spans cut to the framebuffer keep their interpolants: each row
+       goes from 1/3 to 2/3 of the way between black and white */
+    glClearColor(1, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glShadeModel(GL_SMOOTH);
+    quad(3);
+    glFinish();
+    for (y = 0; y < 128; y++) {
+        PIXEL *row = zb->pbuf + y * 128;
+        for (x = 0; x < 128; x++) {
+            int g = (row[x] >> 8) & 0xff, v = 85 + x * 85 / 127;
+            if (g < v - 4 || g > v + 4 || (x && g < ((row[x - 1] >> 8) & 0xff)))
+                return 1;
+        }
+    }
+
+    /* a viewport smaller than the framebuffer is still clipped */
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(32, 32, 64, 64);
+    quad(3);
+    glFinish();
+    for (y = 0; y < 128; y++)
+        for (x = 0; x < 128; x++) {
+            int in = x >= 32 && x < 96 && y >= 32 && y < 96;
+            if (((zb->pbuf[y * 128 + x] & 0xffffff) == 0xff0000) == in)
+                return 1;
+        }
+
+    teardown();
+    return 0;
+}"
+
+# Test: textured triangles past the framebuffer draw as the clipped ones do
+run_test "api_guard_band_textured" "$API_HEADER
+#include <string.h>
+#define TEX_SIZE 256
+static PIXEL a[128 * 128], b[128 * 128];
+/* a perspective floor, in a framebuffer w wide and a 128 x 128 viewport */
+static void draw(int w, PIXEL *out) {
+    static unsigned char pixels[TEX_SIZE * TEX_SIZE * 3];
+    GLuint tex;
+    int i, y;
+    zb = ZB_open(w, 128, ZB_MODE_RGBA, NULL);
+    if (!zb) exit(1);
+    glInit(zb);
+    glViewport(0, 0, 128, 128);
+    for (i = 0; i < TEX_SIZE * TEX_SIZE; i++)
+        memset(pixels + i * 3, ((i / 32) ^ (i / (32 * TEX_SIZE))) & 1 ? 255 : 0, 3);
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, 3, TEX_SIZE, TEX_SIZE, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glFrustum(-1, 1, -1, 1, 1, 100);
+    glMatrixMode(GL_MODELVIEW);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 0); glVertex3f(-4, -1, -1.5f);
+    glTexCoord2f(1, 0); glVertex3f(4, -1, -1.5f);
+    glTexCoord2f(1, 1); glVertex3f(4, -1, -30);
+    glTexCoord2f(0, 1); glVertex3f(-4, -1, -30);
+    glEnd();
+    glFinish();
+    for (y = 0; y < 128; y++)
+        memcpy(out + y * 128, zb->pbuf + y * w, 128 * sizeof(PIXEL));
+    glDeleteTextures(1, &tex);
+    teardown();
+}
+int main(void) {
+    /* the viewport covers the framebuffer, or leaves it room: clipped */
+    draw(128, a);
+    draw(160, b);
+    return memcmp(a, b, sizeof(a)) != 0;
+}"
+
+# Test: a mesh of triangles of a few pixels has no cracks, on both rasterizers
+run_test "api_small_triangles" "$API_HEADER
+static int check(void) {
+    int i, j, x, y;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBegin(GL_TRIANGLES);
+    for (j = 0; j < 32; j++)
+        for (i = 0; i < 32; i++) {
+            /* corners of cell (i, j), moved by up to a pixel inside the grid */
+            GLfloat cx[4], cy[4];
+            int k;
+            for (k = 0; k < 4; k++) {
+                int u = i + (k & 1), v = j + (k >> 1);
+                int in = u > 0 && u < 32 && v > 0 && v < 32;
+                cx[k] = 16 + u * 3 + (in ? (u * 7 + v * 3) % 3 - 1 : 0);
+                cy[k] = 16 + v * 3 + (in ? (u * 5 + v * 11) % 3 - 1 : 0);
+            }
+            glColor3f(i / 32.0f, j / 32.0f, 1);
+            glVertex2f(cx[0], cy[0]); glVertex2f(cx[1], cy[1]);
+            glVertex2f(cx[3], cy[3]);
+            glColor3f(1, i / 32.0f, j / 32.0f);
+            glVertex2f(cx[0], cy[0]); glVertex2f(cx[3], cy[3]);
+            glVertex2f(cx[2], cy[2]);
+        }
+    glEnd();
+    glFinish();
+    for (y = 0; y < 128; y++)
+        for (x = 0; x < 128; x++) {
+            int lit = (zb->pbuf[y * 128 + x] & 0xffffff) != 0;
+            if (x >= 18 && x < 110 && y >= 18 && y < 110 && !lit)
+                return 1;
+            if ((x < 15 || x > 113 || y < 15 || y > 113) && lit)
+                return 1;
+        }
+    return 0;
+}
+/* isolated triangles, with edges 1 to 4 pixels high and steep or shallow */
+static int count(void) {
+    int i, n = 0;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBegin(GL_TRIANGLES);
+    for (i = 0; i < 196; i++) {
+        int x = 4 + i % 14 * 9, y = 4 + i / 14 * 9;
+        glVertex2f(x + i % 5, y);
+        glVertex2f(x + 5 - i % 3, y + 1 + i % 4);
+        glVertex2f(x + i / 7 % 3, y + 4 - i / 3 % 4);
+    }
+    glEnd();
+    glFinish();
+    for (i = 0; i < 128 * 128; i++)
+        n += (zb->pbuf[i] & 0xffffff) != 0;
+    return n;
+}
+int main(void) {
+    setup();
+
+    glClearColor(0, 0, 0, 0);
+    /* one unit per pixel */
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glTranslatef(-1, -1, 0);
+    glScalef(2 / 128.0f, 2 / 128.0f, 1);
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_SCANLINE);
+    glShadeModel(GL_SMOOTH);
+    if (check()) return 1;
+    glShadeModel(GL_FLAT);
+    if (check()) return 1;
+    /* as many pixels as when every edge and span is solved in full */
+    if (count() != 1354) return 1;
+#if TGL_HAS(HALFSPACE_RASTER)
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_HALFSPACE);
+    if (count() != 1370) return 1;
+    if (check()) return 1;
+    glShadeModel(GL_SMOOTH);
+    if (check()) return 1;
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_SCANLINE);
+#endif
+
+    teardown();
+    return 0;
+}"
+
+# Test: triangles set up in batches draw the pixels they draw one by one
+run_test "api_batched_setup" "$API_HEADER
+#include <string.h>
+#define TEX_SIZE 256
+static unsigned seed;
+static int rnd(int n) {
+    seed = seed * 1103515245u + 12345u;
+    return (int) ((seed >> 8) % (unsigned) n);
+}
+/* 150 triangles of every size up to 38 pixels in one glBegin */
+static GLuint draw(PIXEL *out) {
+    GLuint q, samples = 0;
+    int i, v;
+    seed = 1;
+    glGenQueries(1, &q);
+    glBeginQuery(GL_SAMPLES_PASSED, q);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBegin(GL_TRIANGLES);
+    for (i = 0; i < 150; i++) {
+        int k = 2 + rnd(4) * rnd(13), x = rnd(128 - k), y = rnd(128 - k);
+        GLfloat p[3][2];
+        for (v = 0; v < 3; v++) {
+            p[v][0] = x + rnd(k);
+            p[v][1] = y + rnd(k);
+        }
+        if ((p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) ==
+            (p[2][0] - p[0][0]) * (p[1][1] - p[0][1]))
+            p[2][0] += 1;
+        if ((p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) <
+            (p[2][0] - p[0][0]) * (p[1][1] - p[0][1])) {
+            GLfloat t0 = p[1][0], t1 = p[1][1];
+            p[1][0] = p[2][0]; p[1][1] = p[2][1];
+            p[2][0] = t0; p[2][1] = t1;
+        }
+        for (v = 0; v < 3; v++) {
+            glColor4f(rnd(256) / 255.0f, rnd(256) / 255.0f,
+                      rnd(256) / 255.0f, 0.5f);
+            glTexCoord2f(rnd(256) / 64.0f, rnd(256) / 64.0f);
+            glVertex3f(p[v][0], p[v][1], rnd(100) / 100.0f - 0.5f);
+        }
+    }
+    glEnd();
+    glEndQuery(GL_SAMPLES_PASSED);
+    glFinish();
+    glGetQueryObjectuiv(q, GL_QUERY_RESULT, &samples);
+    glDeleteQueries(1, &q);
+    memcpy(out, zb->pbuf, 128 * 128 * sizeof(PIXEL));
+    return samples;
+}
+/* the same pixels as triangles set up one by one: back faces drawn as
+   lines, even if culled, keep them out of the batch. They also turn the
+   guard band off, so the triangles stay inside of the framebuffer. */
+static int check(void) {
+    static PIXEL a[128 * 128], b[128 * 128];
+    GLuint na = draw(a), nb;
+    glPolygonMode(GL_BACK, GL_LINE);
+    nb = draw(b);
+    glPolygonMode(GL_BACK, GL_FILL);
+    return na == 0 || na != nb || memcmp(a, b, sizeof(a)) != 0;
+}
+int main(void) {
+    static unsigned char pixels[TEX_SIZE * TEX_SIZE * 3];
+    GLuint tex;
+    int i;
+
+    setup();
+
+    for (i = 0; i < (int)sizeof(pixels); i++) pixels[i] = (i * 17) & 0xFF;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, 3, TEX_SIZE, TEX_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    glClearColor(0, 0, 0, 0);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glTranslatef(-1, -1, 0);
+    glScalef(2 / 128.0f, 2 / 128.0f, 1);
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_SCANLINE);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glShadeModel(GL_FLAT);
+    if (check()) return 1;
+    glShadeModel(GL_SMOOTH);
+    if (check()) return 1;
+    glEnable(GL_TEXTURE_2D);
+    if (check()) return 1;
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (check()) return 1;
+    glDisable(GL_TEXTURE_2D);
+    if (check()) return 1;
+    glDisable(GL_BLEND);
+
+    teardown();
+    return 0;
+}
+"
+
+# Test: the depth prepass draws the pixels the triangles draw one by one
+run_test "api_depth_prepass" "$API_HEADER
+#include <string.h>
+#define TEX_SIZE 256
+static unsigned seed;
+static int rnd(int n) {
+    seed = seed * 1103515245u + 12345u;
+    return (int) ((seed >> 8) % (unsigned) n);
+}
+/* overlapping triangles, each drawn twice at the same depth in another
+   color, of every kind and with a few blended ones in between */
+static void draw(PIXEL *out) {
+    int i, v, k;
+    seed = 1;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (i = 0; i < 120; i++) {
+        GLfloat x[3], y[3], z[3];
+        int kind = rnd(4);
+        for (v = 0; v < 3; v++) {
+            x[v] = rnd(180) - 26;
+            y[v] = rnd(180) - 26;
+            z[v] = rnd(100) / 100.0f - 0.5f;
+        }
+        if (kind == 0) glEnable(GL_TEXTURE_2D);
+        glShadeModel(kind == 1 ? GL_FLAT : GL_SMOOTH);
+        if (kind == 3) glEnable(GL_BLEND);
+        glBegin(GL_TRIANGLES);
+        for (k = 0; k < 2; k++)
+            for (v = 0; v < 3; v++) {
+                glColor4f(rnd(256) / 255.0f, rnd(256) / 255.0f,
+                          rnd(256) / 255.0f, 0.5f);
+                glTexCoord2f(rnd(256) / 64.0f, rnd(256) / 64.0f);
+                glVertex3f(x[v], y[v], z[v]);
+            }
+        glEnd();
+        glDisable(GL_TEXTURE_2D);
+        glDisable(GL_BLEND);
+        if (i == 60) {
+            glBegin(GL_LINES);
+            glVertex3f(0, 0, 0); glVertex3f(128, 128, 0);
+            glEnd();
+        }
+    }
+    glFinish();
+    memcpy(out, zb->pbuf, 128 * 128 * sizeof(PIXEL));
+}
+static int check(void) {
+    static PIXEL a[128 * 128], b[128 * 128];
+    GLint on = 0;
+    draw(a);
+    glEnable(GL_DEPTH_PREPASS_TGL);
+    glGetIntegerv(GL_DEPTH_PREPASS_TGL, &on);
+    draw(b);
+    glDisable(GL_DEPTH_PREPASS_TGL);
+    return !on || memcmp(a, b, sizeof(a)) != 0;
+}
+int main(void) {
+    static unsigned char pixels[TEX_SIZE * TEX_SIZE * 3];
+    GLuint tex;
+    int i;
+
+    setup();
+
+    for (i = 0; i < (int)sizeof(pixels); i++) pixels[i] = (i * 17) & 0xFF;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, 3, TEX_SIZE, TEX_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    glClearColor(0, 0, 0, 0);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glTranslatef(-1, -1, 0);
+    glScalef(2 / 128.0f, 2 / 128.0f, 1);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_DEPTH_TEST);
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_SCANLINE);
+    if (check()) return 1;
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_HALFSPACE);
+    if (check()) return 1;
+    ZB_setTriangleRasterizer(ZB_RASTERIZER_SCANLINE);
+
+    /* the triangles wait for the frame to be finished */
+    glEnable(GL_DEPTH_PREPASS_TGL);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBegin(GL_TRIANGLES);
+    glColor3f(1, 1, 1);
+    glVertex3f(10, 10, 0); glVertex3f(100, 10, 0); glVertex3f(10, 100, 0);
+    glEnd();
+    if (zb->pbuf[107 * 128 + 20] & 0xffffff) return 1;
+    glFinish();
+    if (!(zb->pbuf[107 * 128 + 20] & 0xffffff)) return 1;
+
+    teardown();
+    return 0;
+}
+"
+
+# Test: glDrawArrays draws the elements glArrayElement draws one by one
+run_test "api_draw_arrays" "$API_HEADER
+#include <string.h>
+#define N 300
+static GLfloat pos[N * 4], col[N * 4], nrm[N * 3], tex[N * 2];
+static unsigned seed;
+static GLfloat rndf(void) {
+    seed = seed * 1103515245u + 12345u;
+    return (GLfloat) ((seed >> 8) & 0xffff) / 65535.0f;
+}
+/* the elements of a display list are drawn one by one by glArrayElement */
+static int check(GLuint list, GLenum mode, GLint size) {
+    static PIXEL a[128 * 128];
+    glVertexPointer(size, GL_FLOAT, 0, pos);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDrawArrays(mode, 5, N - 7);
+    memcpy(a, zb->pbuf, sizeof(a));
+    glNewList(list, GL_COMPILE);
+    glDrawArrays(mode, 5, N - 7);
+    glEndList();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glCallList(list);
+    return memcmp(a, zb->pbuf, sizeof(a)) != 0;
+}
+static int check_modes(void) {
+    static const GLenum modes[] = {GL_POINTS, GL_LINES, GL_LINE_STRIP,
+                                   GL_TRIANGLES, GL_TRIANGLE_STRIP,
+                                   GL_TRIANGLE_FAN, GL_QUADS, GL_QUAD_STRIP};
+    GLuint i, list = glGenLists(1);
+    for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (check(list, modes[i], 3) || check(list, modes[i], 2) ||
+            check(list, modes[i], 4))
+            return 1;
+    }
+    return 0;
+}
+int main(void) {
+    GLfloat light[4] = {0.3f, 0.5f, 1, 0};
+    int i;
+
+    setup();
+
+    seed = 1;
+    for (i = 0; i < N * 4; i++) {
+        pos[i] = rndf() * 2.6f - 1.3f;
+        col[i] = rndf();
+    }
+    for (i = 0; i < N; i++) pos[i * 4 + 3] = 1;
+    for (i = 0; i < N * 3; i++) nrm[i] = rndf() * 2 - 1;
+    for (i = 0; i < N * 2; i++) tex[i] = rndf();
+
+    glEnable(GL_DEPTH_TEST);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorPointer(4, GL_FLOAT, 0, col);
+    if (check_modes()) return 1;
+
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, 0, nrm);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, 0, tex);
+    glMatrixMode(GL_PROJECTION);
+    glFrustum(-1, 1, -1, 1, 1, 10);
+    glMatrixMode(GL_MODELVIEW);
+    glTranslatef(0.1f, -0.2f, -2.5f);
+    glRotatef(30, 1, 1, 0);
+    if (check_modes()) return 1;
+
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glLightfv(GL_LIGHT0, GL_POSITION, light);
+    glEnable(GL_NORMALIZE);
+    glEnable(GL_COLOR_MATERIAL);
+    if (check_modes()) return 1;
+    glDisable(GL_COLOR_MATERIAL);
+    glDisableClientState(GL_COLOR_ARRAY);
+    if (check_modes()) return 1;
+
+    teardown();
+    return 0;
+}
+"
+
+# Test: glDrawElements draws the elements glArrayElement draws one by one
+run_test "api_draw_elements" "$API_HEADER
+#include <string.h>
+#define NV 100
+#define NI 600
+static GLfloat pos[NV * 3], col[NV * 4], nrm[NV * 3];
+static GLubyte ib[NI];
+static GLushort is[NI];
+static GLuint ii[NI];
+static unsigned seed;
+static int rnd(int n) {
+    seed = seed * 1103515245u + 12345u;
+    return (int) ((seed >> 8) % (unsigned) n);
+}
+/* the indices of a display list are drawn one by one by glArrayElement */
+static int check(GLenum mode, GLenum type, const void *indices) {
+    static PIXEL a[128 * 128];
+    GLuint list = glGenLists(1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDrawElements(mode, NI - 1, type, indices);
+    memcpy(a, zb->pbuf, sizeof(a));
+    glNewList(list, GL_COMPILE);
+    glDrawElements(mode, NI - 1, type, indices);
+    glEndList();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glCallList(list);
+    glDeleteLists(list, 1);
+    return memcmp(a, zb->pbuf, sizeof(a)) != 0;
+}
+static int check_modes(void) {
+    static const GLenum modes[] = {GL_POINTS, GL_LINES, GL_TRIANGLES,
+                                   GL_TRIANGLE_STRIP, GL_TRIANGLE_FAN,
+                                   GL_QUADS};
+    GLuint i;
+    for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (check(modes[i], GL_UNSIGNED_BYTE, ib) ||
+            check(modes[i], GL_UNSIGNED_SHORT, is) ||
+            check(modes[i], GL_UNSIGNED_INT, ii))
+            return 1;
+    }
+    return 0;
+}
+int main(void) {
+    GLfloat light[4] = {0.3f, 0.5f, 1, 0};
+    GLuint buf;
+    int i;
+
+    setup();
+
+    seed = 1;
+    for (i = 0; i < NV * 3; i++) {
+        pos[i] = rnd(1000) / 400.0f - 1.25f;
+        nrm[i] = rnd(1000) / 500.0f - 1;
+    }
+    for (i = 0; i < NV * 4; i++) col[i] = rnd(256) / 255.0f;
+    /* indices repeated nearby, and some further away */
+    for (i = 0; i < NI; i++) {
+        ib[i] = (GLubyte) (i / 6 + rnd(8)) % NV;
+        if (rnd(5) == 0) ib[i] = (GLubyte) rnd(NV);
+        is[i] = ib[i];
+        ii[i] = ib[i];
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, pos);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorPointer(4, GL_FLOAT, 0, col);
+    if (check_modes()) return 1;
+
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, 0, nrm);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glLightfv(GL_LIGHT0, GL_POSITION, light);
+    glEnable(GL_COLOR_MATERIAL);
+    if (check_modes()) return 1;
+
+    /* indices from an element array buffer */
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buf);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(is), is, GL_STATIC_DRAW);
+    if (check(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void *) 0)) return 1;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glDeleteBuffers(1, &buf);
+
+    teardown();
+    return 0;
+}
+"
+
+# Test: lit vertices drawn lazily get the colors they got lit right away
+run_test "api_lazy_lighting" "$API_HEADER
+#include <string.h>
+static unsigned seed;
+static GLfloat rndf(void) {
+    seed = seed * 1103515245u + 12345u;
+    return (GLfloat) ((seed >> 8) & 0xffff) / 65535.0f;
+}
+static GLfloat emission[4] = {0.1f, 0, 0.05f, 1};
+static int eager;
+static void vertex(void) {
+    glNormal3f(rndf() * 2 - 1, rndf() * 2 - 1, rndf() * 2 - 1);
+    glVertex3f(rndf() * 3 - 1.5f, rndf() * 3 - 1.5f, rndf() * 2 - 1);
+    /* lights the vertex right away, the way it used to be */
+    if (eager)
+        glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, emission);
+}
+static void draw(PIXEL *out) {
+    static const GLenum modes[] = {GL_TRIANGLES, GL_TRIANGLE_STRIP,
+                                   GL_TRIANGLE_FAN, GL_QUADS, GL_QUAD_STRIP,
+                                   GL_LINES, GL_LINE_STRIP, GL_POINTS};
+    GLfloat diffuse[4] = {0.8f, 0.6f, 0.2f, 1};
+    GLfloat ambient[4] = {0.2f, 0.2f, 0.2f, 1};
+    int m, i;
+    seed = 7;
+    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambient);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuse);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (m = 0; m < 3 * 8; m++) {
+        glBegin(modes[m % 8]);
+        for (i = 0; i < 24; i++) {
+            /* per vertex colors, and materials changing in the middle */
+            if (m >= 8 && m < 16)
+                glColor3f(rndf(), rndf(), rndf());
+            if (m >= 16 && i % 5 == 2) {
+                diffuse[0] = rndf();
+                glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse);
+            }
+            vertex();
+        }
+        glEnd();
+        if (m == 7)
+            glEnable(GL_COLOR_MATERIAL);
+        if (m == 15)
+            glDisable(GL_COLOR_MATERIAL);
+    }
+    glFinish();
+    memcpy(out, zb->pbuf, 128 * 128 * sizeof(PIXEL));
+}
+static int check(void) {
+    static PIXEL a[128 * 128], b[128 * 128];
+    eager = 0;
+    draw(a);
+    eager = 1;
+    draw(b);
+    return memcmp(a, b, sizeof(a)) != 0;
+}
+/*
+ * glDrawElements lights the vertices as the cache computes them, and the
+ * glArrayElement of a display list lazily, with a material set per vertex
+ */
+#define NV 60
+#define NI 240
+static GLfloat pos[NV * 3], nrm[NV * 3], col[NV * 3];
+static GLushort idx[NI];
+static int check_elements(void) {
+    static PIXEL a[128 * 128];
+    GLuint list = glGenLists(1);
+    int i;
+    for (i = 0; i < NV * 3; i++) {
+        pos[i] = rndf() * 3 - 1.5f;
+        nrm[i] = rndf() * 2 - 1;
+        col[i] = rndf();
+    }
+    for (i = 0; i < NI; i++)
+        idx[i] = (GLushort) ((i / 4 + (int) (rndf() * 6)) % NV);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, pos);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, 0, nrm);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorPointer(3, GL_FLOAT, 0, col);
+    glEnable(GL_COLOR_MATERIAL);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDrawElements(GL_TRIANGLES, NI, GL_UNSIGNED_SHORT, idx);
+    memcpy(a, zb->pbuf, sizeof(a));
+    glNewList(list, GL_COMPILE);
+    glDrawElements(GL_TRIANGLES, NI, GL_UNSIGNED_SHORT, idx);
+    glEndList();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glCallList(list);
+    glDisable(GL_COLOR_MATERIAL);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    return memcmp(a, zb->pbuf, sizeof(a)) != 0;
+}
+int main(void) {
+    GLfloat light[4] = {0.3f, 0.5f, 1, 0};
+    GLfloat spot[4] = {0, 0, 2, 1};
+
+    setup();
+
+    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, emission);
+    glMatrixMode(GL_PROJECTION);
+    glFrustum(-1, 1, -1, 1, 1, 10);
+    glMatrixMode(GL_MODELVIEW);
+    glTranslatef(0, 0, -2.5f);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glLightfv(GL_LIGHT0, GL_POSITION, light);
+    glEnable(GL_LIGHT1);
+    glLightfv(GL_LIGHT1, GL_POSITION, spot);
+    glEnable(GL_NORMALIZE);
+    if (check()) return 1;
+    if (check_elements()) return 1;
+    glEnable(GL_CULL_FACE);
+    if (check()) return 1;
+    glCullFace(GL_FRONT);
+    glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, 1);
+    if (check()) return 1;
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    if (check()) return 1;
+
+    teardown();
+    return 0;
+}
+"
+
+# Test: Batched lighting against the lighting model, as the light and material change
+run_test "api_batched_lighting" "$API_HEADER
+#include <math.h>
+static GLfloat ldiff[4], lspec[4], mdiff[4], mspec[4], model[4];
+static GLfloat expo, shin;
+/* the lighting model, for a spot at (0, 0, 2) lighting the point at x */
+static GLfloat expected(int k, GLfloat x, const GLfloat *n) {
+    GLfloat d[3] = {-x, 0, 2}, s[3], dist, dot, dot_spot, att, c, ls;
+    dist = sqrtf(x * x + 4);
+    d[0] /= dist;
+    d[2] /= dist;
+    c = 0.2f * model[k];
+    att = 1;
+    dot = d[0] * n[0] + d[1] * n[1] + d[2] * n[2];
+    if (dot <= 0)
+        return c;
+    dot_spot = d[2];
+    if (dot_spot < cosf(60 * 3.14159265f / 180))
+        return c;
+    att *= powf(dot_spot, expo);
+    s[0] = d[0];
+    s[1] = d[1];
+    s[2] = d[2] - 1;
+    ls = n[0] * s[0] + n[1] * s[1] + n[2] * s[2];
+    c += att * dot * ldiff[k] * mdiff[k];
+    if (ls > 0) {
+        ls = (ls > 1 ? 1 : ls) / sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+        c += att * powf(ls, shin) * lspec[k] * mspec[k];
+    }
+    return c > 1 ? 1 : c;
+}
+static int check(void) {
+    int i, j, k, bad = 0;
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, model);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, ldiff);
+    glLightfv(GL_LIGHT0, GL_SPECULAR, lspec);
+    glLightf(GL_LIGHT0, GL_SPOT_EXPONENT, expo);
+    glMaterialfv(GL_FRONT, GL_DIFFUSE, mdiff);
+    glMaterialfv(GL_FRONT, GL_SPECULAR, mspec);
+    glMaterialf(GL_FRONT, GL_SHININESS, shin);
+    for (i = 0; i < 16; i++) {
+        GLfloat x = i / 8.0f - 0.95f;
+        GLfloat n[3] = {0.3f - i * 0.05f, 0.1f, 1};
+        GLfloat len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        PIXEL p = 0;
+        for (k = 0; k < 3; k++)
+            n[k] /= len;
+        glClear(GL_COLOR_BUFFER_BIT);
+        glBegin(GL_POINTS);
+        glNormal3fv(n);
+        glVertex3f(x, 0, 0);
+        glEnd();
+        glFinish();
+        for (j = 0; j < 128 * 128; j++)
+            if (zb->pbuf[j] != 0xff00ff)
+                p = zb->pbuf[j];
+        for (k = 0; k < 3; k++) {
+            int got = (p >> (16 - 8 * k)) & 0xff;
+            int want = (int) (expected(k, x, n) * 255);
+            if (abs(got - want) > 3)
+                bad++;
+        }
+    }
+    return bad;
+}
+int main(void) {
+    GLfloat pos[4] = {0, 0, 2, 1}, dir[3] = {0, 0, -1};
+    int i;
+    setup();
+    glClearColor(1, 0, 1, 1);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glSetEnableSpecular(1);
+    glLightfv(GL_LIGHT0, GL_POSITION, pos);
+    glLightfv(GL_LIGHT0, GL_SPOT_DIRECTION, dir);
+    glLightf(GL_LIGHT0, GL_SPOT_CUTOFF, 60);
+    /* every product and table follows the changes of the light and material */
+    for (i = 0; i < 4; i++) {
+        int k;
+        for (k = 0; k < 3; k++) {
+            ldiff[k] = 0.3f + 0.2f * ((i + k) % 4);
+            lspec[k] = 1 - 0.3f * ((i * k) % 3);
+            mdiff[k] = 0.9f - 0.2f * i;
+            mspec[k] = 0.25f * (i + 1);
+            model[k] = 0.1f * (i + k);
+        }
+        ldiff[3] = lspec[3] = mdiff[3] = mspec[3] = model[3] = 1;
+        expo = 30 * i;
+        shin = 5 + 40 * i;
+        if (check())
+            return 1;
+    }
+    teardown();
+    return 0;
+}
+"
+
+# Test: Specular powers within a color level of pow(), near 1 and below 1
+run_test "api_specular_power" "$API_HEADER
+#include <math.h>
+/*
+ * The specular light alone, of a light at infinity at 1 rad of the viewer,
+ * with the normals at a from the half way vector tinygl takes, d - (0, 0, 1).
+ */
+static int check(GLfloat shin, GLfloat span) {
+    GLfloat black[4] = {0, 0, 0, 1}, white[4] = {1, 1, 1, 1};
+    int i, j, bad = 0;
+    glMaterialfv(GL_FRONT, GL_AMBIENT, black);
+    glMaterialfv(GL_FRONT, GL_DIFFUSE, black);
+    glMaterialfv(GL_FRONT, GL_SPECULAR, white);
+    glMaterialf(GL_FRONT, GL_SHININESS, shin);
+    for (i = 0; i < 64; i++) {
+        GLfloat a = i * span / 64, h = atan2f(sinf(1), cosf(1) - 1);
+        GLfloat n[3] = {sinf(h - a), 0, cosf(h - a)};
+        int want = (int) (powf(cosf(a), shin) * 255), got;
+        PIXEL p = 0;
+        glClear(GL_COLOR_BUFFER_BIT);
+        glBegin(GL_POINTS);
+        glNormal3fv(n);
+        glVertex3f(0, 0, 0);
+        glEnd();
+        glFinish();
+        for (j = 0; j < 128 * 128; j++)
+            if (zb->pbuf[j] != 0xff00ff)
+                p = zb->pbuf[j];
+        got = (p >> 8) & 0xff;
+        if (abs(got - want) > 1)
+            bad++;
+    }
+    return bad;
+}
+int main(void) {
+    GLfloat pos[4] = {sinf(1), 0, cosf(1), 0}, black[4] = {0, 0, 0, 1};
+    setup();
+    glClearColor(1, 0, 1, 1);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glSetEnableSpecular(1);
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, black);
+    glLightfv(GL_LIGHT0, GL_POSITION, pos);
+    /* close to 1, where the large powers fall fastest, and then to 0 */
+    if (check(128, 0.4f) || check(90, 0.4f) || check(40, 0.4f) ||
+        check(0.25f, 1.5955f))
+        return 1;
+    teardown();
+    return 0;
+}
+"
+
+# Test: Strips, fans, line loops and polygons assembled from the vertex ring
+run_test "api_vertex_ring" "$API_HEADER
+#include <math.h>
+#include <string.h>
+#define N 40
+static GLfloat pos[N][3], col[N][3], nrm[N][3];
+static void vertex(int i) {
+    glColor3fv(col[i]);
+    glNormal3fv(nrm[i]);
+    glVertex3fv(pos[i]);
+}
+/* the primitives of mode, drawn as independent triangles or lines */
+static void reference(GLenum mode, int n) {
+    int i;
+    if (mode == GL_LINE_STRIP || mode == GL_LINE_LOOP) {
+        glBegin(GL_LINES);
+        for (i = 1; i < n; i++) {
+            vertex(i - 1);
+            vertex(i);
+        }
+        if (mode == GL_LINE_LOOP) {
+            vertex(n - 1);
+            vertex(0);
+        }
+        glEnd();
+        return;
+    }
+    glBegin(GL_TRIANGLES);
+    for (i = 2; i < n; i++) {
+        if (mode == GL_TRIANGLE_FAN) {
+            vertex(0);
+            vertex(i - 1);
+            vertex(i);
+        } else if (mode == GL_POLYGON) {
+            vertex(i);
+            vertex(0);
+            vertex(i - 1);
+        } else if (i % 2 == 1) {
+            /* GL_QUAD_STRIP, the quad of the vertices i - 3 to i */
+            vertex(i - 3);
+            vertex(i - 2);
+            vertex(i - 1);
+            vertex(i - 2);
+            vertex(i);
+            vertex(i - 1);
+        }
+    }
+    glEnd();
+}
+static void draw(GLenum mode, int n, int ref, PIXEL *out) {
+    int i;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (ref) {
+        reference(mode, n);
+    } else {
+        glBegin(mode);
+        for (i = 0; i < n; i++)
+            vertex(i);
+        glEnd();
+    }
+    glFinish();
+    memcpy(out, zb->pbuf, 128 * 128 * sizeof(PIXEL));
+}
+int main(void) {
+    static PIXEL a[128 * 128], b[128 * 128];
+    static const GLenum modes[] = {GL_TRIANGLE_FAN, GL_QUAD_STRIP,
+                                   GL_LINE_STRIP,
+#if TGL_HAS(GL_POLYGON)
+                                   GL_LINE_LOOP, GL_POLYGON,
+#endif
+    };
+    GLfloat light[4] = {0.3f, 0.5f, 1, 0};
+    unsigned seed = 5;
+    int i, k, m, lit;
+    setup();
+    glEnable(GL_DEPTH_TEST);
+    glLightfv(GL_LIGHT0, GL_POSITION, light);
+    glEnable(GL_LIGHT0);
+    for (i = 0; i < N; i++)
+        for (k = 0; k < 3; k++) {
+            seed = seed * 1103515245u + 12345u;
+            col[i][k] = (GLfloat) ((seed >> 8) & 0xff) / 255.0f;
+            nrm[i][k] = col[i][k] * 2 - 1;
+            pos[i][k] = col[i][k] * 1.6f - 0.8f;
+        }
+    for (lit = 0; lit < 2; lit++) {
+        if (lit)
+            glEnable(GL_LIGHTING);
+        for (m = 0; m < (int) (sizeof(modes) / sizeof(modes[0])); m++) {
+            draw(modes[m], N, 0, a);
+            draw(modes[m], N, 1, b);
+            if (memcmp(a, b, sizeof(a)))
+                return 1;
+        }
+    }
+#if TGL_HAS(GL_POLYGON)
+    /* a convex polygon of many more vertices than a quad */
+    glDisable(GL_LIGHTING);
+    for (i = 0; i < N; i++) {
+        pos[i][0] = 0.9f * cosf(i * 6.2831853f / N);
+        pos[i][1] = 0.9f * sinf(i * 6.2831853f / N);
+        pos[i][2] = 0;
+    }
+    draw(GL_POLYGON, N, 0, a);
+    draw(GL_POLYGON, N, 1, b);
+    if (memcmp(a, b, sizeof(a)) || a[64 * 128 + 64] == 0)
+        return 1;
+#endif
+    teardown();
+    return 0;
+}
+"
+
+# Test: SIMD matrix kernels and lazily evaluated derived matrices
+run_test "api_matrix_kernels" "$API_HEADER
+#include <math.h>
+#include <string.h>
+static void draw_lit(PIXEL *out) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBegin(GL_TRIANGLES);
+    glNormal3f(0.3f, 0.2f, 1);
+    glVertex3f(-0.5f, -0.5f, 0);
+    glNormal3f(-0.4f, 0.1f, 1);
+    glVertex3f(0.5f, -0.5f, 0);
+    glNormal3f(0.1f, -0.6f, 1);
+    glVertex3f(0, 0.5f, 0);
+    glEnd();
+    glFinish();
+    memcpy(out, zb->pbuf, 128 * 128 * sizeof(PIXEL));
+}
+static void lighting(void) {
+    GLfloat light[4] = {0.5f, 0.3f, 1, 0};
+    glLightfv(GL_LIGHT0, GL_POSITION, light);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_LIGHTING);
+}
+static void transform(void) {
+    glRotatef(50, 0.2f, 0.3f, 1);
+    glScalef(1.2f, 0.8f, 1);
+}
+int main(void) {
+    static PIXEL a[128 * 128], b[128 * 128];
+    GLfloat m1[16], m2[16], got[16], pos[4];
+    int i, j, k;
+    /* products of the modelview matrix */
+    setup();
+    for (i = 0; i < 16; i++) {
+        m1[i] = (GLfloat) ((i * 7) % 11) - 5;
+        m2[i] = (GLfloat) ((i * 5) % 13) * 0.25f - 1;
+    }
+    glLoadMatrixf(m1);
+    glMultMatrixf(m2);
+    glGetFloatv(GL_MODELVIEW_MATRIX, got);
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++) {
+            /* column major */
+            GLfloat s = 0;
+            for (k = 0; k < 4; k++)
+                s += m1[k * 4 + j] * m2[i * 4 + k];
+            if (fabsf(got[i * 4 + j] - s) > 1e-4f)
+                return 1;
+        }
+    /* the raster position follows the matrices without any glBegin */
+    glLoadIdentity();
+    glTranslatef(0.5f, 0.25f, 0);
+    glRasterPos3f(0, 0, 0);
+    glGetFloatv(GL_CURRENT_RASTER_POSITION, pos);
+    if (pos[0] != 0.5f || pos[1] != 0.25f)
+        return 1;
+    teardown();
+
+    /* the normals are transformed by the inverse of the modelview matrix set
+       while lighting was disabled */
+    setup();
+    lighting();
+    draw_lit(a);
+    glDisable(GL_LIGHTING);
+    transform();
+    draw_lit(a);
+    glEnable(GL_LIGHTING);
+    draw_lit(a);
+    teardown();
+    setup();
+    lighting();
+    transform();
+    draw_lit(b);
+    teardown();
+    return memcmp(a, b, sizeof(a)) != 0;
+}
+"
+
+# Test: the vertices of glVertex, glDrawArrays and glDrawElements, clipped and lit
+run_test "api_vertex_layout" "$API_HEADER
+#include <math.h>
+#include <string.h>
+/* triangles crossing the view volume, lit, through all of the vertex paths */
+static GLfloat pos[] = {-1.5f, -0.5f, 0, 0.5f, -1.5f, 0.3f, 0.8f, 1.4f, -0.2f,
+                        -0.9f, 0.9f, 0.1f, 1.6f, 0.2f, 0, -0.2f, -0.3f, 0.4f};
+static GLfloat nrm[] = {0, 0, 1, 0.3f, 0, 1, 0, 0.4f, 1,
+                        -0.5f, 0, 1, 0, -0.2f, 1, 0.2f, 0.2f, 1};
+static GLushort idx[] = {0, 1, 2, 3, 4, 5};
+static void state(void) {
+    glMatrixMode(GL_MODELVIEW);
+    glTranslatef(0, 0, -0.5f);
+    glRotatef(20, 1, 1, 0);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+int main(void) {
+    static PIXEL a[128 * 128], b[128 * 128];
+    GLfloat d;
+    int i;
+    setup();
+    state();
+    glBegin(GL_TRIANGLES);
+    for (i = 0; i < 6; i++) {
+        glNormal3fv(&nrm[i * 3]);
+        glVertex3fv(&pos[i * 3]);
+    }
+    glEnd();
+    glFinish();
+    memcpy(a, zb->pbuf, sizeof(a));
+    teardown();
+
+    setup();
+    state();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, pos);
+    glNormalPointer(GL_FLOAT, 0, nrm);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glFinish();
+    if (memcmp(a, zb->pbuf, sizeof(a)) != 0)
+        return 1;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, idx);
+    glFinish();
+    memcpy(b, zb->pbuf, sizeof(b));
+    if (memcmp(a, b, sizeof(a)) != 0)
+        return 1;
+
+    /* the eye coordinates of the raster position */
+    glLoadIdentity();
+    glTranslatef(0, 0, -0.25f);
+    glRasterPos3f(0, 0, 0);
+    glGetFloatv(GL_CURRENT_RASTER_DISTANCE, &d);
+    teardown();
+    return fabsf(d) != 0.25f;
+}
+"
+
+# Test: display lists and vertex arrays culled by their bounding box
+run_test "api_bounds_culling" "$API_HEADER
+#include <math.h>
+#include <string.h>
+static int drawn(void) {
+    int i, n = 0;
+    glFinish();
+    for (i = 0; i < 128 * 128; i++)
+        n += zb->pbuf[i] != 0;
+    return n;
+}
+static void frame(GLfloat x) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+    glTranslatef(x, 0, 0);
+}
+static void triangle(GLfloat x) {
+    glBegin(GL_TRIANGLES);
+    glVertex3f(x - 0.5f, -0.5f, 0);
+    glVertex3f(x + 0.5f, -0.5f, 0);
+    glVertex3f(x, 0.5f, 0);
+    glEnd();
+}
+int main(void) {
+    static GLfloat pos[] = {-0.5f, -0.5f, 0, 0.5f, -0.5f, 0, 0, 0.5f, 0};
+    static GLfloat col[] = {0, 0, 1, 0, 0, 1, 0, 1, 0};
+    GLfloat lo[3] = {-0.5f, -0.5f, 0}, hi[3] = {0.5f, 0.5f, 0}, tc[4];
+    GLuint l;
+    PIXEL p;
+    setup();
+    l = glGenLists(2);
+    glNewList(l, GL_COMPILE);
+    glColor3f(1, 0, 0);
+    triangle(0);
+    glTexCoord2f(0.25f, 0.75f);
+    glEndList();
+    /* moved by the list itself: never culled */
+    glNewList(l + 1, GL_COMPILE);
+    glTranslatef(-5, 0, 0);
+    triangle(5);
+    glEndList();
+
+    frame(0);
+    glCallList(l);
+    if (drawn() == 0)
+        return 1;
+    frame(0.9f);
+    glCallList(l);
+    if (drawn() == 0)
+        return 1;
+    /* culled, with the color and texture coordinates of the list left */
+    frame(5);
+    glColor3f(1, 1, 1);
+    glTexCoord2f(0, 0);
+    glCallList(l);
+    if (drawn() != 0)
+        return 1;
+    glGetFloatv(GL_CURRENT_TEXTURE_COORDS, tc);
+    if (tc[0] != 0.25f || tc[1] != 0.75f)
+        return 1;
+    glLoadIdentity();
+    glBegin(GL_POINTS);
+    glVertex3f(0, 0, 0);
+    glEnd();
+    glFinish();
+    p = zb->pbuf[63 * 128 + 63];
+    if (p == 0 || (p & 0xffff) != 0)
+        return 1;
+    frame(0);
+    glCallList(l + 1);
+    if (drawn() == 0)
+        return 1;
+
+    /* the box of the vertex array, for glDrawArrays and glDrawElements */
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, pos);
+    glColorPointer(3, GL_FLOAT, 0, col);
+    glVertexBoundsTGL(lo, hi);
+    frame(0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    if (drawn() == 0)
+        return 1;
+    /* a box beside the vertices culls them */
+    lo[0] += 3;
+    hi[0] += 3;
+    glVertexBoundsTGL(lo, hi);
+    frame(0);
+    glColor3f(1, 1, 1);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    if (drawn() != 0)
+        return 1;
+    {
+        GLubyte idx[3] = {0, 1, 2};
+        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_BYTE, idx);
+        if (drawn() != 0)
+            return 1;
+    }
+    /* the current color of the last element */
+    glDisableClientState(GL_COLOR_ARRAY);
+    glLoadIdentity();
+    glBegin(GL_POINTS);
+    glVertex3f(0, 0, 0);
+    glEnd();
+    glFinish();
+    p = zb->pbuf[63 * 128 + 63];
+    if (p == 0 || (p & 0xff00ff) != 0)
+        return 1;
+    /* and glVertexPointer forgets the box */
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, pos);
+    frame(0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    if (drawn() == 0)
+        return 1;
+    teardown();
+    return 0;
+}
+"
+
+# Test: fixed point geometry - attenuated lighting, large object coordinates
+# scaled into view, and the raster distance, in either geometry build
+run_test "api_fixed_geometry" "$API_HEADER
+#include <math.h>
+/* a point light at (0, 0, 2), attenuated, diffuse (1, 0.5, 0.25) */
+static GLfloat expected(int k, GLfloat x) {
+    GLfloat diff[3] = {1, 0.5f, 0.25f};
+    GLfloat dist = sqrtf(x * x + 4), dot = 2 / dist;
+    GLfloat att = 1 / (1 + 0.25f * dist + 0.125f * dist * dist);
+    return 0.2f * 0.2f + att * dot * diff[k] * 0.8f;
+}
+static PIXEL lit_point(GLfloat x) {
+    PIXEL p = 0;
+    int j;
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBegin(GL_POINTS);
+    glNormal3f(0, 0, 1);
+    glVertex3f(x, 0, 0);
+    glEnd();
+    glFinish();
+    for (j = 0; j < 128 * 128; j++)
+        if (zb->pbuf[j] != 0)
+            p = zb->pbuf[j];
+    return p;
+}
+int main(void) {
+    GLfloat pos[4] = {0, 0, 2, 1}, diff[4] = {1, 0.5f, 0.25f, 1};
+    GLfloat dist = 0;
+    int i, j, k, bad = 0;
+    setup();
+    glClearColor(0, 0, 0, 0);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glLightfv(GL_LIGHT0, GL_POSITION, pos);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, diff);
+    glLightf(GL_LIGHT0, GL_LINEAR_ATTENUATION, 0.25f);
+    glLightf(GL_LIGHT0, GL_QUADRATIC_ATTENUATION, 0.125f);
+    for (i = 0; i < 8; i++) {
+        GLfloat x = i / 4.0f - 0.95f;
+        PIXEL p = lit_point(x);
+        for (k = 0; k < 3; k++) {
+            int got = (p >> (16 - 8 * k)) & 0xff;
+            int want = (int) (expected(k, x) * 255);
+            if (abs(got - want) > 3)
+                bad++;
+        }
+    }
+    if (bad)
+        return 1;
+    glDisable(GL_LIGHTING);
+    /* large object coordinates, scaled down to the view volume */
+    glScalef(0.001f, 0.001f, 0.001f);
+    for (i = 0; i < 8; i++) {
+        GLfloat x = i * 250.0f - 875.0f, y = 500.0f - i * 125.0f;
+        int px = (int) ((x / 1000 + 1) * 127.5f / 2), n = 0;
+        int py = (int) ((1 - y / 1000) * 127.5f / 2);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glBegin(GL_POINTS);
+        glColor3f(1, 1, 1);
+        glVertex3f(x, y, 900.0f - i * 250.0f);
+        glEnd();
+        glFinish();
+        for (j = 0; j < 128 * 128; j++)
+            if (zb->pbuf[j] != 0) {
+                n++;
+                bad += abs(j % 128 - px) > 1 || abs(j / 128 - py) > 1;
+            }
+        bad += n == 0;
+    }
+    if (bad)
+        return 2;
+    glLoadIdentity();
+    glRasterPos3f(0.25f, 0.5f, -0.75f);
+    glGetFloatv(GL_CURRENT_RASTER_DISTANCE, &dist);
+    if (fabsf(fabsf(dist) - 0.75f) > 1e-3f)
+        return 3;
+    teardown();
+    return 0;
+}
+"
+
+# Test: locked arrays - glLockArraysEXT reuses the vertices of the locked
+# elements, and drops them when the matrices, lights or current values change
+run_test "api_locked_arrays" "$API_HEADER
+#include <math.h>
+#include <string.h>
+#define N 8
+static GLfloat pos[(N + 1) * (N + 1) * 3], nrm[(N + 1) * (N + 1) * 3];
+static GLfloat col[(N + 1) * (N + 1) * 3];
+static GLushort idx[N * N * 6];
+static PIXEL ref[128 * 128];
+static void mesh(void) {
+    int i, j, k = 0;
+    for (j = 0; j <= N; j++)
+        for (i = 0; i <= N; i++) {
+            int v = (j * (N + 1) + i) * 3;
+            GLfloat x = i * 1.6f / N - 0.8f, y = j * 1.6f / N - 0.8f;
+            pos[v] = x;
+            pos[v + 1] = y;
+            pos[v + 2] = 0.3f * x * y;
+            nrm[v] = -0.3f * y;
+            nrm[v + 1] = -0.3f * x;
+            nrm[v + 2] = 1;
+            col[v] = i / (GLfloat) N;
+            col[v + 1] = j / (GLfloat) N;
+            col[v + 2] = 0.5f;
+        }
+    for (j = 0; j < N; j++)
+        for (i = 0; i < N; i++) {
+            GLushort a = j * (N + 1) + i;
+            idx[k++] = a;
+            idx[k++] = a + 1;
+            idx[k++] = a + N + 2;
+            idx[k++] = a;
+            idx[k++] = a + N + 2;
+            idx[k++] = a + N + 1;
+        }
+}
+/* elements drawn with glDrawElements, or the first rows with glDrawArrays */
+static void draw(int elements) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (elements)
+        glDrawElements(GL_TRIANGLES, N * N * 6, GL_UNSIGNED_SHORT, idx);
+    else
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 3 * (N + 1));
+    glFinish();
+}
+/* draws locked twice, and once unlocked, compared */
+static int same(int elements) {
+    int k;
+    glLockArraysEXT(0, (N + 1) * (N + 1) - 5);
+    for (k = 0; k < 2; k++) {
+        draw(elements);
+        memcpy(ref, zb->pbuf, sizeof(ref));
+    }
+    glUnlockArraysEXT();
+    draw(elements);
+    return memcmp(ref, zb->pbuf, sizeof(ref)) == 0;
+}
+/* a state change between two locked draws, compared with an unlocked one */
+static int changed(int what) {
+    GLfloat diff[4] = {1, 0.6f, 0.3f, 1};
+    glLockArraysEXT(0, (N + 1) * (N + 1));
+    draw(1);
+    switch (what) {
+    case 0:
+        glRotatef(30, 1, 1, 0);
+        break;
+    case 1:
+        glLightfv(GL_LIGHT0, GL_DIFFUSE, diff);
+        break;
+    case 2:
+        glMaterialf(GL_FRONT, GL_SHININESS, 10);
+        glSetEnableSpecular(1);
+        break;
+    case 3:
+        glColor3f(0.2f, 0.9f, 0.4f);
+        break;
+    default:
+        glNormal3f(0.5f, 0.5f, 0.7f);
+        break;
+    }
+    draw(1);
+    memcpy(ref, zb->pbuf, sizeof(ref));
+    glUnlockArraysEXT();
+    draw(1);
+    return memcmp(ref, zb->pbuf, sizeof(ref)) == 0;
+}
+int main(void) {
+    GLfloat lpos[4] = {0.5f, 0.5f, 1, 0};
+    setup();
+    mesh();
+    glEnable(GL_DEPTH_TEST);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, pos);
+    glNormalPointer(GL_FLOAT, 0, nrm);
+    glColorPointer(3, GL_FLOAT, 0, col);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glLightfv(GL_LIGHT0, GL_POSITION, lpos);
+    if (!same(1) || !same(0))
+        return 1;
+    if (!changed(0) || !changed(1) || !changed(2))
+        return 2;
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glNormal3f(0, 0, 1);
+    if (!changed(4))
+        return 2;
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glEnable(GL_COLOR_MATERIAL);
+    if (!same(1))
+        return 3;
+    glDisable(GL_LIGHTING);
+    glDisable(GL_COLOR_MATERIAL);
+    glDisableClientState(GL_COLOR_ARRAY);
+    if (!changed(3))
+        return 4;
+    /* locked vertices are reused: their coordinates are not read again */
+    glLockArraysEXT(0, (N + 1) * (N + 1));
+    draw(1);
+    memcpy(ref, zb->pbuf, sizeof(ref));
+    pos[0] -= 0.15f;
+    draw(1);
+    if (memcmp(ref, zb->pbuf, sizeof(ref)) != 0)
+        return 5;
+    glUnlockArraysEXT();
+    draw(1);
+    if (memcmp(ref, zb->pbuf, sizeof(ref)) == 0)
+        return 6;
+    teardown();
+    return 0;
+}
+"
+
+# Test: display lists optimized at glEndList draw what their ops draw
+run_test "api_list_optimizer" "$API_HEADER
+#include <math.h>
+#include <string.h>
+static PIXEL ref[128 * 128];
+static GLuint inner;
+static void strip(GLfloat y, int n) {
+    int i;
+    glBegin(GL_TRIANGLE_STRIP);
+    for (i = 0; i < n; i++) {
+        glColor3f(1, 0, 0);
+        glVertex3f(i * 1.6f / n - 0.8f, y + (i & 1) * 0.25f, 0);
+    }
+    glEnd();
+}
+static void scene(void) {
+    GLfloat green[4] = {0, 1, 0, 1};
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glTranslatef(0.25f, 0, 0);
+    glScalef(0.5f, 0.5f, 1);
+    glTranslatef(-0.5f, 0.25f, 0);
+    glColor3f(1, 0, 0);
+    strip(0.5f, 100);
+    glLoadIdentity();
+    glTranslatef(0, -0.5f, 0);
+    /* the color set again after a nested list is kept */
+    glCallList(inner);
+    glColor3f(1, 0, 0);
+    glBegin(GL_TRIANGLES);
+    glVertex3f(-0.5f, 0, 0);
+    glVertex3f(0.5f, 0, 0);
+    glVertex3f(0, 0.5f, 0);
+    glEnd();
+    /* the color set again after a material change is kept */
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_COLOR_MATERIAL);
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+    glColor3f(0, 0, 1);
+    glNormal3f(0, 0, 1);
+    glPushMatrix();
+    glScalef(0.5f, 0.5f, 1);
+    glBegin(GL_QUADS);
+    glNormal3f(0, 0, 1);
+    glVertex3f(-0.9f, -0.9f, 0);
+    glVertex3f(-0.5f, -0.9f, 0);
+    glNormal3f(0, 0, 1);
+    glVertex3f(-0.5f, -0.5f, 0);
+    glVertex3f(-0.9f, -0.5f, 0);
+    glEnd();
+    glPopMatrix();
+    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, green);
+    glColor3f(0, 0, 1);
+    glBegin(GL_TRIANGLES);
+    glVertex3f(0.5f, -0.9f, 0);
+    glVertex3f(0.9f, -0.9f, 0);
+    glTexCoord2f(0.5f, 0.5f);
+    glVertex3f(0.9f, -0.5f, 0);
+    glEnd();
+    glDisable(GL_COLOR_MATERIAL);
+    glDisable(GL_LIGHTING);
+    glColor3f(0, 1, 1);
+}
+/* with the color left by the scene */
+static void tail(void) {
+    glLoadIdentity();
+    glBegin(GL_TRIANGLES);
+    glVertex3f(-0.2f, 0.8f, 0);
+    glVertex3f(0.2f, 0.8f, 0);
+    glVertex3f(0, 0.95f, 0);
+    glEnd();
+    glFinish();
+}
+static void clear(void) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glColor3f(1, 1, 1);
+    glTexCoord2f(0, 0);
+}
+static int same(void) {
+    GLfloat tc[4];
+    glGetFloatv(GL_CURRENT_TEXTURE_COORDS, tc);
+    return tc[0] == 0.5f && tc[1] == 0.5f &&
+           !memcmp(ref, zb->pbuf, sizeof(ref));
+}
+int main(void) {
+    GLuint l;
+    int i, n = 0;
+    setup();
+    inner = glGenLists(2);
+    glNewList(inner, GL_COMPILE);
+    glColor3f(0, 1, 0);
+    glEndList();
+    clear();
+    scene();
+    tail();
+    memcpy(ref, zb->pbuf, sizeof(ref));
+    for (i = 0; i < 128 * 128; i++)
+        n += ref[i] != 0;
+    if (n < 1000)
+        return 1;
+
+    l = inner + 1;
+    clear();
+    glNewList(l, GL_COMPILE_AND_EXECUTE);
+    scene();
+    glEndList();
+    tail();
+    if (!same())
+        return 1;
+    for (i = 0; i < 2; i++) {
+        clear();
+        glCallList(l);
+        tail();
+        if (!same())
+            return 1;
+    }
+    teardown();
+    return 0;
+}
+"
+
+# Test: threaded display lists of many ops
+run_test "api_threaded_lists" "$API_HEADER
+#include <math.h>
+#include <string.h>
+static PIXEL ref[128 * 128];
+/* enough ops for the list to grow several times */
+static void scene(GLuint inner) {
+    int i;
+    glLoadIdentity();
+    for (i = 0; i < 3000; i++) {
+        GLfloat x = (i % 60) / 30.0f - 1, y = (i / 60) / 25.0f - 1;
+        glColor3f((i % 7) / 7.0f, (i % 5) / 5.0f, (i % 3) / 3.0f);
+        glBegin(GL_TRIANGLES);
+        glVertex3f(x, y, 0);
+        glVertex3f(x + 0.03f, y, 0);
+        glVertex3f(x, y + 0.04f, 0);
+        glEnd();
+        if (i % 500 == 0)
+            glCallList(inner);
+    }
+    glFinish();
+}
+int main(void) {
+    GLuint l;
+    int i, n = 0;
+    setup();
+    l = glGenLists(2);
+    glNewList(l + 1, GL_COMPILE);
+    glShadeModel(GL_FLAT);
+    glEndList();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    scene(l + 1);
+    memcpy(ref, zb->pbuf, sizeof(ref));
+    for (i = 0; i < 128 * 128; i++)
+        n += ref[i] != 0;
+    if (n < 5000)
+        return 1;
+
+    glNewList(l, GL_COMPILE);
+    scene(l + 1);
+    glEndList();
+    for (i = 0; i < 2; i++) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glCallList(l);
+        glFinish();
+        if (memcmp(ref, zb->pbuf, sizeof(ref)))
+            return 1;
+    }
+    /* an empty list, and one never compiled */
+    glNewList(l + 1, GL_COMPILE);
+    glEndList();
+    glCallList(l + 1);
+    l = glGenLists(1);
+    glCallList(l);
+    teardown();
+    return 0;
+}
+"
+
+# Test: display list names in a growable table, and lists of any size
+run_test "api_list_storage" "$API_HEADER
+#include <math.h>
+#include <string.h>
+#define N 20000
+static GLuint names[N];
+/* the list of index i draws a point of a color of its own at the center */
+static void define(GLuint l, int i) {
+    glNewList(l, GL_COMPILE);
+    glColor3f((i & 255) / 255.0f, ((i >> 8) & 255) / 255.0f, 1);
+    glBegin(GL_POINTS);
+    glVertex3f(0, 0, 0);
+    glEnd();
+    glEndList();
+}
+static int drawn(GLuint l, int i) {
+    PIXEL p, q;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glCallList(l);
+    glFinish();
+    p = zb->pbuf[63 * 128 + 63];
+    define(0, i);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glCallList(0);
+    glFinish();
+    q = zb->pbuf[63 * 128 + 63];
+    return p != 0 && p == q;
+}
+int main(void) {
+    GLuint l;
+    int i;
+    setup();
+    /* more lists than the former fixed table held */
+    for (i = 0; i < N; i++) {
+        names[i] = glGenLists(1);
+        if (names[i] == 0 || (i > 0 && names[i] == names[i - 1]))
+            return 1;
+        define(names[i], i);
+    }
+    for (i = 0; i < N; i += 3)
+        glDeleteList(names[i]);
+    for (i = 0; i < N; i++)
+        if (glIsList(names[i]) != (i % 3 != 0))
+            return 1;
+    for (i = 1; i < N; i += 997)
+        if (i % 3 && !drawn(names[i], i))
+            return 1;
+    /* any name */
+    define(3000000000u, 7);
+    if (!glIsList(3000000000u) || !drawn(3000000000u, 7))
+        return 1;
+    /* glGenLists skips the names taken by glNewList */
+    l = glGenLists(1);
+    define(l + 1, 1);
+    if (glGenLists(2) != l + 2)
+        return 1;
+    /* glDeleteLists deletes its range only */
+    glDeleteLists(l, 2);
+    if (glIsList(l) || glIsList(l + 1) || !glIsList(l + 2) ||
+        !glIsList(l + 3))
+        return 1;
+    teardown();
+    return 0;
+}
+"
+
+# Test: display lists saved to a file and loaded back
+run_test "api_list_files" "$API_HEADER
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#define S (128 * 128)
+static GLubyte tex[64 * 64 * 3];
+static PIXEL pixels[8 * 8];
+static PIXEL before[S];
+static GLfloat pos[12] = {-1, -1, 0, 1, -1, 0, 1, 1, 0, -1, 1, 0};
+static char path[4096];
+static char file[1 << 20];
+/* a textured quad, then a block of pixels over it, and a triangle drawn
+   by a nested list */
+static void define(GLuint base, GLuint tex_name) {
+    glNewList(base + 1, GL_COMPILE);
+    glColor3f(0.2f, 0.9f, 0.4f);
+    glBegin(GL_TRIANGLES);
+    glVertex3f(-0.9f, -0.9f, 0.5f);
+    glVertex3f(0.0f, -0.9f, 0.5f);
+    glVertex3f(-0.9f, 0.0f, 0.5f);
+    glEnd();
+    glEndList();
+    glNewList(base, GL_COMPILE);
+    glBindTexture(GL_TEXTURE_2D, tex_name);
+    glTexImage2D(GL_TEXTURE_2D, 0, 3, 64, 64, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                 tex);
+    glEnable(GL_TEXTURE_2D);
+    glColor3f(1, 1, 1);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 0);
+    glVertex3f(-0.8f, -0.8f, 0);
+    glTexCoord2f(1, 0);
+    glVertex3f(0.8f, -0.8f, 0);
+    glTexCoord2f(1, 1);
+    glVertex3f(0.8f, 0.8f, 0);
+    glTexCoord2f(0, 1);
+    glVertex3f(-0.8f, 0.8f, 0);
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+    glRasterPos2f(0.5f, 0.5f);
+    glDrawPixels(8, 8, GL_RGB, GL_UNSIGNED_INT, pixels);
+    glCallList(base + 1);
+    glEndList();
+}
+static void draw(GLuint base) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glCallList(base);
+    glFinish();
+}
+int main(int argc, char **argv) {
+    GLuint base, t;
+    FILE *f;
+    long size;
+    int i;
+    (void) argc;
+    snprintf(path, sizeof(path), \"%s.lists\", argv[0]);
+    setup();
+    for (i = 0; i < 64 * 64 * 3; i++)
+        tex[i] = (GLubyte) (i * 7 + (i >> 6) * 13);
+    for (i = 0; i < 8 * 8; i++)
+        pixels[i] = 0x00ff00ffu + i;
+    glGenTextures(1, &t);
+    base = glGenLists(2);
+    define(base, t);
+    draw(base);
+    memcpy(before, zb->pbuf, sizeof(before));
+
+    /* the file holds the two lists, and their pixels */
+    if (glSaveListsTGL(path, base, 3) != 2)
+        return 1;
+    glDeleteLists(base, 2);
+    memset(tex, 0, sizeof(tex));
+    memset(pixels, 0, sizeof(pixels));
+    if (glIsList(base) || glIsList(base + 1))
+        return 2;
+    if (glLoadListsTGL(path) != 2 || !glIsList(base) || !glIsList(base + 1))
+        return 3;
+    draw(base);
+    if (memcmp(before, zb->pbuf, sizeof(before)) != 0)
+        return 4;
+
+    /* loaded again over the lists of the first load */
+    if (glLoadListsTGL(path) != 2)
+        return 5;
+    draw(base);
+    if (memcmp(before, zb->pbuf, sizeof(before)) != 0)
+        return 6;
+    glDeleteList(base + 1);
+    if (glLoadListsTGL(path) != 2)
+        return 7;
+    draw(base);
+    if (memcmp(before, zb->pbuf, sizeof(before)) != 0)
+        return 8;
+
+    /* a truncated or foreign file loads nothing */
+    f = fopen(path, \"rb\");
+    size = (long) fread(file, 1, sizeof(file), f);
+    fclose(f);
+    f = fopen(path, \"wb\");
+    fwrite(file, 1, size - 8, f);
+    fclose(f);
+    glDeleteLists(base, 2);
+    if (glLoadListsTGL(path) != -1 || glIsList(base))
+        return 10;
+    f = fopen(path, \"r+b\");
+    fputc('X', f);
+    fclose(f);
+    if (glLoadListsTGL(path) != -1)
+        return 11;
+
+    /* client arrays are not the list's to save */
+    glNewList(base, GL_COMPILE);
+    glVertexPointer(3, GL_FLOAT, 0, pos);
+    glEndList();
+    if (glSaveListsTGL(path, base, 1) != -1)
+        return 12;
+    remove(path);
+    teardown();
+    return 0;
+}
+"
+
+# Test: immediate mode calls run directly outside of display lists
+run_test "api_immediate_dispatch" "$API_HEADER
+#include <math.h>
+#include <string.h>
+#define S (128 * 128)
+static PIXEL a[S];
+/* triangles through every form of the immediate mode calls */
+static void scene(float k) {
+    GLfloat c[4] = {0.9f, 0.3f * k, 0.1f, 1};
+    GLfloat n[3] = {0, 0, 1};
+    GLfloat v[3] = {0.7f, -0.6f, 0};
+    glBegin(GL_TRIANGLES);
+    glColor4fv(c);
+    glNormal3fv(n);
+    glTexCoord2f(0.25f, 0.5f);
+    glVertex2f(-0.8f, -0.8f);
+    glColor3f(0.1f, 0.8f * k, 0.2f);
+    glVertex3fv(v);
+    glColor4f(0.2f, 0.2f, 0.9f * k, 1);
+    glNormal3f(0, 1, 0);
+    glVertex3f(0, 0.8f, 0.2f);
+    glEnd();
+    glColor3f(0.5f * k, 0.5f, 0.5f);
+    glRectf(0.4f, 0.4f, 0.9f, 0.9f);
+    glTexCoord4f(0.75f, 0.125f, 0, 1);
+}
+static void clear(void) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+static int same(void) {
+    glFinish();
+    return memcmp(a, zb->pbuf, sizeof(a)) == 0;
+}
+static int cleared(void) {
+    glFinish();
+    for (int i = 0; i < S; i++)
+        if (zb->pbuf[i] != 0)
+            return 0;
+    return 1;
+}
+int main(void) {
+    GLfloat t[4];
+    GLuint l;
+    setup();
+    glShadeModel(GL_SMOOTH);
+    clear();
+    scene(1);
+    glFinish();
+    memcpy(a, zb->pbuf, sizeof(a));
+    if (cleared())
+        return 1;
+
+    /* GL_COMPILE records the calls without running them */
+    l = glGenLists(1);
+    glTexCoord2f(0, 0);
+    clear();
+    glNewList(l, GL_COMPILE);
+    scene(1);
+    glEndList();
+    glGetFloatv(GL_CURRENT_TEXTURE_COORDS, t);
+    if (!cleared() || t[0] != 0 || t[1] != 0)
+        return 2;
+    clear();
+    glCallList(l);
+    glGetFloatv(GL_CURRENT_TEXTURE_COORDS, t);
+    if (!same() || t[0] != 0.75f || t[1] != 0.125f)
+        return 3;
+
+    /* GL_COMPILE_AND_EXECUTE does both */
+    clear();
+    glNewList(l, GL_COMPILE_AND_EXECUTE);
+    scene(1);
+    glEndList();
+    if (!same())
+        return 4;
+    clear();
+    glCallList(l);
+    if (!same())
+        return 5;
+
+    /* after glEndList, the calls run again, and are not recorded */
+    clear();
+    scene(0.5f);
+    if (same())
+        return 6;
+    clear();
+    glCallList(l);
+    if (!same())
+        return 7;
+    teardown();
+    return 0;
+}
+"
+
 echo ""
 fi
 